@@ -14,6 +14,8 @@
 #include <math.h>
 
 #include "avl.h"
+#include "imc_reclaim.h"
+#include "imc_arena.h"
 
 #ifdef DEBUG
 #define assert(s, x) if (! (x) ) {					\
@@ -32,21 +34,107 @@ void avl_update(avl_tree* tree, avl_data_t* data);
 void avl_insert_mutable(avl_tree* tree, void* data);
 int depth_tree (avl_tree* tree);
 int size_tree (avl_tree* tree);
+
+static inline int node_size(avl_node* node) {
+  return node ? node->size : 0;
+}
+
+static inline void update_size(avl_node* node) {
+  node->size = 1 + node_size(node->sons[0]) + node_size(node->sons[1]);
+}
   
 /*******************
  *   Constructors   *
  *******************/
 
+/* Allocator of the nodes and the trees. */
+static const imc_allocator_t* allocator = &imc_pool_allocator;
+
+void avl_set_allocator(const imc_allocator_t* new_allocator) {
+  allocator = new_allocator;
+}
+
+/* Allocates in the arena of the scope if any, else with the allocator. */
+void* avl_alloc(size_t size) {
+  imc_count(allocs, 1);
+  imc_count(bytes, size);
+  return imc_arena_scope ? imc_arena_alloc(imc_arena_scope, size)
+                         : allocator->alloc(size);
+}
+
+/* Nothing is freed in a scope. */
+void avl_free(void* block, size_t size) {
+  if (!imc_arena_scope)
+    allocator->free(block, size);
+}
+
+#ifdef AVL_THREAD_SAFE
+#define init_ref(node, count) atomic_init(&(node)->ref_count, (count))
+#else
+#define init_ref(node, count) ((node)->ref_count = (count))
+#endif
+
+/* Nothing is counted in a scope: nodes of arenas have no reference. Taking a
+   reference needs no ordering, as the caller already holds one. */
+static void take_ref(avl_node* node) {
+  if (node && !imc_arena_scope) {
+#ifdef AVL_THREAD_SAFE
+    atomic_fetch_add_explicit(&node->ref_count, 1, memory_order_relaxed);
+#else
+    node->ref_count++;
+#endif
+    imc_count(incs, 1);
+  }
+}
+
+/* Drops a reference, and tells if it was the last one. The release makes
+   the uses of the node by this thread happen before its free, the acquire
+   makes the uses by the other threads happen before it too. */
+static int release_ref(avl_node* node) {
+  imc_count(decs, 1);
+#ifdef AVL_THREAD_SAFE
+  if (atomic_fetch_sub_explicit(&node->ref_count, 1, memory_order_release) == 1) {
+    atomic_thread_fence(memory_order_acquire);
+    return 1;
+  }
+  return 0;
+#else
+  return --node->ref_count == 0;
+#endif
+}
+
+/* Tells if the caller holds the only reference to a node, to change it in
+   place. The acquire makes the uses by the threads which released theirs
+   happen before the changes. In a scope, the references are not counted. */
+static int owned(avl_node* node) {
+#ifdef AVL_THREAD_SAFE
+  return !imc_arena_scope &&
+    atomic_load_explicit(&node->ref_count, memory_order_acquire) == 1;
+#else
+  return !imc_arena_scope && node->ref_count == 1;
+#endif
+}
+
+/* Nodes of arenas have no reference. */
+static int in_arena(avl_node* node) {
+#ifdef AVL_THREAD_SAFE
+  return atomic_load_explicit(&node->ref_count, memory_order_relaxed) == 0;
+#else
+  return node->ref_count == 0;
+#endif
+}
+
 /***
  * Return an empty node.
  * balance is initialized with 0 (no sons = balances)
  * sons are empty.
- * ref_count is set to one. */
+ * ref_count and size are set to one. */
 avl_node* make_node(avl_data_t* data) {
-  avl_node* r = malloc(sizeof(*r));
+  avl_node* r = avl_alloc(sizeof(*r));
   r->data = data;
-  r->ref_count = 1;
+  init_ref(r, imc_arena_scope ? 0 : 1);
   r->balance = 0;
+  r->size = 1;
   r->sons[0] = r->sons[1] = NULL;
   return r;
 }
@@ -57,7 +145,7 @@ avl_node* make_node(avl_data_t* data) {
  * size is set to 0.
  * compare function is taken from parameters. */
 avl_tree* avl_make_empty_tree(int (*compare)(avl_data_t*, avl_data_t*)) {
-  avl_tree* r = malloc(sizeof(*r));
+  avl_tree* r = avl_alloc(sizeof(*r));
   r->root = NULL;
   r->compare = compare;
   r->size = 0;
@@ -70,14 +158,16 @@ avl_tree* avl_make_empty_tree(int (*compare)(avl_data_t*, avl_data_t*)) {
  * ref_count of the sons are incremented. */
 avl_node* avl_copy_node(avl_node* node) {
   if (node) {
-    avl_node* new = malloc(sizeof(*new));
+    avl_node* new = avl_alloc(sizeof(*new));
+    imc_count(copies, 1);
     new->data = node->data;
-    new->ref_count = 1;
+    init_ref(new, imc_arena_scope ? 0 : 1);
     new->balance = node->balance;
+    new->size = node->size;
     new->sons[0] = node->sons[0];
     new->sons[1] = node->sons[1];
-    if (new->sons[0]) new->sons[0]->ref_count++;
-    if (new->sons[1]) new->sons[1]->ref_count++;
+    take_ref(new->sons[0]);
+    take_ref(new->sons[1]);
     return new;
   } else {
     return NULL;
@@ -89,11 +179,10 @@ avl_node* avl_copy_node(avl_node* node) {
  * ref_count of the root (if any) is incremented. */
 avl_tree* avl_copy_tree(avl_tree* tree) {
   if (tree) {
-    avl_tree* new = malloc(sizeof(*new));
+    avl_tree* new = avl_alloc(sizeof(*new));
     new->size = tree->size;
-    if ((new->root = tree->root) != NULL) {
-      new->root->ref_count++;
-    }
+    new->root = tree->root;
+    take_ref(new->root);
     return new;
   } else {
     return NULL;
@@ -104,21 +193,66 @@ avl_tree* avl_copy_tree(avl_tree* tree) {
  *    Destructor    *
  *******************/
 
-void erase_node(avl_node* root) {
+/* Frees a node left unreferenced, and hands its sons left unreferenced to
+   the reclaimer, which frees them from its worklist instead of recursing. */
+void avl_reclaim_node(void* node) {
+  avl_node* root = node;
 
-  if (root && __sync_sub_and_fetch(&root->ref_count, 1) == 0) {
-    avl_node* l = root->sons[0], *r = root->sons[1];
+  for (int dir = 0; dir < 2; dir++) {
+    avl_node* son = root->sons[dir];
 
-    free(root);
-    erase_node(l);
-    erase_node(r);
+    if (son && release_ref(son))
+      imc_reclaim(son, avl_reclaim_node);
   }
+  avl_free(root, sizeof(*root));
+}
+
+void erase_node(avl_node* root) {
+  if (root && !imc_arena_scope && release_ref(root))
+    imc_reclaim(root, avl_reclaim_node);
+}
+
+/* Undoes a reference taken by a copy, to a node the caller still reaches
+   from the original: it is only its last one if the original was released
+   meanwhile, by another thread. */
+static void undo_ref(avl_node* node) {
+  erase_node(node);
 }
 
 
 void avl_erase_tree(avl_tree* tree) {
   erase_node(tree->root);
-  free(tree);
+  avl_free(tree, sizeof(*tree));
+}
+
+/*******************
+ *    Promotion     *
+ *******************/
+
+/***
+ * Copies the nodes allocated in arenas (they have no reference),
+ * and shares the others. */
+avl_node* promote_node(avl_node* node) {
+  if (node == NULL) {
+    return NULL;
+  } else if (!in_arena(node)) {
+    take_ref(node);
+    return node;
+  } else {
+    avl_node* new = make_node(node->data);
+    new->balance = node->balance;
+    new->size = node->size;
+    new->sons[0] = promote_node(node->sons[0]);
+    new->sons[1] = promote_node(node->sons[1]);
+    return new;
+  }
+}
+
+avl_tree* avl_promote_tree(avl_tree* tree) {
+  avl_tree* new = avl_make_empty_tree(tree->compare);
+  new->root = promote_node(tree->root);
+  new->size = tree->size;
+  return new;
 }
 
 /*******************
@@ -127,19 +261,18 @@ void avl_erase_tree(avl_tree* tree) {
 
 avl_data_t* search_r(avl_node* root, avl_data_t* data,
 		 int (*compare)(avl_data_t*, avl_data_t*)) {
-  if (root == NULL) {
-    return NULL;
-  } else { 
-    if ((*compare)(data, root->data) == 0) {
+  while (root) {
+    imc_count(visited, 1);
+    int comp = (*compare)(root->data, data);
+    if (comp == 0)
       return root->data;
-    } else {
-      int dir = (*compare)(root->data, data) < 0;
-      return search_r(root->sons[dir], data, compare);
-    }
+    root = root->sons[comp < 0];
   }
+  return NULL;
 }
 
 avl_data_t* avl_search(avl_tree* tree, avl_data_t* data) {
+  imc_count(lookups, 1);
   return search_r(tree->root, data, tree->compare);
 }
 
@@ -154,6 +287,8 @@ avl_node* single_rotation(avl_node* root, int dir) {
 
   root->sons[!dir] = save->sons[dir];
   save->sons[dir] = root;
+  update_size(root);
+  update_size(save);
 
   return save;
 }
@@ -165,23 +300,6 @@ avl_node* double_rotation(avl_node* root, int dir) {
 }
 
 
-// dir == 0 means left rotation and 1 means right
-avl_node* single_rotation_remove(avl_node* root, int dir) {
-  avl_node* save = avl_copy_node(root->sons[!dir]);
-
-  root->sons[!dir] = save->sons[dir];
-  save->sons[dir] = root;
-
-  return save;
-}
-
-// dir == 0 means right-left and 1 means left-right
-avl_node* double_rotation_remove(avl_node* root, int dir) {
-  root->sons[!dir] = single_rotation_remove(root->sons[!dir], !dir);
-  return single_rotation(root, dir);
-}
-
-
 /* Adjust the balances before the application of double_rotation
    (right-left rotation on the following example)
    x
@@ -246,12 +364,12 @@ avl_node* insert_node(avl_node* root, avl_data_t* data,
     root = make_node(data);
     *node_inserted = 1;
   } else {
-    avl_node* head = make_node((void*)0); /* False tree root */
+    avl_node head = { .sons = { NULL, NULL } }; /* False tree root */
     avl_node *s, *t;     /* Place to rebalance and parent */
     avl_node *p, *q;     /* Iterator and save pointer */
     int dir;
 
-    t = head;
+    t = &head;
     root = t->sons[1] = avl_copy_node(root);
     /* Search down the tree, saving rebalance points */
     for (s = p = t->sons[1];; p = q) {
@@ -260,7 +378,7 @@ avl_node* insert_node(avl_node* root, avl_data_t* data,
 	return root;
       }
       dir = comp < 0;
-      if(p->sons[dir]) p->sons[dir]->ref_count--; // undo the increment done by avl_copy_node.
+      undo_ref(p->sons[dir]); // undo the increment done by avl_copy_node.
       q = p->sons[dir] = avl_copy_node(p->sons[dir]);
 	
       if (q == NULL)
@@ -277,7 +395,12 @@ avl_node* insert_node(avl_node* root, avl_data_t* data,
     /* Insert the new node */
     p->sons[dir] = q = make_node(data);
 
-      /* Update balance factors */
+      /* Update the sizes of the path, then the balance factors */
+      for (p = root; p != q; p = p->sons[dir]) {
+        dir = (*compare)(p->data, data) < 0;
+        p->size++;
+      }
+
       for (p = s; p != q; p = p->sons[dir])
         {
           dir = (*compare)(p->data, data) < 0;
@@ -294,7 +417,7 @@ avl_node* insert_node(avl_node* root, avl_data_t* data,
         }
 
       /* Fix parent */
-      if (q == head->sons[1])
+      if (q == head.sons[1])
         root = s;
       else
         t->sons[q == t->sons[1]] = s;
@@ -304,6 +427,9 @@ avl_node* insert_node(avl_node* root, avl_data_t* data,
 }
 
 avl_tree* avl_insert(avl_tree* tree, avl_data_t* data) {
+  if (tree->size >= AVL_MAX_SIZE && avl_search(tree, data) == NULL)
+    return NULL;
+
   int node_inserted = 0;
   avl_node* root = insert_node(tree->root, data, tree->compare, &node_inserted);
 
@@ -320,7 +446,7 @@ avl_tree* avl_insert(avl_tree* tree, avl_data_t* data) {
 
   // Checking the depth of the tree.
   assert( "depth", new_tree->size <= 1 ||
-	  depth_tree(new_tree) <= 1.44 * log(tree->size) / log(2) );
+	  depth_tree(new_tree) <= 1.44 * log(new_tree->size + 2) / log(2) );
 
   // Checking that size if valid.
   assert( "size", new_tree->size == size_tree(new_tree) );
@@ -333,26 +459,54 @@ avl_tree* avl_insert(avl_tree* tree, avl_data_t* data) {
  *     Deletion     *
  *******************/
 
+/* Replaces the son of a copied node by its copy, before changing it: the
+   son is still shared with the other versions. */
+static avl_node* copy_son(avl_node* node, int dir) {
+  avl_node* son = node->sons[dir];
+  node->sons[dir] = avl_copy_node(son);
+  undo_ref(son);
+  return node->sons[dir];
+}
+
+/* The nodes the rotations change, off the path of the removal, are copied
+   first. */
 avl_node* remove_balance(avl_node* root, int dir, int *done) {
-  avl_node* n = root->sons[!dir];
+  avl_node* n = copy_son(root, !dir);
   int bal = dir == 0 ? -1 : +1;
 
   if (n->balance == -bal) {
     root->balance = n->balance = 0;
-    root = single_rotation_remove(root, dir);
+    root = single_rotation(root, dir);
   } else if (n->balance == bal) {
+    copy_son(n, dir);
     adjust_balance(root, !dir, -bal);
-    root = double_rotation_remove(root, dir);
+    root = double_rotation(root, dir);
   } else /* n->balance == 0 */ {
     root->balance = -bal;
     n->balance = bal;
-    root = single_rotation_remove(root, dir);
+    root = single_rotation(root, dir);
     *done = 1;
   }
 
   return root;
 }
 
+/* Fixes a copied node once its son dir lost a node, if it did. */
+static avl_node* remove_fix(avl_node* root, int dir, int* done) {
+  update_size(root);
+  if (!*done) {
+    /* Update balance factors */
+    root->balance += dir != 0 ? -1 : +1;
+
+    /* Terminate or rebalance as necessary */
+    if (abs(root->balance) == 1)
+      *done = 1;
+    else if (abs(root->balance) > 1)
+      root = remove_balance(root, dir, done);
+  }
+  return root;
+}
+
 avl_node* remove_node(avl_node* root, avl_data_t* data, int* done,
 		      avl_data_t** ret_data,
 		      int (*compare)(avl_data_t*, avl_data_t*)){
@@ -365,11 +519,11 @@ avl_node* remove_node(avl_node* root, avl_data_t* data, int* done,
 
       if (*ret_data == NULL) *ret_data = root->data;
       
-      /* Unsons and fix parent */
+      /* Unsons and fix parent: the son takes the reference of the copy. */
       if (root->sons[0] == NULL || root->sons[1] == NULL) {
-	dir = root->sons[0] == NULL;
-
-	return avl_copy_node(root->sons[dir]);
+	avl_node* son = root->sons[root->sons[0] == NULL];
+	avl_free(root, sizeof(*root));
+	return son;
       } else {
 	/* Find inorder predecessor */
 	avl_node* heir = root->sons[0];
@@ -385,19 +539,9 @@ avl_node* remove_node(avl_node* root, avl_data_t* data, int* done,
     }
 
     dir = (*compare)(root->data, data) < 0;
-    if(root->sons[dir]) root->sons[dir]->ref_count--;
+    undo_ref(root->sons[dir]);
     root->sons[dir] = remove_node(root->sons[dir], data, done, ret_data, compare);
-
-    if (!*done) {
-      /* Update balance factors */
-      root->balance += dir != 0 ? -1 : +1;
-
-      /* Terminate or rebalance as necessary */
-      if (abs(root->balance) == 1)
-	*done = 1;
-      else if (abs(root->balance) > 1)
-	root = remove_balance(root, dir, done);
-    }
+    root = remove_fix(root, dir, done);
   }
   else
     *done = 1;
@@ -421,7 +565,319 @@ avl_tree* avl_remove(avl_tree* tree, avl_data_t* data, avl_data_t** ret_data) {
 
   // Checking the depth of the tree.
   assert( "depth", new_tree->size <= 1 ||
-	  depth_tree(new_tree) <= 1.44 * log(tree->size) / log(2) );
+	  depth_tree(new_tree) <= 1.44 * log(new_tree->size + 2) / log(2) );
+
+  // Checking that size if valid.
+  assert( "size", new_tree->size == size_tree(new_tree) );
+
+  return new_tree;
+}
+
+/***********************
+ *   Order statistics  *
+ ***********************/
+
+/* The rank of a node is the size of its left son plus the ranks before it,
+   so the searches go down by the sizes, without comparing the data. */
+avl_data_t* avl_search_at(avl_tree* tree, int index) {
+  avl_node* node = tree->root;
+
+  imc_count(lookups, 1);
+  while (node) {
+    imc_count(visited, 1);
+    int left = node_size(node->sons[0]);
+    if (index == left)
+      return node->data;
+    int dir = index > left;
+    if (dir)
+      index -= left + 1;
+    node = node->sons[dir];
+  }
+  return NULL;
+}
+
+/* Inserts data at rank index in a subtree, copying its path. grown is set
+   when the subtree is higher. */
+static avl_node* insert_at_r(avl_node* root, int index, avl_data_t* data,
+			     int* grown) {
+  if (root == NULL) {
+    *grown = 1;
+    return make_node(data);
+  }
+
+  root = avl_copy_node(root);
+  int left = node_size(root->sons[0]);
+  int dir = index > left;
+  if (dir)
+    index -= left + 1;
+  undo_ref(root->sons[dir]);
+  root->sons[dir] = insert_at_r(root->sons[dir], index, data, grown);
+  root->size++;
+
+  if (*grown) {
+    root->balance += dir == 0 ? -1 : +1;
+    if (root->balance == 0)
+      *grown = 0;
+    else if (abs(root->balance) > 1) {
+      root = insert_balance(root, dir);
+      *grown = 0;
+    }
+  }
+  return root;
+}
+
+avl_tree* avl_insert_at(avl_tree* tree, int index, avl_data_t* data) {
+  if (tree->size >= AVL_MAX_SIZE)
+    return NULL;
+
+  int grown = 0;
+  avl_tree* new_tree = avl_make_empty_tree(tree->compare);
+  new_tree->root = insert_at_r(tree->root, index, data, &grown);
+  new_tree->size = tree->size + 1;
+
+  // Checking that size if valid.
+  assert( "size", new_tree->size == size_tree(new_tree) );
+
+  return new_tree;
+}
+
+avl_tree* avl_update_at(avl_tree* tree, int index, avl_data_t* data) {
+  avl_tree* new_tree = avl_make_empty_tree(tree->compare);
+  new_tree->size = tree->size;
+
+  /* Copies the path down to the node, then changes its data. */
+  avl_node** link = &new_tree->root;
+  avl_node* node = tree->root;
+  while (node) {
+    node = *link = avl_copy_node(node);
+    int left = node_size(node->sons[0]);
+    if (index == left) {
+      node->data = data;
+      break;
+    }
+    int dir = index > left;
+    if (dir)
+      index -= left + 1;
+    link = &node->sons[dir];
+    undo_ref(*link); /* Its copy takes its place. */
+    node = *link;
+  }
+  return new_tree;
+}
+
+/* Removes the node at rank index of a subtree, copying its path. done is
+   set once the height of the subtree is known to be the same. */
+static avl_node* remove_at_r(avl_node* root, int index, int* done,
+			     avl_data_t** ret_data) {
+  if (root == NULL) {
+    *done = 1;
+    return NULL;
+  }
+
+  root = avl_copy_node(root);
+  int left = node_size(root->sons[0]);
+  int dir;
+
+  if (index == left) {
+    *ret_data = root->data;
+    /* Unsons and fix parent: the son takes the reference of the copy. */
+    if (root->sons[0] == NULL || root->sons[1] == NULL) {
+      avl_node* son = root->sons[root->sons[0] == NULL];
+      avl_free(root, sizeof(*root));
+      return son;
+    }
+    /* The inorder predecessor takes its place. */
+    avl_data_t* heir;
+    dir = 0;
+    undo_ref(root->sons[0]);
+    root->sons[0] = remove_at_r(root->sons[0], left - 1, done, &heir);
+    root->data = heir;
+  } else {
+    dir = index > left;
+    if (dir)
+      index -= left + 1;
+    undo_ref(root->sons[dir]);
+    root->sons[dir] = remove_at_r(root->sons[dir], index, done, ret_data);
+  }
+
+  return remove_fix(root, dir, done);
+}
+
+avl_tree* avl_remove_at(avl_tree* tree, int index, avl_data_t** ret_data) {
+  int done = 0;
+
+  *ret_data = NULL;
+  if (index < 0 || index >= tree->size) {
+    avl_tree* new_tree = avl_copy_tree(tree);
+    new_tree->compare = tree->compare;
+    return new_tree;
+  }
+
+  avl_tree* new_tree = avl_make_empty_tree(tree->compare);
+  new_tree->root = remove_at_r(tree->root, index, &done, ret_data);
+  new_tree->size = tree->size - 1;
+
+  // Checking that size if valid.
+  assert( "size", new_tree->size == size_tree(new_tree) );
+
+  return new_tree;
+}
+
+/***********************
+ *   Join and split    *
+ ***********************/
+
+/* The joins take over the references of the subtrees they are given, and
+   give one to the subtree they return. The heights are not stored: they are
+   found down the taller sons, then followed from the balances. */
+
+static inline int imax(int a, int b) {
+  return a < b ? b : a;
+}
+
+static int node_height(avl_node* node) {
+  int height = 0;
+  for (; node; node = node->sons[node->balance > 0])
+    height++;
+  return height;
+}
+
+/* Height of the son dir of a node of height h. */
+static inline int son_height(avl_node* node, int h, int dir) {
+  int bal = dir ? node->balance : -node->balance;
+  return bal >= 0 ? h - 1 : h - 2;
+}
+
+/* Sets the balance of a node from the heights of its son !dir and son dir. */
+static inline void set_balance(avl_node* node, int h_other, int h_dir, int dir) {
+  node->balance = dir ? h_dir - h_other : h_other - h_dir;
+}
+
+/* Takes over a node to change it: its copy, and the reference to the node is
+   released. A node only referenced by the caller is changed in place (in a
+   scope, the references of the nodes are not counted). */
+static avl_node* expose(avl_node* node) {
+  if (owned(node))
+    return node;
+  avl_node* copy = avl_copy_node(node);
+  erase_node(node);
+  return copy;
+}
+
+static avl_node* join_node(avl_node* left, int h_left, avl_data_t* data,
+			   avl_node* right, int h_right) {
+  avl_node* node = make_node(data);
+  node->sons[0] = left;
+  node->sons[1] = right;
+  node->balance = h_right - h_left;
+  update_size(node);
+  return node;
+}
+
+/* Rebalances a taken over node, whose son dir, of height ht, is at most two
+   higher than its other son, of height ho. */
+static avl_node* join_balance(avl_node* node, int ho, int ht, int dir, int* h) {
+  avl_node* t = node->sons[dir];
+
+  if (ht <= ho + 1) {
+    set_balance(node, ho, ht, dir);
+    update_size(node);
+    *h = 1 + imax(ho, ht);
+    return node;
+  }
+
+  int h_inner = son_height(t, ht, !dir);
+  int h_outer = son_height(t, ht, dir);
+  if (h_outer >= h_inner) {
+    avl_node* top = single_rotation(node, !dir);
+    set_balance(node, ho, h_inner, dir);
+    int hn = 1 + imax(ho, h_inner);
+    set_balance(t, hn, h_outer, dir);
+    *h = 1 + imax(hn, h_outer);
+    return top;
+  } else {
+    /* The inner grandson goes up: it is taken over first. */
+    avl_node* z = t->sons[!dir] = expose(t->sons[!dir]);
+    int hz_other = son_height(z, h_inner, !dir);
+    int hz_dir = son_height(z, h_inner, dir);
+    avl_node* top = double_rotation(node, !dir);
+    set_balance(node, ho, hz_other, dir);
+    int hn = 1 + imax(ho, hz_other);
+    set_balance(t, hz_dir, h_outer, dir);
+    int hts = 1 + imax(hz_dir, h_outer);
+    set_balance(z, hn, hts, dir);
+    *h = 1 + imax(hn, hts);
+    return top;
+  }
+}
+
+/* Joins small on the side dir of big, higher by two at least, with data
+   between them: down the side dir of big to a son as high as small. */
+static avl_node* join_side(avl_node* big, int hb, avl_data_t* data,
+			   avl_node* small, int hs, int dir, int* h) {
+  avl_node* node = expose(big);
+  int ho = son_height(node, hb, !dir);
+  int hc = son_height(node, hb, dir);
+  avl_node* c = node->sons[dir];
+  int ht;
+
+  if (hc <= hs + 1) {
+    node->sons[dir] = dir ? join_node(c, hc, data, small, hs)
+			  : join_node(small, hs, data, c, hc);
+    ht = 1 + imax(hc, hs);
+  } else {
+    node->sons[dir] = join_side(c, hc, data, small, hs, dir, &ht);
+  }
+  return join_balance(node, ho, ht, dir, h);
+}
+
+static avl_node* join_r(avl_node* left, int hl, avl_data_t* data,
+			avl_node* right, int hr, int* h) {
+  if (hl > hr + 1)
+    return join_side(left, hl, data, right, hr, 1, h);
+  if (hr > hl + 1)
+    return join_side(right, hr, data, left, hl, 0, h);
+  *h = 1 + imax(hl, hr);
+  return join_node(left, hl, data, right, hr);
+}
+
+avl_tree* avl_join(avl_tree* tree1, avl_data_t* data, avl_tree* tree2) {
+  if (tree1->size + tree2->size >= AVL_MAX_SIZE)
+    return NULL;
+
+  int h;
+  avl_tree* new_tree = avl_make_empty_tree(tree1->compare);
+  take_ref(tree1->root);
+  take_ref(tree2->root);
+  new_tree->root = join_r(tree1->root, node_height(tree1->root), data,
+			  tree2->root, node_height(tree2->root), &h);
+  new_tree->size = tree1->size + tree2->size + 1;
+
+  // Checking the depth of the tree.
+  assert( "depth", depth_tree(new_tree) == h );
+
+  return new_tree;
+}
+
+/* The last node of tree1 joins them. */
+avl_tree* avl_concat(avl_tree* tree1, avl_tree* tree2) {
+  if (tree1->size + tree2->size > AVL_MAX_SIZE)
+    return NULL;
+  if (tree1->size == 0 || tree2->size == 0) {
+    avl_tree* new_tree = avl_copy_tree(tree1->size == 0 ? tree2 : tree1);
+    new_tree->compare = tree1->compare;
+    return new_tree;
+  }
+
+  int h, done = 0;
+  avl_data_t* last;
+  avl_node* left = remove_at_r(tree1->root, tree1->size - 1, &done, &last);
+  take_ref(tree2->root);
+
+  avl_tree* new_tree = avl_make_empty_tree(tree1->compare);
+  new_tree->root = join_r(left, node_height(left), last,
+			  tree2->root, node_height(tree2->root), &h);
+  new_tree->size = tree1->size + tree2->size;
 
   // Checking that size if valid.
   assert( "size", new_tree->size == size_tree(new_tree) );
@@ -429,6 +885,100 @@ avl_tree* avl_remove(avl_tree* tree, avl_data_t* data, avl_data_t** ret_data) {
   return new_tree;
 }
 
+/* Splits a subtree of height h in its index first nodes, and the others,
+   joining the sons it passes with the parts of the son it goes down. The
+   subtree is kept: the sons the joins take over get a reference. */
+static void split_r(avl_node* node, int h, int index,
+		    avl_node** left, int* hl, avl_node** right, int* hr) {
+  if (node == NULL || index <= 0 || index >= node->size) {
+    int all_left = node != NULL && index > 0;
+    take_ref(node);
+    *left = all_left ? node : NULL;
+    *hl = all_left ? h : 0;
+    *right = all_left ? NULL : node;
+    *hr = all_left ? 0 : h;
+    return;
+  }
+
+  int size_left = node_size(node->sons[0]);
+  avl_node* part;
+  int h_part;
+  if (index <= size_left) {
+    split_r(node->sons[0], son_height(node, h, 0), index, left, hl, &part, &h_part);
+    take_ref(node->sons[1]);
+    *right = join_r(part, h_part, node->data,
+		    node->sons[1], son_height(node, h, 1), hr);
+  } else {
+    split_r(node->sons[1], son_height(node, h, 1), index - size_left - 1,
+	    &part, &h_part, right, hr);
+    take_ref(node->sons[0]);
+    *left = join_r(node->sons[0], son_height(node, h, 0), node->data,
+		   part, h_part, hl);
+  }
+}
+
+void avl_split_at(avl_tree* tree, int index, avl_tree** tree1, avl_tree** tree2) {
+  int hl, hr;
+  *tree1 = avl_make_empty_tree(tree->compare);
+  *tree2 = avl_make_empty_tree(tree->compare);
+  split_r(tree->root, node_height(tree->root), index,
+	  &(*tree1)->root, &hl, &(*tree2)->root, &hr);
+  (*tree1)->size = node_size((*tree1)->root);
+  (*tree2)->size = node_size((*tree2)->root);
+}
+
+/***********************
+ *     Iterators       *
+ ***********************/
+
+/* The stack holds the nodes left to visit whose sons down the iteration are
+   not visited yet: the top is the next one. Going forward, a node comes
+   after its son 0 and before its son 1, the other way round in reverse. */
+
+/* Pushes a node then its sons towards the beginning of the iteration. */
+static void push_path(avl_iterator* iterator, avl_node* node) {
+  for (; node; node = node->sons[iterator->reverse])
+    iterator->stack[iterator->depth++] = node;
+}
+
+void avl_iterator_init(avl_iterator* iterator, avl_tree* tree, int reverse) {
+  iterator->depth = 0;
+  iterator->reverse = reverse != 0;
+  push_path(iterator, tree->root);
+}
+
+/* The nodes not before data are pushed on the way down to it. */
+void avl_iterator_seek(avl_iterator* iterator, avl_tree* tree, avl_data_t* data,
+		       int reverse) {
+  iterator->depth = 0;
+  iterator->reverse = reverse != 0;
+  for (avl_node* node = tree->root; node; ) {
+    int comp = (*tree->compare)(node->data, data);
+    if (reverse ? comp <= 0 : comp >= 0) {
+      iterator->stack[iterator->depth++] = node;
+      node = node->sons[iterator->reverse];
+    } else {
+      node = node->sons[!iterator->reverse];
+    }
+  }
+}
+
+int avl_iterator_next(avl_iterator* iterator, avl_data_t** data) {
+  if (iterator->depth == 0)
+    return 0;
+  avl_node* node = iterator->stack[--iterator->depth];
+  push_path(iterator, node->sons[!iterator->reverse]);
+  *data = node->data;
+  return 1;
+}
+
+void avl_flatten(avl_tree* tree, avl_data_t** data) {
+  avl_iterator iterator;
+  avl_iterator_init(&iterator, tree, 0);
+  while (avl_iterator_next(&iterator, data))
+    data++;
+}
+
 /***********************
  *      Update         *
  ***********************/
@@ -450,23 +1000,205 @@ void avl_update(avl_tree* tree, avl_data_t* data) {
 }
 
 /***********************
- *       Merge         *
+ *   Set operations    *
  ***********************/
-void merge_r(avl_tree* ret, avl_node* orig) {
-  if (orig != NULL) {
-    avl_insert_mutable(ret, orig->data);
-    merge_r(ret, orig->sons[0]);
-    merge_r(ret, orig->sons[1]);
+
+/* Union, intersection and difference split the first tree by the root of
+   the second, run on both sides, then join the parts (Blelloch, Ferizovic
+   and Sun, "Just join for parallel ordered sets"): O(m log(n/m + 1)) for
+   trees of sizes m <= n, and the subtrees found in a single tree are shared.
+   Like the joins, they take over the references of the subtrees they are
+   given. The two sides are disjoint: above a size, one of them is a task of
+   the pool. */
+
+/* Subtrees smaller than that are not worth a task. */
+#define AVL_PAR_CUTOFF 2048
+
+/* Takes a subtree of height h apart: its sons, of heights hl and hr, get the
+   references the root held. Returns the data of the root. */
+static avl_data_t* take_apart(avl_node* node, int h, avl_node** left, int* hl,
+			      avl_node** right, int* hr) {
+  avl_data_t* data = node->data;
+  *left = node->sons[0];
+  *right = node->sons[1];
+  *hl = son_height(node, h, 0);
+  *hr = son_height(node, h, 1);
+  if (owned(node)) {
+    avl_free(node, sizeof(*node));
+  } else {
+    take_ref(*left);
+    take_ref(*right);
+    erase_node(node);
   }
+  return data;
 }
 
-avl_tree* merge(avl_tree* tree1, avl_tree* tree2) {
-  avl_tree* new = avl_make_empty_tree(tree1->compare);
+/* Splits a subtree in its nodes lower and higher than data. Returns the data
+   of the node equal to data, which is left out, or NULL. */
+static avl_data_t* split_key_r(avl_node* node, int h, avl_data_t* data,
+			       int (*compare)(avl_data_t*, avl_data_t*),
+			       avl_node** left, int* hl,
+			       avl_node** right, int* hr) {
+  if (node == NULL) {
+    *left = *right = NULL;
+    *hl = *hr = 0;
+    return NULL;
+  }
+
+  int comp = (*compare)(node->data, data);
+  avl_node *l, *r, *part;
+  int h_l, h_r, h_part;
+  avl_data_t* node_data = take_apart(node, h, &l, &h_l, &r, &h_r);
+  avl_data_t* found;
 
-  merge_r(new, tree1->root);
-  merge_r(new, tree2->root);
-  
-  return new;
+  if (comp == 0) {
+    *left = l;
+    *hl = h_l;
+    *right = r;
+    *hr = h_r;
+    return node_data;
+  } else if (comp > 0) {
+    found = split_key_r(l, h_l, data, compare, left, hl, &part, &h_part);
+    *right = join_r(part, h_part, node_data, r, h_r, hr);
+  } else {
+    found = split_key_r(r, h_r, data, compare, &part, &h_part, right, hr);
+    *left = join_r(l, h_l, node_data, part, h_part, hl);
+  }
+  return found;
+}
+
+/* Splits the last node off a subtree. Returns its data. */
+static avl_data_t* split_last(avl_node* node, int h, avl_node** rest, int* h_rest) {
+  avl_node *l, *r, *part;
+  int h_l, h_r, h_part;
+  avl_data_t* data = take_apart(node, h, &l, &h_l, &r, &h_r);
+
+  if (r == NULL) {
+    *rest = l;
+    *h_rest = h_l;
+    return data;
+  }
+  avl_data_t* last = split_last(r, h_r, &part, &h_part);
+  *rest = join_r(l, h_l, data, part, h_part, h_rest);
+  return last;
+}
+
+/* Joins two subtrees without a node between them. */
+static avl_node* join2_r(avl_node* left, int hl, avl_node* right, int hr, int* h) {
+  if (left == NULL) {
+    *h = hr;
+    return right;
+  }
+  avl_node* rest;
+  int h_rest;
+  avl_data_t* last = split_last(left, hl, &rest, &h_rest);
+  return join_r(rest, h_rest, last, right, hr, h);
+}
+
+typedef enum { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE } set_op_t;
+
+/* The subtrees of an operation, and its result, to run it as a task. */
+typedef struct _set_args {
+  thread_pool_t* pool;     // NULL to run in the current thread only.
+  set_op_t op;
+  int (*compare)(avl_data_t*, avl_data_t*);
+  avl_node* t1;
+  int h1;
+  avl_node* t2;
+  int h2;
+  avl_node* result;
+  int h;
+} set_args_t;
+
+static void set_op_r(set_args_t* args);
+
+static void set_op_task(void* arg) {
+  set_op_r(arg);
+}
+
+static void set_op_r(set_args_t* args) {
+  avl_node* t1 = args->t1;
+  avl_node* t2 = args->t2;
+
+  /* An empty tree, or the same subtree twice, as versions share them. */
+  if (t1 == NULL || t2 == NULL || t1 == t2) {
+    avl_node* kept = args->op == SET_UNION ? (t1 ? t1 : t2) :
+		     args->op == SET_INTERSECTION ? (t1 == t2 ? t1 : NULL) :
+		     t1 == t2 ? NULL : t1;
+    args->result = kept;
+    args->h = kept == t1 ? args->h1 : kept == t2 ? args->h2 : 0;
+    if (t1 != kept)
+      erase_node(t1);
+    if (t2 != kept || t1 == t2)
+      erase_node(t2);
+    return;
+  }
+
+  int size = t1->size + t2->size;
+  set_args_t left = *args, right = *args;
+  avl_data_t* data = take_apart(t2, args->h2, &left.t2, &left.h2,
+				&right.t2, &right.h2);
+  avl_data_t* found = split_key_r(t1, args->h1, data, args->compare,
+				  &left.t1, &left.h1, &right.t1, &right.h1);
+
+  if (args->pool && size >= AVL_PAR_CUTOFF) {
+    thread_pool_task_t task = { set_op_task, &right, false };
+    thread_pool_spawn(args->pool, &task);
+    set_op_r(&left);
+    thread_pool_join(args->pool, &task);
+  } else {
+    set_op_r(&left);
+    set_op_r(&right);
+  }
+
+  if (args->op == SET_UNION)
+    args->result = join_r(left.result, left.h, data, right.result, right.h, &args->h);
+  else if (args->op == SET_INTERSECTION && found)
+    args->result = join_r(left.result, left.h, found, right.result, right.h, &args->h);
+  else
+    args->result = join2_r(left.result, left.h, right.result, right.h, &args->h);
+}
+
+static avl_tree* set_op(thread_pool_t* pool, set_op_t op,
+			avl_tree* tree1, avl_tree* tree2) {
+  /* The tasks would allocate out of the arenas of the scope. */
+  set_args_t args = { imc_arena_scope ? NULL : pool, op, tree1->compare,
+		      tree1->root, node_height(tree1->root),
+		      tree2->root, node_height(tree2->root), NULL, 0 };
+  take_ref(tree1->root);
+  take_ref(tree2->root);
+  set_op_r(&args);
+
+  avl_tree* new_tree = avl_make_empty_tree(tree1->compare);
+  new_tree->root = args.result;
+  new_tree->size = node_size(args.result);
+
+  // Checking the depth of the tree.
+  assert( "depth", depth_tree(new_tree) == args.h );
+
+  return new_tree;
+}
+
+avl_tree* avl_union(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2) {
+  if (tree1->size + tree2->size > AVL_MAX_SIZE)
+    return NULL;
+  return set_op(pool, SET_UNION, tree1, tree2);
+}
+
+avl_tree* avl_intersection(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2) {
+  return set_op(pool, SET_INTERSECTION, tree1, tree2);
+}
+
+avl_tree* avl_difference(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2) {
+  return set_op(pool, SET_DIFFERENCE, tree1, tree2);
+}
+
+/* The data of tree1 are kept over the equal ones of tree2. */
+avl_tree* avl_merge(avl_tree* tree1, avl_tree* tree2) {
+  avl_tree* new_tree = avl_union(NULL, tree2, tree1);
+  if (new_tree)
+    new_tree->compare = tree1->compare;
+  return new_tree;
 }
 
 /***********************
@@ -475,7 +1207,7 @@ avl_tree* merge(avl_tree* tree1, avl_tree* tree2) {
 
 int depth_node (avl_node* node) {
   if (node) {
-    return 1 + MAX(depth_node(node->sons[0]),depth_node(node->sons[1]));
+    return 1 + imax(depth_node(node->sons[0]), depth_node(node->sons[1]));
   } else {
     return 0;
   }
@@ -536,12 +1268,12 @@ avl_node* insert_node_mutable( avl_node* root, void* data,
     root = make_node(data);
   }
   else {
-      avl_node* head = make_node((void*)0); /* False tree root */
+      avl_node head = { .sons = { NULL, NULL } }; /* False tree root */
       avl_node *s, *t;     /* Place to rebalance and parent */
       avl_node *p, *q;     /* Iterator and save pointer */
       int dir;
       
-      t = head;
+      t = &head;
       t->sons[1] = root;
       
       /* Search down the tree, saving rebalance points */
@@ -564,7 +1296,13 @@ avl_node* insert_node_mutable( avl_node* root, void* data,
 
       /* Insert the new node */
       p->sons[dir] = q = make_node(data);
-      
+
+      /* Update the sizes of the path, then the balance factors */
+      for (p = root; p != q; p = p->sons[dir]) {
+	dir = (*compare)(p->data, data) < 0;
+	p->size++;
+      }
+
       /* Update balance factors */
       for (p = s; p != q; p = p->sons[dir]) {
 	dir = (*compare)(p->data, data) < 0;
@@ -580,7 +1318,7 @@ avl_node* insert_node_mutable( avl_node* root, void* data,
       }
 
       /* Fix parent */
-      if (q == head->sons[1])
+      if (q == head.sons[1])
         root = s;
       else
         t->sons[q == t->sons[1]] = s;
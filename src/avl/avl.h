@@ -11,6 +11,15 @@
 #ifndef __AVL__
 #define __AVL__
 
+#include "imc_pool.h"
+#include "imc_arena.h"
+#include "imc_stats.h"
+#include "imc_thread_pool.h"
+
+#ifdef AVL_THREAD_SAFE
+#include <stdatomic.h>
+#endif
+
 
 /***************************
  * The AVL Trees.
@@ -19,33 +28,126 @@
 
 typedef void avl_data_t;
 
+/* Reference count of a node. When built with AVL_THREAD_SAFE, it is atomic,
+   and the nodes can be released from other threads, like the background
+   reclaimer's (see imc_reclaim.h). */
+#ifdef AVL_THREAD_SAFE
+typedef atomic_int avl_ref_t;
+#else
+typedef int avl_ref_t;
+#endif
+
 typedef struct _avl_node {
   avl_data_t* data;
-  int ref_count;
-  int balance;
+  avl_ref_t ref_count;
+  /* Nodes of the subtree, itself included, packed with the balance to keep
+     the nodes in 32 bytes: a tree holds at most AVL_MAX_SIZE nodes. */
+  unsigned int size : 29;
+  signed int balance : 3;
   struct _avl_node* sons[2];
 } avl_node;
 
+/* Most nodes in a tree, from the bits of avl_node.size. The operations
+   which would grow a tree past it return NULL. */
+#define AVL_MAX_SIZE ((int) ((1u << 29) - 1))
+
 typedef struct _avl_tree {
   avl_node* root;
   int size;
   int (*compare)(avl_data_t*, avl_data_t*);
 } avl_tree;
 
+/* Sets the allocator of the nodes and the trees, the pool by default.
+   It must be set before the first tree is created. */
+void avl_set_allocator(const imc_allocator_t* allocator);
+
+/* Allocates and frees the blocks of the structures built on the trees,
+   in the arena of the scope if any. Nothing is freed in a scope. */
+void* avl_alloc(size_t size);
+void avl_free(void* block, size_t size);
+
 avl_tree* avl_make_empty_tree(int (*compare)(avl_data_t*, avl_data_t*));
 
 void avl_erase_tree(avl_tree* t);
 
+/* Copies a tree created in an arena scope out of the arenas, to keep it
+   once they are freed. It is called once the scope is left. */
+avl_tree* avl_promote_tree(avl_tree* tree);
+
 avl_data_t* avl_search(avl_tree* tree, avl_data_t* data);
 
+/* NULL if data is new to a tree of AVL_MAX_SIZE nodes. */
 avl_tree* avl_insert(avl_tree* tree, avl_data_t* data);
 void avl_insert_mutable(avl_tree* tree, void* data); /* Careful with that one */
 
 avl_tree* avl_remove(avl_tree* tree, avl_data_t* data, avl_data_t** ret_data);
 
+/* Order statistics: the nodes are also reached by their rank, from 0, in
+   the order of the tree. The trees only used by rank have no compare. */
+avl_data_t* avl_search_at(avl_tree* tree, int index);
+
+/* Inserts data at rank index, from 0 to the size of the tree. NULL if the
+   tree has AVL_MAX_SIZE nodes. */
+avl_tree* avl_insert_at(avl_tree* tree, int index, avl_data_t* data);
+
+avl_tree* avl_update_at(avl_tree* tree, int index, avl_data_t* data);
+
+avl_tree* avl_remove_at(avl_tree* tree, int index, avl_data_t** ret_data);
+
+/* Joins the nodes of tree1, data then the nodes of tree2, which must be in
+   this order, in O(log n). The result shares their subtrees. The joins are
+   NULL past AVL_MAX_SIZE nodes. */
+avl_tree* avl_join(avl_tree* tree1, avl_data_t* data, avl_tree* tree2);
+
+/* Joins the nodes of tree1 then the nodes of tree2, in O(log n). */
+avl_tree* avl_concat(avl_tree* tree1, avl_tree* tree2);
+
+/* Splits a tree in its index first nodes, and the others, in O(log n). */
+void avl_split_at(avl_tree* tree, int index, avl_tree** tree1, avl_tree** tree2);
+
+/* An iterator over the nodes of a tree, in order or in reverse order. It
+   keeps the nodes left to visit on its path, in a stack as deep as the
+   highest tree (about 1.44 log2(n) for n nodes), so it allocates nothing.
+   The tree must outlive it. */
+#define AVL_MAX_HEIGHT 48
+
+typedef struct _avl_iterator {
+  avl_node* stack[AVL_MAX_HEIGHT];
+  int depth;
+  int reverse;
+} avl_iterator;
+
+/* Starts an iterator at the first node of a tree, or the last one if
+   reverse. */
+void avl_iterator_init(avl_iterator* iterator, avl_tree* tree, int reverse);
+
+/* Starts an iterator at the first node not lower than data, or the last one
+   not higher than data if reverse. */
+void avl_iterator_seek(avl_iterator* iterator, avl_tree* tree, avl_data_t* data,
+		       int reverse);
+
+/* Gets the data of the next node in data. Returns 0 at the end, 1 otherwise. */
+int avl_iterator_next(avl_iterator* iterator, avl_data_t** data);
+
+/* Writes the data of a tree in data, in order. */
+void avl_flatten(avl_tree* tree, avl_data_t** data);
+
 void avl_print(avl_tree* tree, char* (*data_to_string)(avl_data_t*));
 
-avl_tree* merge(avl_tree* tree1, avl_tree* tree2);
+/* Set operations on trees with the same compare, in O(m log(n/m + 1)) for
+   sizes m <= n. The result shares the subtrees found in a single tree. With
+   a pool, the big subtrees are processed in parallel; pool can be NULL.
+   The union keeps the data of tree2 for the nodes in both trees, the
+   intersection those of tree1. The union is NULL when the sizes of the
+   trees add up past AVL_MAX_SIZE. */
+avl_tree* avl_union(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2);
+avl_tree* avl_intersection(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2);
+
+/* The nodes of tree1 not in tree2. */
+avl_tree* avl_difference(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2);
+
+/* The union keeping the data of tree1. */
+avl_tree* avl_merge(avl_tree* tree1, avl_tree* tree2);
 
 
 #endif
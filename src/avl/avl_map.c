@@ -13,10 +13,6 @@ struct _avl_map_t{
   char* (*key_as_string)(void*);
   char* (*data_as_string)(void*);
 };
-struct _map_iterator_t{
-  avl_node* current;
-  struct _map_iterator_t* next;
-};
 
 /*******************
  *   Boxing & co   *
@@ -53,6 +49,11 @@ char* int_box_as_string(void* data) {
   sprintf(buf, "%d", *((int_box_t*)data));
   return buf;
 }
+int compare_int_boxes(void* box1, void* box2) {
+  int k1 = *(int_box_t*)box1;
+  int k2 = *(int_box_t*)box2;
+  return k1 == k2 ? 0 : k1 < k2 ? -1 : 1;
+}
 int compare_int_keys(void* key1, void* key2) {
   int k1 = *(int_box_t*)((_avl_map_data_t*)key1)->key;
   int k2 = *(int_box_t*)((_avl_map_data_t*)key2)->key;
@@ -70,6 +71,9 @@ string_box_t* make_string_box(char* str) {
 char* string_box_as_string(void* box) {
   return strdup(*((string_box_t*)box));
 }
+int compare_string_boxes(void* box1, void* box2) {
+  return strcmp(*(string_box_t*)box1, *(string_box_t*)box2);
+}
 int compare_string_keys(void* key1, void* key2) {
   return strcmp(*(string_box_t*)((_avl_map_data_t*)key1)->key,
 		*(string_box_t*)((_avl_map_data_t*)key2)->key);
@@ -81,7 +85,7 @@ int compare_string_keys(void* key1, void* key2) {
 avl_map_t* avl_map_create(char* (*key_as_string)(void*),
 			  char* (*data_as_string)(void*),
 			  int (*key_compare)(void*,void*)) {
-  avl_map_t* ret = malloc(sizeof *ret);
+  avl_map_t* ret = avl_alloc(sizeof *ret);
   ret->map = avl_make_empty_tree(key_compare);
   ret->key_as_string  = key_as_string;
   ret->data_as_string = data_as_string;
@@ -93,10 +97,15 @@ int avl_map_size (const avl_map_t* map) {
 }
 
 avl_map_t* avl_map_update(const avl_map_t* map, void* key, void* data) {
-  avl_map_t* new = malloc(sizeof *new);
   _avl_map_data_t* boxed_data = make_map_data(key, data);
+  avl_tree* tree = avl_insert(map->map, boxed_data);
+  if (tree == NULL) {
+    free(boxed_data);
+    return NULL;
+  }
 
-  new->map = avl_insert(map->map, boxed_data);
+  avl_map_t* new = avl_alloc(sizeof *new);
+  new->map = tree;
   new->key_as_string  = map->key_as_string;
   new->data_as_string = map->data_as_string;
   
@@ -104,31 +113,69 @@ avl_map_t* avl_map_update(const avl_map_t* map, void* key, void* data) {
 }
 avl_map_t* avl_map_update_mutable(avl_map_t* map, void* key, void* data) {
   avl_map_t* tmp = avl_map_update(map, key, data);
-  avl_map_unref(map);
+  if (tmp)
+    avl_map_unref(map);
   return tmp;
 }
 
+/* The probe only lives during the search. */
 void* avl_map_lookup(const avl_map_t* map, void* key) {
-  _avl_map_data_t* tmp = make_map_data(key, NULL);
-  _avl_map_data_t* data = avl_search(map->map, tmp);
-  free(tmp);
-  if (data) {
-    return data->data;
-  } else {
-    return NULL;
+  _avl_map_data_t probe = { .key = key, .data = NULL };
+  _avl_map_data_t* data = avl_search(map->map, &probe);
+  return data ? data->data : NULL;
+}
+
+/* The lookups by key compare it with the keys of the nodes, without probe
+   nor call through the compare of the map. */
+void* avl_map_lookup_key(const avl_map_t* map, void* key,
+			 int (*key_compare)(void*, void*)) {
+  imc_count(lookups, 1);
+  for (avl_node* node = map->map->root; node; ) {
+    _avl_map_data_t* data = node->data;
+    int comp = (*key_compare)(data->key, key);
+    imc_count(visited, 1);
+    if (comp == 0)
+      return data->data;
+    node = node->sons[comp < 0];
   }
+  return NULL;
+}
+
+void* avl_map_lookup_int(const avl_map_t* map, int key) {
+  imc_count(lookups, 1);
+  for (avl_node* node = map->map->root; node; ) {
+    _avl_map_data_t* data = node->data;
+    int node_key = *(int_box_t*)data->key;
+    imc_count(visited, 1);
+    if (node_key == key)
+      return data->data;
+    node = node->sons[node_key < key];
+  }
+  return NULL;
+}
+
+void* avl_map_lookup_string(const avl_map_t* map, const char* key) {
+  imc_count(lookups, 1);
+  for (avl_node* node = map->map->root; node; ) {
+    _avl_map_data_t* data = node->data;
+    int comp = strcmp(*(string_box_t*)data->key, key);
+    imc_count(visited, 1);
+    if (comp == 0)
+      return data->data;
+    node = node->sons[comp < 0];
+  }
+  return NULL;
 }
 
 avl_map_t* avl_map_remove(const avl_map_t* map, void* key, void** data) {
-  _avl_map_data_t* tmp = make_map_data(key, NULL);
+  _avl_map_data_t probe = { .key = key, .data = NULL };
   void* return_data = NULL;
 
-  avl_map_t* new = malloc(sizeof *new);
+  avl_map_t* new = avl_alloc(sizeof *new);
 
   new->key_as_string  = map->key_as_string;
   new->data_as_string = map->data_as_string;
-  new->map = avl_remove(map->map, tmp, &return_data);
-  free(tmp);
+  new->map = avl_remove(map->map, &probe, &return_data);
 
   if (return_data) {
     *data = ((_avl_map_data_t*)return_data)->data;
@@ -143,103 +190,118 @@ avl_map_t* avl_map_remove_mutable(avl_map_t* map, void* key, void** data) {
   return tmp;
 }
 
-void _map_keys_aux(avl_node* node, void** keys, int* index) {
-  if (node) {
-    keys[(*index)++] = ((_avl_map_data_t*)node->data)->key;
-    _map_keys_aux(node->sons[0], keys, index);
-    _map_keys_aux(node->sons[1], keys, index);
-  }
+/* A map of a tree, printed like map1. NULL without tree. */
+static avl_map_t* map_of_tree(const avl_map_t* map1, avl_tree* tree) {
+  if (tree == NULL)
+    return NULL;
+  avl_map_t* new = avl_alloc(sizeof *new);
+  new->map = tree;
+  new->key_as_string  = map1->key_as_string;
+  new->data_as_string = map1->data_as_string;
+  return new;
+}
+
+avl_map_t* avl_map_union(thread_pool_t* pool, const avl_map_t* map1,
+			 const avl_map_t* map2) {
+  return map_of_tree(map1, avl_union(pool, map1->map, map2->map));
+}
+
+avl_map_t* avl_map_intersection(thread_pool_t* pool, const avl_map_t* map1,
+				const avl_map_t* map2) {
+  return map_of_tree(map1, avl_intersection(pool, map1->map, map2->map));
+}
+
+avl_map_t* avl_map_difference(thread_pool_t* pool, const avl_map_t* map1,
+			      const avl_map_t* map2) {
+  return map_of_tree(map1, avl_difference(pool, map1->map, map2->map));
 }
 
 void** avl_map_keys(const avl_map_t* map) {
   void** keys = malloc(map->map->size * sizeof(*keys));
+  void *key, *data;
+  map_iterator_t iterator;
 
-  int index = 0;
-  _map_keys_aux(map->map->root, keys, &index);
+  avl_map_iterator_init(&iterator, map, 0);
+  for (int index = 0; avl_map_iterator_next(&iterator, &key, &data); index++)
+    keys[index] = key;
 
   return keys;
 }
 
 
-map_iterator_t* avl_map_create_iterator(const avl_map_t* map) {
-  map_iterator_t* iterator = malloc(sizeof *iterator);
-  iterator->current = map->map->root;
-  iterator->next    = NULL;
-
-  return iterator;
+void avl_map_iterator_init(map_iterator_t* iterator, const avl_map_t* map,
+			   int reverse) {
+  avl_iterator_init(&iterator->nodes, map->map, reverse);
 }
 
+void avl_map_iterator_seek(map_iterator_t* iterator, const avl_map_t* map,
+			   void* key, int reverse) {
+  _avl_map_data_t probe = { .key = key, .data = NULL };
+  avl_iterator_seek(&iterator->nodes, map->map, &probe, reverse);
+}
 
-int avl_map_iterator_next(map_iterator_t** iterator,
-			  void** key, void** data) {
-  map_iterator_t* deref_iter = *iterator;
-  if (deref_iter) {
-    avl_node* current = deref_iter->current;
-    *key  = ((_avl_map_data_t*)current->data)->key;
-    *data = ((_avl_map_data_t*)current->data)->data;
-    map_iterator_t* next = deref_iter->next;
-    for (int i = 0; i <= 1; i++) {
-      if (current->sons[i]) {
-	map_iterator_t* tmp = malloc(sizeof *tmp);
-	tmp->current = current->sons[i];
-	tmp->next = next;
-	next = tmp;
-      }
-    }
-    free(deref_iter);
-    *iterator = next;
-    return 1;
-  } else {
+int avl_map_iterator_next(map_iterator_t* iterator, void** key, void** data) {
+  avl_data_t* map_data;
+  if (!avl_iterator_next(&iterator->nodes, &map_data))
     return 0;
-  }
+  *key  = ((_avl_map_data_t*)map_data)->key;
+  *data = ((_avl_map_data_t*)map_data)->data;
+  return 1;
 }
 
 
 void avl_map_unref(avl_map_t* map) {
   if (map) {
     avl_erase_tree(map->map);
-    free(map);
+    avl_free(map, sizeof *map);
   }
 }
 
-int _max_key_size(avl_node* node, char* (*key_as_string)(void*)) {
-  if (node) {
-    int n = strlen((*key_as_string)(((_avl_map_data_t*)node->data)->key));
-    for (int i = 0; i <= 1; i++) {
-      if (node->sons[i]) {
-	int tmp = _max_key_size(node->sons[i], key_as_string);
-	n = MAX(n,tmp);
-      }
-    }
-    return n;
-  } else {
-    return 0;
-  }  
-}
-
-void _map_dump_aux(avl_node* node, int padding,
-		   char* (*key_as_string)(void*),
-		   char* (*data_as_string)(void*)) {
-  if (node) {
-    printf("\n\t%-*s => %s,", padding,
-	   (*key_as_string)(((_avl_map_data_t*)node->data)->key),
-	   (*data_as_string)(((_avl_map_data_t*)node->data)->data));
-    _map_dump_aux(node->sons[0], padding, key_as_string, data_as_string);
-    _map_dump_aux(node->sons[1], padding, key_as_string, data_as_string);
+avl_map_t* avl_map_promote(const avl_map_t* map) {
+  avl_map_t* new = avl_alloc(sizeof *new);
+  new->map = avl_promote_tree(map->map);
+  new->key_as_string = map->key_as_string;
+  new->data_as_string = map->data_as_string;
+  return new;
+}
+
+int _max_key_size(const avl_map_t* map) {
+  void *key, *data;
+  map_iterator_t iterator;
+  int n = 0;
+
+  avl_map_iterator_init(&iterator, map, 0);
+  while (avl_map_iterator_next(&iterator, &key, &data)) {
+    char* str = (*map->key_as_string)(key);
+    int tmp = strlen(str);
+    n = MAX(n,tmp);
+    free(str);
+  }
+  return n;
+}
+
+void _map_dump_aux(const avl_map_t* map, int padding) {
+  void *key, *data;
+  map_iterator_t iterator;
+
+  avl_map_iterator_init(&iterator, map, 0);
+  while (avl_map_iterator_next(&iterator, &key, &data)) {
+    char* key_str = (*map->key_as_string)(key);
+    char* data_str = (*map->data_as_string)(data);
+    printf("\n\t%-*s => %s,", padding, key_str, data_str);
+    free(key_str);
+    free(data_str);
   }
 }
 
 void avl_map_dump(const avl_map_t* map) {
   printf("{ ");
-  int padding = _max_key_size(map->map->root, map->key_as_string);
-  _map_dump_aux(map->map->root, padding,
-		map->key_as_string, map->data_as_string);
+  _map_dump_aux(map, _max_key_size(map));
   printf("\b \n}\n");
 }
 
 void avl_map_dump_fast(const avl_map_t* map) {
   printf("{ ");
-  _map_dump_aux(map->map->root, 0,
-		map->key_as_string, map->data_as_string);
+  _map_dump_aux(map, 0);
   printf("\b \n}\n");
 }
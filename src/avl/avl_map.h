@@ -1,13 +1,16 @@
 #ifndef _AVL_MAP
 #define _AVL_MAP
 
+#include "avl.h"
+
 /**
  * This API provides an implementation of immutable maps, based on AVL trees.
  * 
  * The maps being immutables, any functions that should modify a map actually
  * creates a new one, modifies it, and returns it.
  *
- * The order of the keys in the map is unspecified.
+ * The keys are kept in the order of their compare: avl_map_keys, the
+ * iterators and the dumps follow it.
  *
  * For genericity reasons, the type of the keys and data are void*. It means
  * that you can use anything as a key or a value, but you'll have to explicitly
@@ -29,8 +32,11 @@
 /** avl maps will all have the type avl_map_t */
 typedef struct _avl_map_t avl_map_t;
 
-/** iterators on avl map will have the type map_iterator_t */
-typedef struct _map_iterator_t map_iterator_t;
+/** iterators on avl map will have the type map_iterator_t. They are
+    declared by their user, on the stack for example: no iterator allocates. */
+typedef struct _map_iterator_t {
+  avl_iterator nodes;
+} map_iterator_t;
 
 /**********************
  * Boxing helpers 
@@ -43,6 +49,8 @@ int_box_t* make_int_box(int i) __attribute__((weak));
 char* int_box_as_string(void* data) __attribute__((weak));
 /** compares two integers. */
 int compare_int_keys(void* key1, void* key2) __attribute__((weak));
+/** compares two boxed integers, see avl_map_lookup_key. */
+int compare_int_boxes(void* box1, void* box2) __attribute__((weak));
 
 /** Boxing functions for strings (ie. char* ). */
 typedef char* string_box_t;
@@ -52,6 +60,8 @@ string_box_t* make_string_box(char* str) __attribute__((weak));
 char* string_box_as_string(void* data) __attribute__((weak));
 /** compares two strings. */
 int compare_string_keys(void* key1, void* key2) __attribute__((weak));
+/** compares two boxed strings, see avl_map_lookup_key. */
+int compare_string_boxes(void* box1, void* box2) __attribute__((weak));
 
 
 /**
@@ -93,7 +103,9 @@ int avl_map_size (const avl_map_t* map);
  * @param  map    The vector to update.
  * @param  key    The key which should be updated.
  * @param  data   The new data for map{keys}.
- * @return        The newly created map.
+ * @return        The newly created map, NULL if key is new to a map of
+ *                 AVL_MAX_SIZE keys (see avl.h). The _mutable version then
+ *                 keeps map.
  */
 avl_map_t* avl_map_update(const avl_map_t* map, void* key, void* data);
 avl_map_t* avl_map_update_mutable(avl_map_t* map, void* key, void* data);
@@ -109,6 +121,39 @@ avl_map_t* avl_map_update_mutable(avl_map_t* map, void* key, void* data);
  */
 void* avl_map_lookup(const avl_map_t* map, void* key);
 
+/**
+ * Get the value associated to a key of a map, comparing the key with the
+ * keys of the map themselves. Nothing is allocated.
+ *
+ * @param  map          The map to look in.
+ * @param  key          The key to look at.
+ * @param  key_compare  Compares a key of the map with key, in the order of
+ *                       the map (compare_int_boxes, compare_string_boxes).
+ * @return              The element associated to the key, or NULL.
+ */
+void* avl_map_lookup_key(const avl_map_t* map, void* key,
+			 int (*key_compare)(void*, void*));
+
+/**
+ * Get the value associated to a key of a map whose keys are int_box_t,
+ * compared by compare_int_keys, without boxing nor calling it.
+ *
+ * @param  map  The map to look in.
+ * @param  key  The key to look at.
+ * @return      The element associated to the key, or NULL.
+ */
+void* avl_map_lookup_int(const avl_map_t* map, int key);
+
+/**
+ * Get the value associated to a key of a map whose keys are string_box_t,
+ * compared by compare_string_keys, without boxing nor calling it.
+ *
+ * @param  map  The map to look in.
+ * @param  key  The key to look at.
+ * @return      The element associated to the key, or NULL.
+ */
+void* avl_map_lookup_string(const avl_map_t* map, const char* key);
+
 /**
  * Removes a key (and the value associated to it) from a map.
  * 
@@ -120,6 +165,43 @@ void* avl_map_lookup(const avl_map_t* map, void* key);
 avl_map_t* avl_map_remove(const avl_map_t* map, void* key, void** data);
 avl_map_t* avl_map_remove_mutable(avl_map_t* map, void* key, void** data);
 
+/**
+ * Combines two maps with the same key compare, for example the layers of a
+ * configuration: the keys of both, with the data of map2 for the keys they
+ * share. The maps share their nodes with the result, and it takes
+ * O(m log(n/m + 1)) for maps of sizes m <= n.
+ *
+ * @param  pool  A pool running the big halves in parallel, or NULL.
+ * @param  map1  The map whose data are overridden.
+ * @param  map2  The map whose data are kept.
+ * @return       The newly created map, NULL if the sizes of the maps add up
+ *                past AVL_MAX_SIZE.
+ */
+avl_map_t* avl_map_union(thread_pool_t* pool, const avl_map_t* map1,
+			 const avl_map_t* map2);
+
+/**
+ * The keys of map1 also in map2, with their data in map1. See avl_map_union.
+ *
+ * @param  pool  A pool running the big halves in parallel, or NULL.
+ * @param  map1  The map whose data are kept.
+ * @param  map2  The map whose keys are kept.
+ * @return       The newly created map.
+ */
+avl_map_t* avl_map_intersection(thread_pool_t* pool, const avl_map_t* map1,
+				const avl_map_t* map2);
+
+/**
+ * The keys of map1 not in map2, with their data. See avl_map_union.
+ *
+ * @param  pool  A pool running the big halves in parallel, or NULL.
+ * @param  map1  The map whose keys are kept.
+ * @param  map2  The map whose keys are removed.
+ * @return       The newly created map.
+ */
+avl_map_t* avl_map_difference(thread_pool_t* pool, const avl_map_t* map1,
+			      const avl_map_t* map2);
+
 /**
  * Returns the list (more precisely an array) of the keys of a map.
  * It doesn't return the size of the array. You can this information by
@@ -131,33 +213,47 @@ avl_map_t* avl_map_remove_mutable(avl_map_t* map, void* key, void** data);
 void** avl_map_keys(const avl_map_t* map);
 
 /**
- * Creates an iterator to iterate through the map keys/values.
+ * Starts an iterator at the first key of a map, or its last key if reverse.
+ * The map must outlive the iterator.
  *
- * @param  map  The map on which the iterator will iterate.
- * @return      The newly created iterator
+ * @param[out] iterator  The iterator to start.
+ * @param[in]  map       The map on which the iterator will iterate.
+ * @param[in]  reverse   1 to iterate from the last key to the first one.
  */
-map_iterator_t* avl_map_create_iterator(const avl_map_t* map);
+void avl_map_iterator_init(map_iterator_t* iterator, const avl_map_t* map,
+			   int reverse);
 
 /**
- * Iterates through a map thanks to a map_iterator_t object.
- * Note that the order in which the iterator goes through the map is undefined.
- * In particular, in most cases, it won't be the same as avl_map_keys.
- * Moreover, you'll always want to check the return value. A typical use is:
+ * Starts an iterator at the first key not lower than key, or at the last key
+ * not higher than key if reverse: the beginning of a range read.
+ *
+ * @param[out] iterator  The iterator to start.
+ * @param[in]  map       The map on which the iterator will iterate.
+ * @param[in]  key       The bound of the keys.
+ * @param[in]  reverse   1 to iterate from the bound down to the first key.
+ */
+void avl_map_iterator_seek(map_iterator_t* iterator, const avl_map_t* map,
+			   void* key, int reverse);
+
+/**
+ * Iterates through a map thanks to a map_iterator_t object, in the order of
+ * the keys (or the reverse order). You'll always want to check the return
+ * value. A typical use is:
  *   void *key, *data;
- *   map_iterator_t* iter = avl_map_create_iterator(map);
- *   while ( avl_map_iterator_next(&iter, &key, &data) != 0 ) { 
+ *   map_iterator_t iter;
+ *   avl_map_iterator_init(&iter, map, 0);
+ *   while ( avl_map_iterator_next(&iter, &key, &data) != 0 ) {
  *     // do stuff with key and data.
  *   }
- * 
- * 
- * @param[in,out] iterator  The iterator created by avl_map_create_iterator.
+ *
+ * @param[in,out] iterator  The iterator started by avl_map_iterator_init or
+ *                          avl_map_iterator_seek.
  * @param[out]    key       The key of the next element in the map.
- * @param[in]     data      The data of the next element in the map.
+ * @param[out]    data      The data of the next element in the map.
  * @return                  0 if the iterator is at then end of the map,
  *                          1 otherwise.
  */
-int avl_map_iterator_next(map_iterator_t** iterator,
-			  void** key, void** data);
+int avl_map_iterator_next(map_iterator_t* iterator, void** key, void** data);
 
 /**
  * Destroys a map.
@@ -169,6 +265,16 @@ int avl_map_iterator_next(map_iterator_t** iterator,
  */
 void avl_map_unref(avl_map_t* map);
 
+/**
+ * Promotes a map created in an arena scope, to keep it once the arena is
+ * freed. The nodes allocated in arenas are copied, the others are shared.
+ * It must be called once the scope is left (see imc_arena.h).
+ *
+ * @param  map  The map you wish to keep.
+ * @return      A new map, with the same elements.
+ */
+avl_map_t* avl_map_promote(const avl_map_t* map);
+
 /**
  * Prints a map to stdout. The format of the print is:
  *  {
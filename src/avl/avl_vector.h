@@ -22,6 +22,10 @@
  * This will do the same as the immutable version, but also unref the vector(s)
  * that are given as parameters.
  *
+ * A vector holds at most AVL_MAX_SIZE elements (see avl.h): the functions
+ * which would grow it past that return NULL, and the _mutable ones then
+ * keep their parameters.
+ *
  * @example vector_main.c
  */
 
@@ -78,7 +82,7 @@ int avl_vector_size (const avl_vector_t* vec);
  * @param  vec    The vector to update.
  * @param  index  The index which should be updated.
  * @param  data   The new data for vec[index].
- * @return        The newly created vector.
+ * @return        The newly created vector, NULL past AVL_MAX_SIZE.
  */
 avl_vector_t* avl_vector_update(const avl_vector_t* vec, int index,
 				void* data);
@@ -103,7 +107,7 @@ void* avl_vector_lookup(const avl_vector_t* vec, int index);
  * 
  * @param  vec   The vector to update.
  * @param  data  The data to add in the vector.
- * @return       The newly created vector.
+ * @return       The newly created vector, NULL if vec is full.
  */
 avl_vector_t* avl_vector_push(const avl_vector_t* vec, void* data);
 avl_vector_t* avl_vector_push_mutable(avl_vector_t* vec, void* data);
@@ -125,7 +129,7 @@ avl_vector_t* avl_vector_pop_mutable(avl_vector_t* vec, void** data);
  * @param  vec_front  The vector that will go in first position.
  * @param  vec_tail   The vector that will go in last position.
  * @return            The vector resulting from the concatenation of vec_front
- *                     and vec_tail.
+ *                     and vec_tail, NULL past AVL_MAX_SIZE elements.
  * */
 avl_vector_t* avl_vector_merge(const avl_vector_t* vec_front,
 			       const avl_vector_t* vec_tail);
@@ -157,6 +161,16 @@ int avl_vector_split_mutable(avl_vector_t* vec_in, int index,
  */
 void avl_vector_unref(avl_vector_t* vec);
 
+/**
+ * Promotes a vector created in an arena scope, to keep it once the arena is
+ * freed. The nodes allocated in arenas are copied, the others are shared.
+ * It must be called once the scope is left (see imc_arena.h).
+ *
+ * @param  vec  The vector you wish to keep.
+ * @return      A new vector, with the same elements.
+ */
+avl_vector_t* avl_vector_promote(const avl_vector_t* vec);
+
 /**
  * Prints a vector to stdout. The format of the print is:
  * [ _, 1, _, 5 ] for a vector of int where _ represents empty cells.
@@ -48,13 +48,20 @@ int main () {
   printf("\b\b ]\n");
 
   printf("\nNow testing the iterator :\n");
-  map_iterator_t* iterator = avl_map_create_iterator(map);
+  map_iterator_t iterator;
+  avl_map_iterator_init(&iterator, map, 0);
   void* key = NULL;
   data = NULL;
   while ( avl_map_iterator_next(&iterator, &key, &data) != 0 ) {
     printf(" -> map{%s} = %d\n", *((string_box_t*)key), *((int_box_t*)data));
   }
 
+  printf("\nFrom \"Fourth\" down to the first key:\n");
+  avl_map_iterator_seek(&iterator, map, make_string_box("Fourth"), 1);
+  while ( avl_map_iterator_next(&iterator, &key, &data) != 0 ) {
+    printf(" -> map{%s} = %d\n", *((string_box_t*)key), *((int_box_t*)data));
+  }
+
   printf("\nCreating an int-char map to test genericity\n");
   avl_map_t* map2 = avl_map_create(int_box_as_string,
 				   string_box_as_string,
@@ -65,6 +72,18 @@ int main () {
   map2 = avl_map_update(map2, make_int_box(4), make_string_box("Fifth"));
   avl_map_dump(map2);
   
+  printf("\nCombining it with a layer overriding 2 and adding 5:\n");
+  avl_map_t* layer = avl_map_create(int_box_as_string,
+				    string_box_as_string,
+				    compare_int_keys);
+  layer = avl_map_update(layer, make_int_box(2), make_string_box("Deux"));
+  layer = avl_map_update(layer, make_int_box(5), make_string_box("Cinq"));
+  avl_map_dump(avl_map_union(NULL, map2, layer));
+  printf("Keys of both:\n");
+  avl_map_dump(avl_map_intersection(NULL, map2, layer));
+  printf("Keys of the first only:\n");
+  avl_map_dump(avl_map_difference(NULL, map2, layer));
+
   printf("\n\n");
   
   return 0;
@@ -0,0 +1,625 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "avl.h"
+#include "avl_vector.h"
+#include "avl_map.h"
+#include "imc_pool.h"
+#include "imc_reclaim.h"
+
+/* Checks of the AVL trees, run by make test. Each check exits on failure. */
+#define check(x) if (! (x) ) {						\
+    fprintf(stderr, "Check '%s' false, file %s line %d.\n",		\
+	    #x, __FILE__, __LINE__);					\
+    exit(EXIT_FAILURE);							\
+  }
+
+#define N 20000
+
+/* The data of the trees: ints, from 0 to N - 1. */
+static int ints[N];
+
+static int compare_ints(avl_data_t* a, avl_data_t* b) {
+  int x = *(int*) a, y = *(int*) b;
+  return x == y ? 0 : x < y ? -1 : 1;
+}
+
+/* Checks the balances and the sizes of a subtree, and returns its height. */
+static int check_node(avl_node* node) {
+  if (node == NULL)
+    return 0;
+  int h_left = check_node(node->sons[0]);
+  int h_right = check_node(node->sons[1]);
+  int size_left = node->sons[0] ? (int) node->sons[0]->size : 0;
+  int size_right = node->sons[1] ? (int) node->sons[1]->size : 0;
+  check(node->balance == h_right - h_left);
+  check(node->balance >= -1 && node->balance <= 1);
+  check((int) node->size == 1 + size_left + size_right);
+  return 1 + (h_left > h_right ? h_left : h_right);
+}
+
+/* Checks that a tree is balanced, and holds the size data, in order. */
+static void check_tree(avl_tree* tree, avl_data_t** data, int size) {
+  static avl_data_t* found[N];
+  check(tree->size == size);
+  check_node(tree->root);
+  avl_flatten(tree, found);
+  for (int i = 0; i < size; i++)
+    check(found[i] == data[i]);
+}
+
+/* A tree of the size first data, in order, and a copy of them. */
+static avl_tree* make_tree(int (*compare)(avl_data_t*, avl_data_t*),
+			   avl_data_t** data, int size, avl_data_t** copy) {
+  avl_tree* tree = avl_make_empty_tree(compare);
+  for (int i = 0; i < size; i++) {
+    avl_tree* next = avl_insert_at(tree, i, data[i]);
+    avl_erase_tree(tree);
+    tree = next;
+    copy[i] = data[i];
+  }
+  return tree;
+}
+
+/*******************
+ *     Ranks       *
+ *******************/
+
+/* Random inserts, updates and removes by rank on a history: each version is
+   checked against an array, and the previous one must be left as it was. */
+static void rank_test() {
+  static avl_data_t* data[N];
+  static avl_data_t* next_data[N];
+  int size = 0;
+  avl_tree* tree = avl_make_empty_tree(NULL);
+
+  for (int step = 0; step < 4000; step++) {
+    // Grows in the first half, shrinks in the second one.
+    int r = rand() % 4;
+    int op = size == 0 ? 0 : step < 2000 ? (r < 2 ? 0 : r - 1) : (r < 2 ? r : 2);
+    int index = rand() % (op == 0 ? size + 1 : size);
+    avl_data_t* item = &ints[rand() % N];
+    avl_tree* next;
+    int next_size = size;
+
+    for (int i = 0; i < size; i++)
+      next_data[i] = data[i];
+    if (op == 0) {
+      next = avl_insert_at(tree, index, item);
+      for (int i = size; i > index; i--)
+	next_data[i] = next_data[i - 1];
+      next_data[index] = item;
+      next_size++;
+    } else if (op == 1) {
+      next = avl_update_at(tree, index, item);
+      next_data[index] = item;
+    } else {
+      avl_data_t* removed;
+      next = avl_remove_at(tree, index, &removed);
+      check(removed == data[index]);
+      for (int i = index; i < size - 1; i++)
+	next_data[i] = next_data[i + 1];
+      next_size--;
+    }
+
+    check_tree(next, next_data, next_size);
+    check_tree(tree, data, size);
+    for (int i = 0; i < next_size; i++)
+      check(avl_search_at(next, i) == next_data[i]);
+
+    avl_erase_tree(tree);
+    tree = next;
+    size = next_size;
+    for (int i = 0; i < size; i++)
+      data[i] = next_data[i];
+  }
+  avl_erase_tree(tree);
+}
+
+/* The same by key, on a skewed set of keys: the removes rebalance shared
+   nodes, which must be copied first. */
+static void key_test() {
+  static avl_data_t* data[N];
+  static char in[N];
+  static char next_in[N];
+  int keys = 600;
+  avl_tree* tree = avl_make_empty_tree(compare_ints);
+
+  for (int step = 0; step < 6000; step++) {
+    int key = rand() % keys;
+    key = key * key / keys;
+    avl_tree* next;
+    for (int k = 0; k < keys; k++)
+      next_in[k] = in[k];
+    if (rand() % 2) {
+      next = avl_insert(tree, &ints[key]);
+      next_in[key] = 1;
+    } else {
+      avl_data_t* removed;
+      next = avl_remove(tree, &ints[key], &removed);
+      check(removed == (in[key] ? &ints[key] : NULL));
+      next_in[key] = 0;
+    }
+
+    int size = 0, next_size = 0;
+    for (int k = 0; k < keys; k++)
+      if (in[k])
+	data[size++] = &ints[k];
+    check_tree(tree, data, size);
+    for (int k = 0; k < keys; k++)
+      if (next_in[k])
+	data[next_size++] = &ints[k];
+    check_tree(next, data, next_size);
+
+    avl_erase_tree(tree);
+    tree = next;
+    for (int k = 0; k < keys; k++)
+      in[k] = next_in[k];
+  }
+  avl_erase_tree(tree);
+}
+
+/*******************
+ *  Join and split *
+ *******************/
+
+/* Trees of random sizes, very different or not, joined then split at every
+   kind of rank. The sources must be left as they were. */
+static void join_split_test() {
+  static avl_data_t* data[N];
+  static avl_data_t* left[N];
+  static avl_data_t* right[N];
+  static avl_data_t* all[N];
+
+  for (int i = 0; i < N; i++)
+    data[i] = &ints[i];
+  for (int round = 0; round < 300; round++) {
+    int size_left = rand() % (round % 3 == 0 ? 8 : 3000);
+    int size_right = rand() % (round % 3 == 1 ? 8 : 3000);
+    avl_tree* tree1 = make_tree(NULL, data, size_left, left);
+    avl_tree* tree2 = make_tree(NULL, data + size_left + 1, size_right, right);
+    int size = size_left + 1 + size_right;
+    for (int i = 0; i < size; i++)
+      all[i] = data[i];
+
+    avl_tree* joined = avl_join(tree1, data[size_left], tree2);
+    check_tree(joined, all, size);
+    avl_tree* concat = avl_concat(tree1, tree2);
+    for (int i = 0; i < size_right; i++)
+      all[size_left + i] = right[i];
+    check_tree(concat, all, size_left + size_right);
+    for (int i = 0; i < size; i++)
+      all[i] = data[i];
+    check_tree(tree1, left, size_left);
+    check_tree(tree2, right, size_right);
+
+    int ranks[] = { -1, 0, 1, rand() % (size + 1), size - 1, size, size + 1 };
+    for (int r = 0; r < (int) (sizeof ranks / sizeof *ranks); r++) {
+      int index = ranks[r];
+      int cut = index < 0 ? 0 : index > size ? size : index;
+      avl_tree *part1, *part2;
+      avl_split_at(joined, index, &part1, &part2);
+      check_tree(part1, all, cut);
+      check_tree(part2, all + cut, size - cut);
+      avl_erase_tree(part1);
+      avl_erase_tree(part2);
+    }
+    check_tree(joined, all, size);
+
+    avl_erase_tree(joined);
+    avl_erase_tree(concat);
+    avl_erase_tree(tree1);
+    avl_erase_tree(tree2);
+  }
+}
+
+/*******************
+ * Set operations  *
+ *******************/
+
+/* The same ints at other addresses, to tell which tree the data come from. */
+static int twins[N];
+
+/* The tree of the keys in a set, with their data in values. */
+static avl_tree* make_set(int* values, char* in, int keys) {
+  avl_tree* tree = avl_make_empty_tree(compare_ints);
+  for (int k = 0; k < keys; k++)
+    if (in[k]) {
+      avl_tree* next = avl_insert(tree, &values[k]);
+      avl_erase_tree(tree);
+      tree = next;
+    }
+  return tree;
+}
+
+enum { UNION, INTERSECTION, DIFFERENCE, MERGE };
+
+/* Checks that a tree is the result of an operation on the sets in1 and
+   in2, whose data are in values1 and values2. */
+static void check_set(avl_tree* tree, int operation, char* in1, char* in2,
+		      int* values1, int* values2, int keys) {
+  static avl_data_t* data[N];
+  int size = 0;
+  for (int k = 0; k < keys; k++)
+    switch (operation) {
+    case UNION:
+      if (in2[k])
+	data[size++] = &values2[k];
+      else if (in1[k])
+	data[size++] = &values1[k];
+      break;
+    case MERGE:
+      if (in1[k])
+	data[size++] = &values1[k];
+      else if (in2[k])
+	data[size++] = &values2[k];
+      break;
+    case INTERSECTION:
+      if (in1[k] && in2[k])
+	data[size++] = &values1[k];
+      break;
+    case DIFFERENCE:
+      if (in1[k] && ! in2[k])
+	data[size++] = &values1[k];
+      break;
+    }
+  check_tree(tree, data, size);
+}
+
+/* All the operations on tree1 and tree2, checked with their sources. */
+static void check_operations(thread_pool_t* pool, avl_tree* tree1, avl_tree* tree2,
+			     char* in1, char* in2, int* values1, int* values2,
+			     int keys) {
+  avl_tree* results[] = {
+    avl_union(pool, tree1, tree2),
+    avl_intersection(pool, tree1, tree2),
+    avl_difference(pool, tree1, tree2),
+    avl_merge(tree1, tree2),
+  };
+  for (int operation = UNION; operation <= MERGE; operation++) {
+    check_set(results[operation], operation, in1, in2, values1, values2, keys);
+    avl_erase_tree(results[operation]);
+  }
+  check_set(tree1, MERGE, in1, in1, values1, values1, keys);
+  check_set(tree2, MERGE, in2, in2, values2, values2, keys);
+}
+
+/* Sets of every density, sequentially and then with a pool on subtrees
+   above AVL_PAR_CUTOFF; then versions of a tree sharing their subtrees. */
+static void set_test() {
+  static char in1[N];
+  static char in2[N];
+  int keys = 10000; /* Well above the cutoff of 2048 nodes of avl.c. */
+  int densities[] = { 0, 1, 30, 90, 100 };
+  int n_densities = sizeof densities / sizeof *densities;
+  thread_pool_t* pool = thread_pool_create(4);
+
+  for (int i = 0; i < N; i++)
+    twins[i] = i;
+  for (int parallel = 0; parallel < 2; parallel++)
+    for (int d1 = 0; d1 < n_densities; d1++)
+      for (int d2 = 0; d2 < n_densities; d2++) {
+	for (int k = 0; k < keys; k++) {
+	  in1[k] = rand() % 100 < densities[d1];
+	  in2[k] = rand() % 100 < densities[d2];
+	}
+	avl_tree* tree1 = make_set(ints, in1, keys);
+	avl_tree* tree2 = make_set(twins, in2, keys);
+	check_operations(parallel ? pool : NULL, tree1, tree2,
+			 in1, in2, ints, twins, keys);
+	avl_erase_tree(tree1);
+	avl_erase_tree(tree2);
+      }
+
+  for (int parallel = 0; parallel < 2; parallel++) {
+    thread_pool_t* p = parallel ? pool : NULL;
+    for (int k = 0; k < keys; k++)
+      in1[k] = in2[k] = rand() % 2;
+    avl_tree* tree = make_set(ints, in1, keys);
+    check_operations(p, tree, tree, in1, in1, ints, ints, keys);
+
+    for (int round = 0; round < 20; round++) {
+      int key = rand() % keys;
+      avl_tree* other;
+      if (in1[key]) {
+	avl_data_t* removed;
+	other = avl_remove(tree, &ints[key], &removed);
+      } else
+	other = avl_insert(tree, &ints[key]);
+      in2[key] = ! in1[key];
+      check_operations(p, tree, other, in1, in2, ints, ints, keys);
+      check_operations(p, other, tree, in2, in1, ints, ints, keys);
+      avl_erase_tree(other);
+      in2[key] = in1[key];
+    }
+    avl_erase_tree(tree);
+  }
+  thread_pool_free(pool);
+}
+
+/*******************
+ *   Map lookups   *
+ *******************/
+
+#define KEYS 3000
+
+/* The string keys, named so that strcmp keeps the order of the ints. */
+static char names[2 * KEYS + 1][8];
+static string_box_t name_boxes[2 * KEYS + 1];
+
+/* Checks every lookup of an int map and a string map holding the data
+   found[k] at key k, from below the first key to past the last one. */
+static void check_lookups(avl_map_t* int_map, avl_map_t* string_map,
+			  int** found) {
+  char name[8];
+  string_box_t box = name;
+  for (int k = -1; k <= 2 * KEYS + 1; k++) {
+    int* data = k >= 0 && k <= 2 * KEYS ? found[k] : NULL;
+    int key = k;
+    check(avl_map_lookup(int_map, &key) == data);
+    check(avl_map_lookup_key(int_map, &key, compare_int_boxes) == data);
+    check(avl_map_lookup_int(int_map, k) == data);
+    sprintf(name, k < 0 ? "k" : "k%05d", k);
+    check(avl_map_lookup(string_map, &box) == data);
+    check(avl_map_lookup_key(string_map, &box, compare_string_boxes) == data);
+    check(avl_map_lookup_string(string_map, name) == data);
+  }
+  check(avl_map_lookup_string(string_map, "z") == NULL);
+}
+
+/* Maps on the even keys, some updated then removed: the lookups by probe,
+   by raw key and by typed key must agree with the reference, in the new
+   maps and in the old ones. */
+static void map_test() {
+  static int* found[2 * KEYS + 1];
+  static int* old_found[2 * KEYS + 1];
+  avl_map_t* int_map = avl_map_create(int_box_as_string, int_box_as_string,
+				      compare_int_keys);
+  avl_map_t* string_map = avl_map_create(string_box_as_string,
+					 int_box_as_string,
+					 compare_string_keys);
+
+  for (int k = 0; k <= 2 * KEYS; k++) {
+    sprintf(names[k], "k%05d", k);
+    name_boxes[k] = names[k];
+  }
+  for (int i = 0; i < KEYS; i++) {
+    int k = 2 * (rand() % KEYS);
+    found[k] = &ints[k];
+    int_map = avl_map_update_mutable(int_map, &ints[k], &ints[k]);
+    string_map = avl_map_update_mutable(string_map, &name_boxes[k], &ints[k]);
+  }
+  check_lookups(int_map, string_map, found);
+
+  avl_map_t* old_int_map = int_map;
+  avl_map_t* old_string_map = string_map;
+  for (int k = 0; k <= 2 * KEYS; k++)
+    old_found[k] = found[k];
+  for (int i = 0; i < KEYS / 2; i++) {
+    int k = 2 * (rand() % KEYS);
+    avl_map_t *next_int_map, *next_string_map;
+    if (rand() % 2) {
+      found[k] = &twins[k];
+      next_int_map = avl_map_update(int_map, &ints[k], &twins[k]);
+      next_string_map = avl_map_update(string_map, &name_boxes[k], &twins[k]);
+    } else {
+      void *int_data = NULL, *string_data = NULL;
+      next_int_map = avl_map_remove(int_map, &ints[k], &int_data);
+      next_string_map = avl_map_remove(string_map, &name_boxes[k], &string_data);
+      check(int_data == found[k] && string_data == found[k]);
+      found[k] = NULL;
+    }
+    if (int_map != old_int_map) {
+      avl_map_unref(int_map);
+      avl_map_unref(string_map);
+    }
+    int_map = next_int_map;
+    string_map = next_string_map;
+  }
+  check_lookups(int_map, string_map, found);
+  check_lookups(old_int_map, old_string_map, old_found);
+
+  avl_map_unref(int_map);
+  avl_map_unref(string_map);
+  avl_map_unref(old_int_map);
+  avl_map_unref(old_string_map);
+}
+
+/*******************
+ *    Iterators    *
+ *******************/
+
+/* Checks that an iterator yields data from first, up to the end of data
+   or down to its beginning if reverse. */
+static void check_iterator(avl_iterator* it, avl_data_t** data, int size,
+			   int first, int reverse) {
+  avl_data_t* next;
+  for (int i = first; i >= 0 && i < size; i += reverse ? -1 : 1)
+    check(avl_iterator_next(it, &next) && next == data[i]);
+  check(avl_iterator_next(it, &next) == 0);
+  check(avl_iterator_next(it, &next) == 0);
+}
+
+/* Sets of every size, iterated from both ends, then from bounds in and out
+   of their keys, in both directions; the same through the maps. */
+static void iterator_test() {
+  static avl_data_t* data[N];
+  static char in[N];
+  avl_iterator it;
+
+  for (int round = 0; round < 40; round++) {
+    int keys = round < 8 ? round : rand() % 6000;
+    for (int k = 0; k < keys; k++)
+      in[k] = rand() % 3 == 0;
+    avl_tree* tree = make_set(ints, in, keys);
+    int size = 0;
+    for (int k = 0; k < keys; k++)
+      if (in[k])
+	data[size++] = &ints[k];
+
+    avl_iterator_init(&it, tree, 0);
+    check_iterator(&it, data, size, 0, 0);
+    avl_iterator_init(&it, tree, 1);
+    check_iterator(&it, data, size, size - 1, 1);
+
+    for (int i = 0; i < 60; i++) {
+      int bound = round < 8 ? i % (keys + 4) - 2 : rand() % (keys + 4) - 2;
+      int first = 0;
+      while (first < size && *(int*) data[first] < bound)
+	first++;
+      avl_iterator_seek(&it, tree, &bound, 0);
+      check_iterator(&it, data, size, first, 0);
+      if (first == size || *(int*) data[first] != bound)
+	first--;
+      avl_iterator_seek(&it, tree, &bound, 1);
+      check_iterator(&it, data, size, first, 1);
+    }
+
+    avl_map_t* map = avl_map_create(int_box_as_string, int_box_as_string,
+				    compare_int_keys);
+    for (int i = 0; i < size; i++)
+      map = avl_map_update_mutable(map, data[i], &twins[*(int*) data[i]]);
+    void** map_keys = avl_map_keys(map);
+    for (int i = 0; i < size; i++)
+      check(map_keys[i] == data[i]);
+    free(map_keys);
+
+    map_iterator_t map_it;
+    void *key, *value;
+    for (int reverse = 0; reverse < 2; reverse++) {
+      int bound = rand() % (keys + 4) - 2;
+      int first = 0;
+      while (first < size && *(int*) data[first] < bound)
+	first++;
+      if (reverse && (first == size || *(int*) data[first] != bound))
+	first--;
+      avl_map_iterator_seek(&map_it, map, &bound, reverse);
+      for (int i = first; i >= 0 && i < size; i += reverse ? -1 : 1) {
+	check(avl_map_iterator_next(&map_it, &key, &value));
+	check(key == data[i] && value == &twins[*(int*) key]);
+      }
+      check(avl_map_iterator_next(&map_it, &key, &value) == 0);
+
+      avl_map_iterator_init(&map_it, map, reverse);
+      for (int i = 0; i < size; i++) {
+	check(avl_map_iterator_next(&map_it, &key, &value));
+	check(key == data[reverse ? size - 1 - i : i]);
+      }
+      check(avl_map_iterator_next(&map_it, &key, &value) == 0);
+    }
+
+    avl_map_unref(map);
+    avl_erase_tree(tree);
+  }
+}
+
+/*******************
+ *   Reclamation   *
+ *******************/
+
+static void reclaim_test() {
+  // At most 4 nodes freed per call, the shared ones stay alive.
+  imc_reclaim_set_budget(4);
+  avl_vector_t* vec = avl_vector_create(int_box_as_string);
+  for (int i = 0; i < N; i++)
+    vec = avl_vector_push_mutable(vec, &ints[i]);
+  avl_vector_t *half, *rest;
+  avl_vector_split(vec, N / 2 - 1, &half, &rest);
+  avl_vector_unref(vec);
+  avl_vector_unref(rest);
+  check(imc_reclaim_pending() > 0);
+  for (int i = 0; i < N / 2; i++)
+    check(*(int*) avl_vector_lookup(half, i) == i);
+  avl_vector_unref(half);
+  imc_reclaim_drain();
+  check(imc_reclaim_pending() == 0);
+  imc_reclaim_set_budget(0);
+
+  // Freed by the background thread, while the history goes on.
+  check(imc_reclaim_start());
+  avl_tree* tree = avl_make_empty_tree(compare_ints);
+  for (int i = 0; i < N; i++) {
+    avl_tree* next = avl_insert(tree, &ints[(i * 7919) % N]);
+    avl_erase_tree(tree);
+    tree = next;
+  }
+  check(tree->size == N);
+  for (int i = 0; i < N; i++)
+    check(avl_search(tree, &ints[i]) == &ints[i]);
+  vec = avl_vector_create(int_box_as_string);
+  for (int i = 0; i < N; i++) {
+    avl_vector_t* next = avl_vector_push(vec, &ints[i]);
+    avl_vector_unref(vec);
+    vec = next;
+  }
+  avl_vector_unref(vec);
+  imc_reclaim_stop();
+  check(imc_reclaim_pending() == 0);
+
+  // A background thread which only frees: its frees are counted once it
+  // exits, the nodes of the tree, and its header freed by this thread.
+  imc_pool_stats_t before, after;
+  imc_pool_stats(&before);
+  check(imc_reclaim_start());
+  avl_erase_tree(tree);
+  imc_reclaim_stop();
+  imc_pool_stats(&after);
+  check(after.allocs == before.allocs);
+  check(after.frees - before.frees == N + 1);
+}
+
+/*******************
+ *      Limit      *
+ *******************/
+
+/* The header of a full tree, around a small one: nothing grows it. */
+static void limit_test() {
+  avl_tree* small = avl_make_empty_tree(compare_ints);
+  for (int i = 0; i < 10; i++)
+    avl_insert_mutable(small, &ints[i]);
+  avl_tree full = *small;
+  full.size = AVL_MAX_SIZE;
+
+  check(avl_insert(&full, &ints[10]) == NULL);
+  check(avl_insert_at(&full, 0, &ints[10]) == NULL);
+  check(avl_join(&full, &ints[10], small) == NULL);
+  check(avl_concat(small, &full) == NULL);
+  check(avl_union(NULL, &full, small) == NULL);
+
+  // Data already in the tree only replace their node.
+  avl_tree* same = avl_insert(&full, &ints[3]);
+  check(same != NULL && same->size == AVL_MAX_SIZE);
+  avl_erase_tree(same);
+  avl_erase_tree(small);
+}
+
+int main() {
+  imc_pool_stats_t before, after;
+  imc_pool_stats(&before);
+  for (int i = 0; i < N; i++)
+    ints[i] = i;
+
+  rank_test();
+  printf("ranks: ok\n");
+  key_test();
+  printf("keys: ok\n");
+  join_split_test();
+  printf("join and split: ok\n");
+  set_test();
+  printf("sets: ok\n");
+  map_test();
+  printf("maps: ok\n");
+  iterator_test();
+  printf("iterators: ok\n");
+
+  reclaim_test();
+  printf("reclaim: ok\n");
+  limit_test();
+  printf("limit: ok\n");
+
+  // Every node was given back.
+  imc_pool_stats(&after);
+  check(after.allocs - before.allocs == after.frees - before.frees);
+
+  return 0;
+}
@@ -0,0 +1,136 @@
+#include "avl_map.h"
+#include "avl_vector.h"
+#include "bench_backend.h"
+
+/* The data are boxed, as with any user of the AVL vectors and maps, but the
+   commands are their own boxes: an int_box_t* or a string_box_t* to their
+   data or key. The structures don't free them, so the runs share them, and
+   no box is allocated while timing. */
+static void* data_box(Prog* prog, command* cmd) {
+  (void) prog;
+  return &cmd->data;
+}
+
+static void* key_box(Prog* prog, command* cmd) {
+  (void) prog;
+  return &cmd->key;
+}
+
+/*******************
+ *     Vectors     *
+ *******************/
+
+static void vector_create(Prog* prog, command* cmd, void** vars) {
+  vars[cmd->obj_out] = avl_vector_create(prog->data_type == INT ?
+					 int_box_as_string :
+					 string_box_as_string);
+}
+
+static void vector_unref(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_vector_unref(vars[cmd->obj_in]);
+}
+
+static void vector_update(Prog* prog, command* cmd, void** vars) {
+  vars[cmd->obj_out] = avl_vector_update(vars[cmd->obj_in], cmd->index,
+					 data_box(prog, cmd));
+}
+
+static void vector_push(Prog* prog, command* cmd, void** vars) {
+  vars[cmd->obj_out] = avl_vector_push(vars[cmd->obj_in], data_box(prog, cmd));
+}
+
+static void vector_pop(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  void* data;
+  vars[cmd->obj_out] = avl_vector_pop(vars[cmd->obj_in], &data);
+}
+
+static void vector_merge(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = avl_vector_merge(vars[cmd->obj_in], vars[cmd->obj_aux]);
+}
+
+static void vector_split(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_vector_split(vars[cmd->obj_in], cmd->index,
+		   (avl_vector_t**) &vars[cmd->obj_out],
+		   (avl_vector_t**) &vars[cmd->obj_aux]);
+}
+
+static void vector_lookup(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_vector_lookup(vars[cmd->obj_in], cmd->index);
+}
+
+static void vector_size(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_vector_size(vars[cmd->obj_in]);
+}
+
+static void vector_dump(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_vector_dump(vars[cmd->obj_in]);
+}
+
+/*******************
+ *      Maps       *
+ *******************/
+
+static void map_create(Prog* prog, command* cmd, void** vars) {
+  vars[cmd->obj_out] =
+    avl_map_create(
+      prog->key_type  == INT ? int_box_as_string : string_box_as_string,
+      prog->data_type == INT ? int_box_as_string : string_box_as_string,
+      prog->key_type  == INT ? compare_int_keys  : compare_string_keys  );
+}
+
+static void map_unref(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_map_unref(vars[cmd->obj_in]);
+}
+
+static void map_update(Prog* prog, command* cmd, void** vars) {
+  vars[cmd->obj_out] = avl_map_update(vars[cmd->obj_in], key_box(prog, cmd),
+				      data_box(prog, cmd));
+}
+
+static void map_remove(Prog* prog, command* cmd, void** vars) {
+  void* data;
+  vars[cmd->obj_out] = avl_map_remove(vars[cmd->obj_in], key_box(prog, cmd),
+				      &data);
+}
+
+/* The keys are compared as they are, without their boxes. */
+static void map_lookup(Prog* prog, command* cmd, void** vars) {
+  if (prog->key_type == INT)
+    avl_map_lookup_int(vars[cmd->obj_in], cmd->key.as_int);
+  else
+    avl_map_lookup_string(vars[cmd->obj_in], cmd->key.as_string);
+}
+
+static void map_size(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_map_size(vars[cmd->obj_in]);
+}
+
+static void map_dump(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  avl_map_dump(vars[cmd->obj_in]);
+}
+
+const bench_backend_t bench_avl = {
+  .name = "avl",
+  .implem = AVL,
+  .vector = {
+    [CREATE] = vector_create, [UNREF] = vector_unref,
+    [UPDATE] = vector_update, [PUSH] = vector_push, [POP] = vector_pop,
+    [MERGE] = vector_merge, [SPLIT] = vector_split,
+    [LOOKUP] = vector_lookup, [SIZE] = vector_size, [DUMP] = vector_dump
+  },
+  .map = {
+    [CREATE] = map_create, [UNREF] = map_unref, [UPDATE] = map_update,
+    [REMOVE] = map_remove, [LOOKUP] = map_lookup, [SIZE] = map_size,
+    [DUMP] = map_dump
+  }
+};
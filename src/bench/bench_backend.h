@@ -0,0 +1,25 @@
+#pragma once
+
+#include "parser.h"
+
+/**
+ * A command of a script run on a structure. The versions of the script are
+ * in vars, indexed by the obj_in, obj_out and obj_aux of the command.
+ */
+typedef void (*bench_cmd_fn)(Prog* prog, command* cmd, void** vars);
+
+/**
+ * Back end of the bench: the commands of a structure, indexed by their type,
+ * for the vectors and for the maps. A command is NULL when the structure
+ * doesn't implement it, and the scripts using it are skipped.
+ */
+typedef struct _bench_backend {
+  const char* name;                 // Name in the results.
+  implem_type implem;               // Its entry of the [implem] section.
+  bench_cmd_fn vector[DUMP + 1];
+  bench_cmd_fn map[DUMP + 1];
+} bench_backend_t;
+
+extern const bench_backend_t bench_avl;
+extern const bench_backend_t bench_rrb;
+extern const bench_backend_t bench_finger;
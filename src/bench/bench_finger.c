@@ -0,0 +1,42 @@
+#include "tools.h"
+#include "fingers.h"
+#include "vector.h"
+#include "bench_backend.h"
+
+/* The finger trees only hold ints, boxed: the box is the int of the command,
+   as they don't free their data. */
+
+static void vector_create(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = imc_vector_create();
+}
+
+static void vector_unref(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  imc_vector_unref(vars[cmd->obj_in]);
+}
+
+static void vector_push(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = imc_vector_push(vars[cmd->obj_in], &cmd->data.as_int);
+}
+
+static void vector_lookup(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  imc_vector_lookup(vars[cmd->obj_in], cmd->index);
+}
+
+static void vector_dump(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  imc_vector_dump(vars[cmd->obj_in]);
+}
+
+/* Update, pop, merge, split and size are still stubs in vector.c. */
+const bench_backend_t bench_finger = {
+  .name = "finger",
+  .implem = FINGER,
+  .vector = {
+    [CREATE] = vector_create, [UNREF] = vector_unref, [PUSH] = vector_push,
+    [LOOKUP] = vector_lookup, [DUMP] = vector_dump
+  }
+};
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "parser.h"
+#include "bench_backend.h"
+#include "imc_pool.h"
+#include "imc_stats.h"
+#include "imc_bench.h"
+
+// Back ends, in the order of the results.
+const bench_backend_t* backends[] = { &bench_avl, &bench_rrb, &bench_finger };
+#define NB_BACKENDS ((int) (sizeof backends / sizeof *backends))
+
+// test for debug, bench for benching.
+int is_test = 0, is_bench = 0;
+
+// Name of each type of command.
+const char* cmd_names[] = { "create", "unref", "update", "push", "pop",
+			    "remove", "lookup", "merge", "split", "size", "dump" };
+
+/* A back end running the script, with its results. */
+typedef struct _bench_run {
+  const bench_backend_t* backend;
+  const bench_cmd_fn* cmds;       // Its commands for the structure of the script.
+  Prog* prog;
+  imc_bench_t bench;
+#ifdef IMC_STATS
+  imc_stats_t stats[DUMP + 1];    // Counters of the bench commands, by type.
+  size_t counts[DUMP + 1];
+#endif
+} bench_run_t;
+
+bench_run_t runs[NB_BACKENDS];
+int nb_runs = 0;
+
+
+uint64_t eval_cmds(bench_run_t* run, command* cmds, int size, void** vars) {
+  uint64_t begin = imc_bench_now();
+
+  for (int i = 0; i < size; i++) {
+    command* cmd = &cmds[i];
+    // Note: only dump is test mode.
+    if (cmd->type == DUMP && !is_test)
+      continue;
+#ifdef IMC_STATS
+    imc_stats_t before;
+    imc_stats_get(&before);
+#endif
+    uint64_t start = imc_bench_start(&run->bench);
+    run->cmds[cmd->type](run->prog, cmd, vars);
+    imc_bench_record(&run->bench, cmd->type, start);
+#ifdef IMC_STATS
+    if (run->bench.recording) {
+      imc_stats_add_since(&run->stats[cmd->type], &before);
+      run->counts[cmd->type] += 1;
+    }
+#endif
+  }
+
+  return imc_bench_now() - begin;
+}
+
+
+uint64_t execute (void* arg) {
+  bench_run_t* run = arg;
+  Prog* prog = run->prog;
+  void** vars = malloc(prog->nb_var * sizeof(*vars));
+
+  eval_cmds(run, prog->init, prog->init_size, vars);
+  uint64_t time = eval_cmds(run, prog->bench, prog->bench_size, vars);
+  free(vars);
+  return time;
+}
+
+
+/* Gets the commands of a back end for the structure of the script, or NULL
+   if it lacks one the script uses. */
+const bench_cmd_fn* backend_cmds(const bench_backend_t* backend, Prog* prog) {
+  const bench_cmd_fn* cmds = prog->struc == VECTOR ? backend->vector : backend->map;
+  command* lists[] = { prog->init, prog->bench };
+  int sizes[] = { prog->init_size, prog->bench_size };
+
+  for (int l = 0; l < 2; l++)
+    for (int i = 0; i < sizes[l]; i++)
+      if (cmds[lists[l][i].type] == NULL) {
+	fprintf(stderr, "%s doesn't support %s on %s. Skipping it.\n",
+		backend->name, cmd_names[lists[l][i].type],
+		prog->struc == VECTOR ? "vectors" : "maps");
+	return NULL;
+      }
+  return cmds;
+}
+
+
+/* Prints the mean of each row for every back end, with its ratio to the
+   fastest one. */
+void print_comparison() {
+  printf("%-8s", "mean ns");
+  for (int r = 0; r < nb_runs; r++)
+    printf(" %20s", runs[r].backend->name);
+  printf("\n");
+
+  // The runs, then each type of command.
+  for (int op = -1; op <= DUMP; op++) {
+    double best = 0;
+    for (int r = 0; r < nb_runs; r++) {
+      const imc_histogram_t* hist = op < 0 ? &runs[r].bench.runs
+					   : &runs[r].bench.latencies[op];
+      double mean = imc_histogram_mean(hist);
+      if (hist->count > 0 && (best == 0 || mean < best))
+	best = mean;
+    }
+    if (best == 0)
+      continue;
+    printf("%-8s", op < 0 ? "run" : cmd_names[op]);
+    for (int r = 0; r < nb_runs; r++) {
+      const imc_histogram_t* hist = op < 0 ? &runs[r].bench.runs
+					   : &runs[r].bench.latencies[op];
+      if (hist->count > 0) {
+	double mean = imc_histogram_mean(hist);
+	printf(" %11.1f (x%5.2f)", mean, mean / best);
+      } else {
+	printf(" %20s", "-");
+      }
+    }
+    printf("\n");
+  }
+}
+
+
+void print_results(imc_bench_format_t format) {
+  if (format == IMC_BENCH_JSON)
+    printf("[\n");
+  for (int r = 0; r < nb_runs; r++) {
+    if (format == IMC_BENCH_TEXT)
+      printf("== %s ==\n", runs[r].backend->name);
+    else if (format == IMC_BENCH_JSON && r > 0)
+      printf(",\n");
+    imc_bench_print(&runs[r].bench, format, stdout);
+#ifdef IMC_STATS
+    if (format == IMC_BENCH_TEXT) {
+      imc_stats_print_header(stdout);
+      for (int i = 0; i <= DUMP; i++)
+	if (runs[r].counts[i] > 0)
+	  imc_stats_print(stdout, cmd_names[i], runs[r].counts[i], &runs[r].stats[i]);
+    }
+#endif
+  }
+  if (format == IMC_BENCH_JSON)
+    printf("]\n");
+  if (format == IMC_BENCH_TEXT && nb_runs > 1) {
+    printf("== comparison ==\n");
+    print_comparison();
+  }
+}
+
+
+int main (int argc, char* argv[]) {
+
+  char* filename = NULL;
+  char* compiled = NULL;
+  char* implem = NULL;
+  int warmups = 10, iterations = 100;
+  imc_bench_format_t format = IMC_BENCH_TEXT;
+
+  struct option long_options[] = {
+    { "file", required_argument, NULL, 'f' },
+    { "test", no_argument, NULL, 't'},
+    { "bench", no_argument, NULL, 'b'},
+    { "implem", required_argument, NULL, 'i'},
+    { "warmup", required_argument, NULL, 'w'},
+    { "iterations", required_argument, NULL, 'n'},
+    { "output", required_argument, NULL, 'o'},
+    { "compile", required_argument, NULL, 'c'},
+    { NULL, 0, NULL, 0 } };
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "f:bti:w:n:o:c:", long_options, &option_index)) != -1) {
+    switch (c) {
+    case 'f':
+      filename = optarg;
+      break;
+    case 't':
+      is_test = 1;
+      break;
+    case 'b':
+      is_bench = 1;
+      break;
+    case 'i':
+      implem = optarg;
+      break;
+    case 'w':
+      warmups = atoi(optarg);
+      break;
+    case 'n':
+      iterations = atoi(optarg);
+      break;
+    case 'c':
+      compiled = optarg;
+      break;
+    case 'o':
+      if (! imc_bench_parse_format(optarg, &format)) {
+	fprintf(stderr, "Unknown output %s, expected text, csv or json. Aborting.\n", optarg);
+	exit (EXIT_FAILURE);
+      }
+      break;
+    default:
+      fprintf(stderr, "Unknown option %c. Ignoring it.\n", c);
+      exit (EXIT_FAILURE);
+    }
+  }
+  if ( filename == NULL) {
+    fprintf(stderr, "Filename missing. Aborting.\n");
+    exit (EXIT_FAILURE);
+  }
+  if ( warmups < 0 || iterations < 1) {
+    fprintf(stderr, "Invalid number of runs. Aborting.\n");
+    exit (EXIT_FAILURE);
+  }
+
+  Prog* prog = load_file(filename);
+  if (compiled != NULL) {
+    compile_file(prog, compiled);
+    return 0;
+  }
+
+  // Every implementation the script lists, that has its commands.
+  for (int b = 0; b < NB_BACKENDS; b++) {
+    const bench_backend_t* backend = backends[b];
+    if (! ( prog->implem & backend->implem ))
+      continue;
+    if (implem != NULL && strcmp(implem, backend->name) != 0)
+      continue;
+    const bench_cmd_fn* cmds = backend_cmds(backend, prog);
+    if (cmds == NULL)
+      continue;
+    bench_run_t* run = &runs[nb_runs++];
+    run->backend = backend;
+    run->cmds = cmds;
+    run->prog = prog;
+    imc_bench_init(&run->bench, backend->name, filename, cmd_names, DUMP + 1);
+    run->bench.warmups = warmups;
+    run->bench.iterations = iterations;
+  }
+  if (nb_runs == 0) {
+    fprintf(stderr, "Benchmark '%s' has no implementation to run. Aborting\n",
+	    filename);
+    exit (EXIT_FAILURE);
+  }
+
+  if ( ! is_test && ! is_bench ) {
+    fprintf(stderr, "Mode isn't specified. Assuming test.\n");
+    is_test = 1;
+  }
+
+  if (is_test) {
+    for (int r = 0; r < nb_runs; r++) {
+      printf("== %s ==\n", runs[r].backend->name);
+      uint64_t time = execute(&runs[r]);
+      printf("Time elapsed: %.3fms\n", time / 1e6);
+    }
+  }
+  else if (is_bench) {
+    for (int r = 0; r < nb_runs; r++)
+      imc_bench_run(&runs[r].bench, execute, &runs[r]);
+    print_results(format);
+  }
+  if (format == IMC_BENCH_TEXT)
+    imc_pool_print_stats(stdout);
+
+  return 0;
+
+}
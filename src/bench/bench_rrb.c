@@ -0,0 +1,68 @@
+#include "rrb_vector.h"
+#include "rrb_dumper.h"
+#include "bench_backend.h"
+
+/* The data are the ints of the commands themselves, without boxes. */
+
+static void vector_create(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = rrb_create();
+}
+
+static void vector_unref(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  rrb_unref(vars[cmd->obj_in]);
+}
+
+static void vector_update(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = rrb_update(vars[cmd->obj_in], cmd->index, &cmd->data.as_int);
+}
+
+static void vector_push(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = rrb_push(vars[cmd->obj_in], &cmd->data.as_int);
+}
+
+static void vector_pop(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  imc_data_t* data;
+  vars[cmd->obj_out] = rrb_pop(vars[cmd->obj_in], &data);
+}
+
+static void vector_merge(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  vars[cmd->obj_out] = rrb_merge(vars[cmd->obj_in], vars[cmd->obj_aux]);
+}
+
+static void vector_split(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  rrb_split(vars[cmd->obj_in], (rrb_t**) &vars[cmd->obj_out],
+	    (rrb_t**) &vars[cmd->obj_aux], cmd->index);
+}
+
+static void vector_lookup(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  rrb_lookup(vars[cmd->obj_in], cmd->index);
+}
+
+static void vector_size(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  rrb_size(vars[cmd->obj_in]);
+}
+
+static void vector_dump(Prog* prog, command* cmd, void** vars) {
+  (void) prog;
+  rrb_ppp_leafs(vars[cmd->obj_in]);
+}
+
+const bench_backend_t bench_rrb = {
+  .name = "rrb",
+  .implem = RRB,
+  .vector = {
+    [CREATE] = vector_create, [UNREF] = vector_unref,
+    [UPDATE] = vector_update, [PUSH] = vector_push, [POP] = vector_pop,
+    [MERGE] = vector_merge, [SPLIT] = vector_split,
+    [LOOKUP] = vector_lookup, [SIZE] = vector_size, [DUMP] = vector_dump
+  }
+};
@@ -0,0 +1,510 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+
+#include "parser.h"
+
+/* Generator of int vector and int map scripts: a mix of operations, with
+   their indexes or keys drawn from a distribution, on a window of versions.
+   The script is streamed to stdout (or -o file), as text or compiled, and a
+   seed always gives the same script. */
+
+// Name of each type of command, as in the scripts.
+const char* cmd_names[] = { "create", "unref", "update", "push", "pop",
+			    "remove", "lookup", "merge", "split", "size", "dump" };
+
+typedef enum { UNIFORM, ZIPF, SEQUENTIAL, HOTSPOT } distrib_type;
+
+typedef struct _workload {
+  struct_type struc;
+  int implem;
+  long init;                  // Elements of the first version.
+  long ops;                   // Commands of the bench, without the unrefs.
+  long keys;                  // Range of the keys of the maps.
+  double ratios[DUMP + 1];    // Weights of the operations, by type.
+  distrib_type distrib;
+  double theta;               // Skew of zipf.
+  double hot_keys, hot_ops;   // hot_ops of the operations on hot_keys of the keys.
+  int versions;               // Versions kept alive, the operations use any of them.
+  uint64_t seed;
+  int binary;
+} workload_t;
+
+/*******************
+ *     Random      *
+ *******************/
+
+static uint64_t rng_state;
+
+/* splitmix64. */
+static uint64_t rng_next() {
+  uint64_t z = (rng_state += 0x9e3779b97f4a7c15);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+/* In [0, 1). */
+static double rng_double() {
+  return (rng_next() >> 11) * 0x1.0p-53;
+}
+
+/* In [0, n). */
+static long rng_below(long n) {
+  return n <= 1 ? 0 : (long) (rng_next() % (uint64_t) n);
+}
+
+/* Zipf over [0, n), as in Gray et al., "Quickly generating billion-record
+   synthetic databases". zeta(n) is summed up to 1000, then its tail is
+   approximated by an integral, to stay in constant time up to 10^8. */
+static struct { long n; double theta, alpha, zetan, eta; } zipf;
+
+static double zeta(long n, double theta) {
+  double sum = 0;
+  long exact = n < 1000 ? n : 1000;
+  for (long i = 1; i <= exact; i++)
+    sum += pow(i, -theta);
+  if (n > exact)
+    sum += (pow(n + 0.5, 1 - theta) - pow(exact + 0.5, 1 - theta)) / (1 - theta);
+  return sum;
+}
+
+static void zipf_init(long n, double theta) {
+  zipf.n = n;
+  zipf.theta = theta;
+  zipf.alpha = 1 / (1 - theta);
+  zipf.zetan = zeta(n, theta);
+  zipf.eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta(2, theta) / zipf.zetan);
+}
+
+static long zipf_next() {
+  double u = rng_double();
+  double uz = u * zipf.zetan;
+  if (uz < 1) return 0;
+  if (uz < 1 + pow(0.5, zipf.theta)) return 1;
+  long rank = zipf.n * pow(zipf.eta * u - zipf.eta + 1, zipf.alpha);
+  return rank < zipf.n ? rank : zipf.n - 1;
+}
+
+/* Draws an index or a key in [0, n). */
+static long sequence;
+
+static long draw(const workload_t* w, long n) {
+  if (n <= 1) return 0;
+  switch (w->distrib) {
+  case ZIPF: return zipf_next() % n;
+  case SEQUENTIAL: return sequence++ % n;
+  case HOTSPOT: ;
+    long hot = w->hot_keys * n;
+    if (hot < 1) hot = 1;
+    if (rng_double() < w->hot_ops || hot == n)
+      return rng_below(hot);
+    return hot + rng_below(n - hot);
+  default: return rng_below(n);
+  }
+}
+
+/*******************
+ *     Output      *
+ *******************/
+
+static FILE* out;
+static long nb_cmds;      // Commands written, counted by a dry run when compiled.
+static int dry_run;
+
+static void emit(const workload_t* w, command* cmd) {
+  nb_cmds++;
+  if (dry_run)
+    return;
+  if (w->binary) {
+    fwrite(cmd, sizeof *cmd, 1, out);
+    return;
+  }
+  if (cmd->is_assign)
+    fprintf(out, "%d = ", cmd->obj_out);
+  if (cmd->type == CREATE) {
+    fprintf(out, "create()\n");
+    return;
+  }
+  fprintf(out, "%s(%d", cmd_names[cmd->type], cmd->obj_in);
+  switch (cmd->type) {
+  case UPDATE:
+    fprintf(out, ", %d, %d)\n", w->struc == VECTOR ? cmd->index : cmd->key.as_int,
+	    cmd->data.as_int);
+    return;
+  case PUSH: fprintf(out, ", %d)\n", cmd->data.as_int); return;
+  case REMOVE: fprintf(out, ", %d)\n", cmd->key.as_int); return;
+  case LOOKUP:
+    fprintf(out, ", %d)\n", w->struc == VECTOR ? cmd->index : cmd->key.as_int);
+    return;
+  case MERGE: fprintf(out, ", %d)\n", cmd->obj_aux); return;
+  case SPLIT:
+    fprintf(out, ", %d, %d, %d)\n", cmd->index, cmd->obj_out, cmd->obj_aux);
+    return;
+  default: fprintf(out, ")\n"); return;
+  }
+}
+
+/* Creates a command, -1 for its unused versions. */
+static command make_cmd(cmd_type type, int in, int out, int aux) {
+  command cmd;
+  memset(&cmd, 0, sizeof cmd);
+  cmd.type = type;
+  cmd.is_assign = out != -1 && type != SPLIT;
+  cmd.obj_in = in;
+  cmd.obj_out = out;
+  cmd.obj_aux = aux;
+  cmd.is_mutable = in == out;
+  return cmd;
+}
+
+/*******************
+ *    Versions     *
+ *******************/
+
+/* The live versions are in slots, queued from the oldest. A command writes
+   its versions to free slots, then the oldest versions beyond the window are
+   unref. The free slots are a stack. */
+static int nb_slots;
+static long* sizes;        // Elements of the version of each slot.
+static int* live;          // Ring of the slots of the live versions.
+static int first_live, nb_live;
+static int* free_slots;
+static int nb_free;
+
+static int free_slot() {
+  return free_slots[nb_free - 1];
+}
+
+static int nth_live(long n) {
+  return live[(first_live + n) % nb_slots];
+}
+
+static void add_version(int slot, long size) {
+  sizes[slot] = size;
+  live[(first_live + nb_live++) % nb_slots] = slot;
+  nb_free--;
+}
+
+static void trim_versions(const workload_t* w, int keep) {
+  while (nb_live > keep) {
+    command cmd = make_cmd(UNREF, live[first_live], -1, -1);
+    emit(w, &cmd);
+    free_slots[nb_free++] = live[first_live];
+    first_live = (first_live + 1) % nb_slots;
+    nb_live--;
+  }
+}
+
+/*******************
+ *    Workload     *
+ *******************/
+
+static cmd_type draw_op(const workload_t* w) {
+  double total = 0;
+  for (int t = 0; t <= DUMP; t++)
+    total += w->ratios[t];
+  double u = rng_double() * total;
+  for (int t = 0; t <= DUMP; t++) {
+    if (u < w->ratios[t])
+      return t;
+    u -= w->ratios[t];
+  }
+  return LOOKUP;
+}
+
+/* One operation of the bench, on a random live version. The operations that
+   can't be done on it (a pop or a split of an empty vector, a merge above
+   the largest size) are lookups. */
+static void gen_op(const workload_t* w, long max_size) {
+  int in = nth_live(rng_below(nb_live));
+  long size = sizes[in];
+  cmd_type type = draw_op(w);
+  command cmd;
+
+  if ((type == POP && size == 0) || (type == SPLIT && size < 2) ||
+      (type == MERGE && 2 * size > max_size) ||
+      (type == LOOKUP && w->struc == VECTOR && size == 0) ||
+      (type == UPDATE && w->struc == VECTOR && size == 0))
+    type = size == 0 ? PUSH : LOOKUP;
+
+  int value = rng_next() & 0x7fffffff;
+  switch (type) {
+  case LOOKUP: case SIZE:
+    cmd = make_cmd(type, in, -1, -1);
+    if (w->struc == VECTOR) cmd.index = draw(w, size);
+    else cmd.key.as_int = draw(w, w->keys);
+    emit(w, &cmd);
+    return;
+  case SPLIT: ;
+    int left = free_slot();
+    add_version(left, 0);
+    int right = free_slot();
+    // The left vector ends with the element at index.
+    long index = draw(w, size - 1);
+    cmd = make_cmd(SPLIT, in, left, right);
+    cmd.index = index;
+    emit(w, &cmd);
+    sizes[left] = index + 1;
+    add_version(right, size - index - 1);
+    break;
+  case MERGE: ;
+    int aux = nth_live(rng_below(nb_live));
+    if (size + sizes[aux] > max_size)
+      aux = in;
+    cmd = make_cmd(MERGE, in, free_slot(), aux);
+    emit(w, &cmd);
+    add_version(cmd.obj_out, size + sizes[aux]);
+    break;
+  default:
+    cmd = make_cmd(type, in, free_slot(), -1);
+    cmd.data.as_int = value;
+    if (type == UPDATE && w->struc == VECTOR) cmd.index = draw(w, size);
+    else if (type == UPDATE || type == REMOVE) cmd.key.as_int = draw(w, w->keys);
+    emit(w, &cmd);
+    // The sizes of the maps aren't followed, their keys are in a range.
+    add_version(cmd.obj_out, type == PUSH ? size + 1 : type == POP ? size - 1 : size);
+    break;
+  }
+  trim_versions(w, w->versions);
+}
+
+/* Writes the sections of the script, returning the commands of init. */
+static long gen_cmds(const workload_t* w) {
+  rng_state = w->seed;
+  sequence = 0;
+  nb_cmds = 0;
+  first_live = nb_live = 0;
+  nb_free = nb_slots;
+  for (int s = 0; s < nb_slots; s++)
+    free_slots[s] = nb_slots - 1 - s;
+
+  // init: the first version, with its elements, one version at a time.
+  command cmd = make_cmd(CREATE, -1, 0, -1);
+  emit(w, &cmd);
+  add_version(0, 0);
+  for (long i = 0; i < w->init; i++) {
+    int in = nth_live(0);
+    cmd = make_cmd(w->struc == VECTOR ? PUSH : UPDATE, in, free_slot(), -1);
+    cmd.data.as_int = rng_next() & 0x7fffffff;
+    cmd.key.as_int = i % w->keys;
+    emit(w, &cmd);
+    add_version(cmd.obj_out, sizes[in] + 1);
+    trim_versions(w, 1);
+  }
+  long init_size = nb_cmds;
+  if (! dry_run && ! w->binary)
+    fprintf(out, "\n[bench]\n");
+
+  // bench: the operations, then the unref of the last versions.
+  long max_size = 2 * (w->init + w->ops) + 2;
+  for (long i = 0; i < w->ops; i++)
+    gen_op(w, max_size);
+  trim_versions(w, 0);
+
+  return init_size;
+}
+
+static void gen_script(const workload_t* w) {
+  nb_slots = w->versions + 2;
+  sizes = calloc(nb_slots, sizeof *sizes);
+  live = calloc(nb_slots, sizeof *live);
+  free_slots = calloc(nb_slots, sizeof *free_slots);
+  if (w->distrib == ZIPF)
+    zipf_init(w->struc == VECTOR ? w->init + w->ops + 1 : w->keys, w->theta);
+
+  if (w->binary) {
+    // The header needs the size of the sections: a dry run counts them.
+    dry_run = 1;
+    long init_size = gen_cmds(w);
+    long bench_size = nb_cmds - init_size;
+    dry_run = 0;
+    if (init_size + bench_size > INT32_MAX) {
+      fprintf(stderr, "Too many commands for one script. Aborting.\n");
+      exit(EXIT_FAILURE);
+    }
+    prog_header header = {
+      .magic = PROG_MAGIC, .cmd_size = sizeof(command), .nb_var = nb_slots,
+      .struc = w->struc, .implem = w->implem, .data_type = INT,
+      .key_type = w->struc == MAP ? INT : 0,
+      .init_size = init_size, .bench_size = bench_size, .strings_size = 0
+    };
+    fwrite(&header, sizeof header, 1, out);
+  } else {
+    fprintf(out, "# Generated by genbench with seed %llu.\n\n[struct]\n%s\n\n[implem]\n",
+	    (unsigned long long) w->seed, w->struc == VECTOR ? "vector" : "map");
+    if (w->implem & AVL) fprintf(out, "AVL\n");
+    if (w->implem & RRB) fprintf(out, "RRB\n");
+    if (w->implem & FINGER) fprintf(out, "FINGER\n");
+    fprintf(out, "\n[type]\nint\n%s\n[init]\n", w->struc == MAP ? "int\n" : "");
+  }
+  gen_cmds(w);
+
+  free(sizes);
+  free(live);
+  free(free_slots);
+}
+
+/*******************
+ *     Options     *
+ *******************/
+
+static void usage_error(const char* fmt, const char* arg) {
+  fprintf(stderr, fmt, arg);
+  fprintf(stderr, " Aborting.\n");
+  exit(EXIT_FAILURE);
+}
+
+/* Reads ratios as push=4,lookup=1. */
+static void parse_ratios(workload_t* w, char* arg) {
+  memset(w->ratios, 0, sizeof w->ratios);
+  for (char* tok = strtok(arg, ","); tok != NULL; tok = strtok(NULL, ",")) {
+    char* eq = strchr(tok, '=');
+    if (eq == NULL)
+      usage_error("Ratio %s isn't op=weight.", tok);
+    *eq = '\0';
+    int type = -1;
+    for (int t = UPDATE; t < DUMP; t++)
+      if (strcmp(tok, cmd_names[t]) == 0)
+	type = t;
+    if (type == -1)
+      usage_error("Unknown operation %s.", tok);
+    w->ratios[type] = atof(eq + 1);
+  }
+}
+
+/* Reads uniform, zipf[:theta], sequential or hotspot[:keys:ops]. */
+static void parse_distrib(workload_t* w, char* arg) {
+  char* params = strchr(arg, ':');
+  if (params != NULL)
+    *params++ = '\0';
+  if (strcmp(arg, "uniform") == 0)
+    w->distrib = UNIFORM;
+  else if (strcmp(arg, "sequential") == 0)
+    w->distrib = SEQUENTIAL;
+  else if (strcmp(arg, "zipf") == 0) {
+    w->distrib = ZIPF;
+    if (params != NULL)
+      w->theta = atof(params);
+    if (w->theta <= 0 || w->theta >= 1)
+      usage_error("Zipf skew %s isn't in ]0, 1[.", params);
+  } else if (strcmp(arg, "hotspot") == 0) {
+    w->distrib = HOTSPOT;
+    if (params != NULL && sscanf(params, "%lf:%lf", &w->hot_keys, &w->hot_ops) != 2)
+      usage_error("Hotspot %s isn't keys:ops.", params);
+    if (w->hot_keys <= 0 || w->hot_keys > 1 || w->hot_ops < 0 || w->hot_ops > 1)
+      usage_error("Hotspot %s isn't fractions.", params);
+  } else
+    usage_error("Unknown distribution %s.", arg);
+}
+
+int main (int argc, char* argv[]) {
+
+  workload_t w = {
+    .struc = VECTOR, .implem = AVL | RRB | FINGER, .init = 0, .ops = 10000,
+    .keys = 0, .distrib = UNIFORM, .theta = 0.99, .hot_keys = 0.2,
+    .hot_ops = 0.8, .versions = 1, .seed = 42, .binary = 0
+  };
+  w.ratios[PUSH] = 1;
+  char* output = NULL;
+
+  struct option long_options[] = {
+    { "struct", required_argument, NULL, 's'},
+    { "implem", required_argument, NULL, 'm'},
+    { "init", required_argument, NULL, 'i'},
+    { "ops", required_argument, NULL, 'n'},
+    { "keys", required_argument, NULL, 'k'},
+    { "ratios", required_argument, NULL, 'r'},
+    { "distrib", required_argument, NULL, 'd'},
+    { "versions", required_argument, NULL, 'v'},
+    { "seed", required_argument, NULL, 'S'},
+    { "compiled", no_argument, NULL, 'c'},
+    { "output", required_argument, NULL, 'o'},
+    { NULL, 0, NULL, 0 } };
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "s:m:i:n:k:r:d:v:S:co:", long_options, &option_index)) != -1) {
+    switch (c) {
+    case 's':
+      if (strcmp(optarg, "vector") == 0) w.struc = VECTOR;
+      else if (strcmp(optarg, "map") == 0) w.struc = MAP;
+      else usage_error("Unknown structure %s.", optarg);
+      break;
+    case 'm':
+      w.implem = 0;
+      for (char* tok = strtok(optarg, ","); tok != NULL; tok = strtok(NULL, ","))
+	w.implem |= strcmp(tok, "avl") == 0 ? AVL :
+		    strcmp(tok, "rrb") == 0 ? RRB :
+		    strcmp(tok, "finger") == 0 ? FINGER : 0;
+      break;
+    case 'i':
+      w.init = atol(optarg);
+      break;
+    case 'n':
+      w.ops = atol(optarg);
+      break;
+    case 'k':
+      w.keys = atol(optarg);
+      break;
+    case 'r':
+      parse_ratios(&w, optarg);
+      break;
+    case 'd':
+      parse_distrib(&w, optarg);
+      break;
+    case 'v':
+      w.versions = atoi(optarg);
+      break;
+    case 'S':
+      w.seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'c':
+      w.binary = 1;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    default:
+      exit (EXIT_FAILURE);
+    }
+  }
+  if (w.init < 0 || w.ops < 0 || w.versions < 1 || w.implem == 0) {
+    fprintf(stderr, "Invalid workload. Aborting.\n");
+    exit (EXIT_FAILURE);
+  }
+  if (w.keys <= 0)
+    w.keys = w.init + w.ops > 0 ? w.init + w.ops : 1;
+  if (w.keys > INT32_MAX) {
+    fprintf(stderr, "Keys must be ints. Aborting.\n");
+    exit (EXIT_FAILURE);
+  }
+  if (w.struc == MAP)
+    w.implem &= ~RRB;
+  double total = 0;
+  for (int t = 0; t <= DUMP; t++) {
+    total += w.ratios[t];
+    int on_vectors = t != REMOVE, on_maps = t == UPDATE || t == REMOVE ||
+					      t == LOOKUP || t == SIZE;
+    if (w.ratios[t] > 0 && ! (w.struc == VECTOR ? on_vectors : on_maps))
+      usage_error("%s isn't an operation of this structure.", cmd_names[t]);
+  }
+  if (total <= 0) {
+    fprintf(stderr, "No operation to generate. Aborting.\n");
+    exit (EXIT_FAILURE);
+  }
+
+  out = output == NULL ? stdout : fopen(output, "wb");
+  if (out == NULL)
+    usage_error("Unable to open file %s.", output);
+  gen_script(&w);
+  if (fclose(out) != 0) {
+    fprintf(stderr, "Unable to write the script. Aborting.\n");
+    exit (EXIT_FAILURE);
+  }
+
+  return 0;
+}
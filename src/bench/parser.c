@@ -2,6 +2,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "parser.h"
 
 typedef enum {
@@ -61,8 +66,8 @@ Prog* read_file(char* name) {
   FILE* fp;
   char output[20];
   int nb_var = 0;
-  char* cmd = malloc((151+strlen(name))*sizeof(char));
-  sprintf(cmd, "perl -pi -e 's{ (\\w+) (\\s*=) }{ ($c{$1}//=$i++).$2 }gex; s{ ([a-z]\\w*) (\\s*[,)]) }{ ($c{$1}//=$i++).$2 }gex; END { print 0+(sort values %%c)[-1] }' %s", name);
+  char* cmd = malloc((164+strlen(name))*sizeof(char));
+  sprintf(cmd, "perl -pi -e 's{ (\\w+) (\\s*=) }{ ($c{$1}//=$i++).$2 }gex; s{ ([a-z]\\w*) (\\s*[,)]) }{ ($c{$1}//=$i++).$2 }gex; END { print 0+(sort { $a <=> $b } values %%c)[-1] }' %s", name);
   fp = popen(cmd, "r");
 
   if (fp == NULL) die("Couldn't convert the names.");
@@ -92,9 +97,9 @@ Prog* read_file(char* name) {
   prog->struc = 0;
   prog->data_type = prog->key_type = 0;
   prog->implem = 0;
-  prog->init  = malloc(init_size * sizeof(*(prog->init)));
+  prog->init  = calloc(init_size, sizeof(*(prog->init)));
   prog->init_size  = init_size;
-  prog->bench = malloc(bench_size * sizeof(*(prog->bench)));
+  prog->bench = calloc(bench_size, sizeof(*(prog->bench)));
   prog->bench_size = bench_size;
 
 
@@ -124,12 +129,8 @@ Prog* read_file(char* name) {
       else prog->key_type = *c == 'i' ? INT : STRING;
       break;
     case INIT: case BENCH: ;
-      command* cmd = malloc(sizeof *cmd);
-      if (section == INIT) {
-	prog->init[init_count++] = cmd;
-      } else {
-	prog->bench[bench_count++] = cmd;
-      }
+      command* cmd = section == INIT ? &prog->init[init_count++]
+				     : &prog->bench[bench_count++];
       cmd->is_assign = 0;
       cmd->index = 0;
       cmd->obj_in = cmd->obj_out = cmd->obj_aux = -1;
@@ -195,7 +196,16 @@ Prog* read_file(char* name) {
       } else if (strcmp(fun_name, "lookup") == 0) {
 	cmd->type = LOOKUP;
 	cmd->obj_in = atoi(strtok(NULL, delim));
-	cmd->index = atoi(strtok(NULL, delim));
+	if (prog->struc == VECTOR) {
+	  cmd->index = atoi(strtok(NULL, delim));
+	} else {
+	  if (prog->key_type == INT)
+	    cmd->key.as_int = atoi(strtok(NULL, delim));
+	  else {
+	    cmd->key.as_string = strdup(strtok(NULL, delim));
+	    remove_quotes(cmd->key.as_string);
+	  }
+	}
       } else if (strcmp(fun_name, "size") == 0) {
 	cmd->type = SIZE;
 	cmd->obj_in = atoi(strtok(NULL, delim));
@@ -221,7 +231,144 @@ Prog* read_file(char* name) {
   return prog;
 }
 
-void debug_print_cmds (Prog* prog, command** cmds, int size);
+
+/* Strings of a compiled file, appended as the commands are written. */
+typedef struct {
+  char* data;
+  long size;
+  long capacity;
+} strings;
+
+/* Appends a string to the strings, returning its offset plus 1. */
+static char* add_string(strings* strs, char* str) {
+  if (str == NULL) return NULL;
+  long len = strlen(str) + 1;
+  if (strs->size + len > strs->capacity) {
+    strs->capacity = 2 * (strs->size + len);
+    strs->data = realloc(strs->data, strs->capacity);
+  }
+  memcpy(strs->data + strs->size, str, len);
+  strs->size += len;
+  return (char*) (intptr_t) (strs->size - len + 1);
+}
+
+void compile_file(Prog* prog, char* name) {
+  FILE* fp = fopen(name, "wb");
+  if (fp == NULL) die("Unable to open file %s", name);
+
+  prog_header header = {
+    .magic = PROG_MAGIC, .cmd_size = sizeof(command), .nb_var = prog->nb_var,
+    .struc = prog->struc, .implem = prog->implem, .data_type = prog->data_type,
+    .key_type = prog->key_type, .init_size = prog->init_size,
+    .bench_size = prog->bench_size
+  };
+  strings strs = { NULL, 0, 0 };
+  command* lists[] = { prog->init, prog->bench };
+  int sizes[] = { prog->init_size, prog->bench_size };
+
+  // The header is written again once the size of the strings is known.
+  fwrite(&header, sizeof header, 1, fp);
+  for (int l = 0; l < 2; l++)
+    for (int i = 0; i < sizes[l]; i++) {
+      command cmd = lists[l][i];
+      if (prog->data_type == STRING)
+	cmd.data.as_string = add_string(&strs, cmd.data.as_string);
+      if (prog->key_type == STRING)
+	cmd.key.as_string = add_string(&strs, cmd.key.as_string);
+      fwrite(&cmd, sizeof cmd, 1, fp);
+    }
+  fwrite(strs.data, 1, strs.size, fp);
+  header.strings_size = strs.size;
+  rewind(fp);
+  fwrite(&header, sizeof header, 1, fp);
+
+  if (ferror(fp)) die("Unable to write file %s", name);
+  fclose(fp);
+  free(strs.data);
+}
+
+/* Checks a variable of a command: an index of vars, or -1 if unused. */
+static int valid_var(int var, int nb_var) {
+  return var >= -1 && var < nb_var;
+}
+
+/* Reads a compiled script in memory. The commands are used in place, only
+   their strings are relocated. */
+static Prog* load_compiled(char* base, long size, char* name) {
+  prog_header* header = (prog_header*) base;
+  if (header->cmd_size != sizeof(command))
+    die("File %s was compiled by another build of the bench\n", name);
+  long cmds_size = (long) (header->init_size + header->bench_size) * sizeof(command);
+  if ((long) sizeof *header + cmds_size + header->strings_size != size)
+    die("File %s is truncated\n", name);
+
+  Prog* prog = malloc(sizeof *prog);
+  prog->nb_var = header->nb_var;
+  prog->struc = header->struc;
+  prog->implem = header->implem;
+  prog->data_type = header->data_type;
+  prog->key_type = header->key_type;
+  prog->init_size = header->init_size;
+  prog->init = (command*) (base + sizeof *header);
+  prog->bench_size = header->bench_size;
+  prog->bench = prog->init + prog->init_size;
+
+  char* strs = base + sizeof *header + cmds_size - 1;
+  for (int i = 0; i < prog->init_size + prog->bench_size; i++) {
+    command* cmd = &prog->init[i];
+    if (!valid_var(cmd->obj_in, prog->nb_var) || !valid_var(cmd->obj_out, prog->nb_var) ||
+	!valid_var(cmd->obj_aux, prog->nb_var))
+      die("File %s uses a variable beyond its %d variables\n", name, prog->nb_var);
+    if (prog->data_type == STRING && cmd->data.as_string != NULL)
+      cmd->data.as_string = strs + (intptr_t) cmd->data.as_string;
+    if (prog->key_type == STRING && cmd->key.as_string != NULL)
+      cmd->key.as_string = strs + (intptr_t) cmd->key.as_string;
+  }
+
+  return prog;
+}
+
+/* Maps a compiled file, privately as the strings are relocated. */
+static Prog* map_file(int fd, char* name) {
+  struct stat st;
+  if (fstat(fd, &st) == -1) die("Unable to stat file %s", name);
+  char* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (base == MAP_FAILED) die("Unable to map file %s", name);
+  return load_compiled(base, st.st_size, name);
+}
+
+/* Reads a compiled script streamed on stdin, as by genbench -c. */
+static Prog* read_stdin() {
+  long size = 0, capacity = 1 << 20;
+  char* base = malloc(capacity);
+  size_t n;
+  while ((n = fread(base + size, 1, capacity - size, stdin)) > 0) {
+    size += n;
+    if (size == capacity)
+      base = realloc(base, capacity *= 2);
+  }
+  if (size < (long) sizeof(prog_header) || memcmp(base, PROG_MAGIC, 4) != 0)
+    die("stdin isn't a compiled script\n");
+  return load_compiled(base, size, "stdin");
+}
+
+Prog* load_file(char* name) {
+  if (strcmp(name, "-") == 0)
+    return read_stdin();
+
+  int fd = open(name, O_RDONLY);
+  if (fd == -1) die("Unable to open file %s", name);
+
+  char magic[4];
+  int compiled = read(fd, magic, sizeof magic) == sizeof magic &&
+		 memcmp(magic, PROG_MAGIC, sizeof magic) == 0;
+  Prog* prog = compiled ? map_file(fd, name) : NULL;
+  close(fd);
+
+  return compiled ? prog : read_file(name);
+}
+
+void debug_print_cmds (Prog* prog, command* cmds, int size);
 void debug_print_2 (Prog* prog) {
   fprintf(stderr, "nb var... %d\n", prog->nb_var);
   fprintf(stderr, "struct... %s\n", prog->struc == VECTOR ? "vector" : "map");
@@ -236,10 +383,10 @@ void debug_print_2 (Prog* prog) {
   fprintf(stderr, "bench :\n");
   debug_print_cmds(prog, prog->bench, prog->bench_size);
 }
-void debug_print_cmds (Prog* prog, command** cmds, int size) {
+void debug_print_cmds (Prog* prog, command* cmds, int size) {
   for (int i = 0; i < size; i++) {
     fprintf(stderr, "\t");
-    command* cmd = cmds[i];
+    command* cmd = &cmds[i];
     if (cmd->is_assign) fprintf(stderr, "%d = ", cmd->obj_out);
     switch (cmd->type) {
     case CREATE: fprintf(stderr, "create()\n"); break;
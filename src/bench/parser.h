@@ -5,6 +5,11 @@ typedef struct _command command;
 
 Prog* read_file(char* name);
 
+/* Writes a script to a compiled file, that load_file maps back. */
+void compile_file(Prog* prog, char* name);
+/* Reads a script, compiled or not, or a compiled script from stdin for "-". */
+Prog* load_file(char* name);
+
 typedef enum {
   VECTOR = 1,
   MAP = 2
@@ -37,7 +42,9 @@ typedef enum {
   - lookup(obj_in, index)
   - size(obj_in)
   - dump(obj_in)
-  - split(obj_in, index, obj_out, obj_aux) */
+  - split(obj_in, index, obj_out, obj_aux)
+   The data and the key are their own boxes: &cmd->data points to the int or
+   to the string, as make_int_box and make_string_box would. */
 struct _command {
   char is_assign;
   char is_mutable;
@@ -63,7 +70,25 @@ struct _prog {
   data_type data_type;
   data_type key_type;
   int init_size;
-  command** init;
+  command* init;
   int bench_size;
-  command** bench;
+  command* bench;
 };
+
+/* A compiled script is this header, the commands of init then bench as they
+   are in memory, then the strings they use. The strings of the commands are
+   stored as their offsets in the strings, plus 1 (0 is NULL). */
+#define PROG_MAGIC "IMCB"
+
+typedef struct _prog_header {
+  char magic[4];
+  int cmd_size;       // sizeof(command), to refuse the files of other builds.
+  int nb_var;
+  int struc;
+  int implem;
+  int data_type;
+  int key_type;
+  int init_size;
+  int bench_size;
+  long strings_size;
+} prog_header;
@@ -0,0 +1,112 @@
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "imc_arena.h"
+
+#define ALIGN 16
+#define CHUNK_SIZE (64 * 1024)
+
+/** A chunk of an arena, linked to the previous one. Blocks follow the
+  * header. */
+typedef struct _imc_chunk {
+    struct _imc_chunk* next;
+    size_t size;
+} imc_chunk_t;
+
+struct _imc_arena {
+    imc_chunk_t* chunks;   // The current chunk, then the previous ones.
+    char* top;             // Next free byte of the current chunk.
+    char* end;             // End of the current chunk.
+    size_t used;           // Bytes allocated.
+    imc_arena_t* outer;    // Enclosing scope, while the arena is a scope.
+};
+
+__thread imc_arena_t* imc_arena_scope = NULL;
+
+/** Rounds a size up to the alignment. */
+static size_t align_up(size_t size) {
+    return (size + ALIGN - 1) & ~(size_t) (ALIGN - 1);
+}
+
+/** Adds a chunk with room for size bytes at least. */
+static void add_chunk(imc_arena_t* arena, size_t size) {
+    size_t header = align_up(sizeof (imc_chunk_t));
+    size_t chunk_size = header + size > CHUNK_SIZE ? header + size : CHUNK_SIZE;
+    imc_chunk_t* chunk = malloc(chunk_size);
+    chunk->next = arena->chunks;
+    chunk->size = chunk_size;
+    arena->chunks = chunk;
+    arena->top = (char*) chunk + header;
+    arena->end = (char*) chunk + chunk_size;
+}
+
+/** Creates an arena without chunk, added on the first allocation. */
+imc_arena_t* imc_arena_create(void) {
+    imc_arena_t* arena = malloc(sizeof *arena);
+    arena->chunks = NULL;
+    arena->top = NULL;
+    arena->end = NULL;
+    arena->used = 0;
+    arena->outer = NULL;
+    return arena;
+}
+
+/** Frees every chunk but the last one (the first added) if keep is set. */
+static void free_chunks(imc_arena_t* arena, bool keep) {
+    imc_chunk_t* chunk = arena->chunks;
+    while (chunk != NULL && (keep == false || chunk->next != NULL)) {
+        imc_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena->chunks = chunk;
+    arena->used = 0;
+    if (chunk != NULL) {
+        arena->top = (char*) chunk + align_up(sizeof (imc_chunk_t));
+        arena->end = (char*) chunk + chunk->size;
+    } else {
+        arena->top = NULL;
+        arena->end = NULL;
+    }
+}
+
+/** Frees the chunks, then the arena. */
+void imc_arena_free(imc_arena_t* arena) {
+    free_chunks(arena, false);
+    free(arena);
+}
+
+/** Frees the chunks but the first one, and rewinds it. */
+void imc_arena_reset(imc_arena_t* arena) {
+    free_chunks(arena, true);
+}
+
+/** Pushes the arena on the scopes of the thread. */
+void imc_arena_enter(imc_arena_t* arena) {
+    arena->outer = imc_arena_scope;
+    imc_arena_scope = arena;
+}
+
+/** Pops the innermost scope of the thread. */
+void imc_arena_leave(void) {
+    imc_arena_t* arena = imc_arena_scope;
+    imc_arena_scope = arena->outer;
+    arena->outer = NULL;
+}
+
+/** Bumps the top of the current chunk, adding one if it is full. */
+void* imc_arena_alloc(imc_arena_t* arena, size_t size) {
+    size = align_up(size == 0 ? 1 : size);
+    if (arena->top == NULL || (size_t) (arena->end - arena->top) < size) {
+        add_chunk(arena, size);
+    }
+    void* block = arena->top;
+    arena->top += size;
+    arena->used += size;
+    return block;
+}
+
+/** Gets the bytes allocated. */
+size_t imc_arena_used(const imc_arena_t* arena) {
+    return arena->used;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Arena of the temporary versions of the immutable structures. While an
+ * arena is the scope of a thread, the nodes the thread creates are bump
+ * allocated in it and are not reference counted: incrementing, unref and
+ * freeing do nothing. Once the scope is left, the versions to keep are
+ * promoted (their nodes in arenas are copied out, the others shared), then
+ * the arena is freed at once, with every temporary version.
+ *
+ * Versions from before the scope must stay alive during it, and be unref
+ * outside of it. Versions created in the scope but not promoted must not be
+ * used after the arena is freed.
+ */
+typedef struct _imc_arena imc_arena_t;
+
+/** The innermost scope of the current thread, NULL outside of any. Checked
+  * on every allocation, so it is read without going through the dynamic
+  * linker. */
+extern __thread imc_arena_t* imc_arena_scope
+    __attribute__((tls_model("initial-exec")));
+
+/**
+ * Creates an empty arena.
+ * @return The arena.
+ */
+imc_arena_t* imc_arena_create(void);
+
+/**
+ * Frees an arena and every block allocated in it. It must not be a scope.
+ * @param arena The arena.
+ */
+void imc_arena_free(imc_arena_t* arena);
+
+/**
+ * Frees every block allocated in an arena, keeping its first chunk to be
+ * reused. It must not be a scope.
+ * @param arena The arena.
+ */
+void imc_arena_reset(imc_arena_t* arena);
+
+/**
+ * Makes an arena the scope of the current thread, until it is left. Scopes
+ * nest: promoting in an outer scope copies into its arena.
+ * @param arena The arena.
+ */
+void imc_arena_enter(imc_arena_t* arena);
+
+/**
+ * Leaves the innermost scope of the current thread.
+ */
+void imc_arena_leave(void);
+
+/**
+ * Allocates a block in an arena, aligned on 16 bytes.
+ * @param arena The arena.
+ * @param size  The size of the block.
+ * @return The block.
+ */
+void* imc_arena_alloc(imc_arena_t* arena, size_t size);
+
+/**
+ * Gets the number of bytes allocated in an arena.
+ * @param arena The arena.
+ * @return The number of bytes.
+ */
+size_t imc_arena_used(const imc_arena_t* arena);
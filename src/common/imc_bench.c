@@ -0,0 +1,246 @@
+#include <ctype.h>
+#include <math.h>
+#include <string.h>
+
+#include "imc_bench.h"
+
+#define SUB_BUCKETS 32
+#define SUB_BITS 5
+
+/** Values of the t distribution for a 95% interval, by degrees of freedom
+  * from 1 to 30. Above, the normal value is close enough. */
+static const double t_95[] = {
+    12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+    2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+    2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+/** Finds the bucket of a value: the value itself below 32, else its power
+  * of two and its next 5 bits. */
+static int bucket_of(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return (int) value;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    int sub = (int) (value >> (exponent - SUB_BITS)) & (SUB_BUCKETS - 1);
+    return SUB_BUCKETS + (exponent - SUB_BITS) * SUB_BUCKETS + sub;
+}
+
+/** Gets the middle value of a bucket. */
+static uint64_t bucket_middle(int bucket) {
+    if (bucket < SUB_BUCKETS) {
+        return (uint64_t) bucket;
+    }
+    int shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+    uint64_t sub = (uint64_t) ((bucket - SUB_BUCKETS) % SUB_BUCKETS);
+    return ((SUB_BUCKETS + sub) << shift) + (((uint64_t) 1 << shift) >> 1);
+}
+
+void imc_histogram_add(imc_histogram_t* hist, uint64_t value) {
+    hist->count++;
+    hist->sum += (double) value;
+    hist->sum_sq += (double) value * (double) value;
+    if (value > hist->max) {
+        hist->max = value;
+    }
+    hist->buckets[bucket_of(value)]++;
+}
+
+/** Walks the buckets up to the rank of the percentile. */
+uint64_t imc_histogram_percentile(const imc_histogram_t* hist, double percent) {
+    if (hist->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t) ceil(percent / 100 * (double) hist->count);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < IMC_HISTOGRAM_BUCKETS; i++) {
+        seen += hist->buckets[i];
+        if (seen >= rank) {
+            uint64_t middle = bucket_middle(i);
+            return middle < hist->max ? middle : hist->max;
+        }
+    }
+    return hist->max;
+}
+
+double imc_histogram_mean(const imc_histogram_t* hist) {
+    return hist->count > 0 ? hist->sum / (double) hist->count : 0;
+}
+
+/** t * s / sqrt(n), with s the standard deviation of the sample. */
+double imc_histogram_ci95(const imc_histogram_t* hist) {
+    if (hist->count < 2) {
+        return 0;
+    }
+    double n = (double) hist->count;
+    double variance = (hist->sum_sq - hist->sum * hist->sum / n) / (n - 1);
+    if (variance < 0) { // rounding errors, when every value is the same.
+        variance = 0;
+    }
+    uint64_t freedom = hist->count - 1;
+    double t = freedom <= 30 ? t_95[freedom - 1] : 1.96;
+    return t * sqrt(variance / n);
+}
+
+void imc_bench_init(imc_bench_t* bench, const char* implem, const char* file,
+                    const char* const* op_names, int ops) {
+    memset(bench, 0, sizeof *bench);
+    bench->implem = implem;
+    bench->file = file;
+    bench->op_names = op_names;
+    bench->ops = ops < IMC_BENCH_OPS ? ops : IMC_BENCH_OPS;
+    bench->warmups = 10;
+    bench->iterations = 100;
+}
+
+/** Warms the caches, the allocators and the branch predictors up with runs
+  * left out of the results, records the measured ones, then the latencies
+  * of their commands in separate runs. */
+void imc_bench_run(imc_bench_t* bench, imc_bench_fn run, void* arg) {
+    for (int i = 0; i < bench->warmups; i++) {
+        run(arg);
+    }
+    bench->recording = true;
+    for (int i = 0; i < bench->iterations; i++) {
+        imc_histogram_add(&bench->runs, run(arg));
+    }
+    bench->recording = false;
+    bench->timing = true;
+    for (int i = 0; i < bench->iterations; i++) {
+        run(arg);
+    }
+    bench->timing = false;
+}
+
+bool imc_bench_parse_format(const char* name, imc_bench_format_t* format) {
+    if (strcmp(name, "text") == 0) {
+        *format = IMC_BENCH_TEXT;
+    } else if (strcmp(name, "csv") == 0) {
+        *format = IMC_BENCH_CSV;
+    } else if (strcmp(name, "json") == 0) {
+        *format = IMC_BENCH_JSON;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/** Prints a row of the text table. */
+static void print_text_row(FILE* out, const char* name, const imc_histogram_t* hist) {
+    fprintf(out, "%-8s %10lu %10.1f %10.1f %10lu %10lu %10lu %10lu\n", name,
+        (unsigned long) hist->count, imc_histogram_mean(hist),
+        imc_histogram_ci95(hist),
+        (unsigned long) imc_histogram_percentile(hist, 50),
+        (unsigned long) imc_histogram_percentile(hist, 99),
+        (unsigned long) imc_histogram_percentile(hist, 99.9),
+        (unsigned long) hist->max);
+}
+
+/** Prints the totals of the runs in seconds, then the table. */
+static void print_text(const imc_bench_t* bench, FILE* out) {
+    const imc_histogram_t* runs = &bench->runs;
+    double mean = imc_histogram_mean(runs);
+    double ci = imc_histogram_ci95(runs);
+    fprintf(out, "Total time: %.6fs\n", runs->sum / 1e9);
+    fprintf(out, "Average time: %.6fs\n", mean / 1e9);
+    fprintf(out, "Runs: %d (after %d warmup), 95%% CI: +/- %.6fs (%.2f%%)\n",
+        bench->iterations, bench->warmups, ci / 1e9,
+        mean > 0 ? 100 * ci / mean : 0);
+    fprintf(out, "%-8s %10s %10s %10s %10s %10s %10s %10s\n", "op (ns)",
+        "count", "mean", "ci95", "p50", "p99", "p999", "max");
+    print_text_row(out, "run", runs);
+    for (int i = 0; i < bench->ops; i++) {
+        if (bench->latencies[i].count > 0) {
+            print_text_row(out, bench->op_names[i], &bench->latencies[i]);
+        }
+    }
+}
+
+/** Prints a name in upper case, as the rows of stats.csv. */
+static void print_upper(FILE* out, const char* name) {
+    for (const char* c = name; *c != '\0'; c++) {
+        fputc(toupper((unsigned char) *c), out);
+    }
+    fputc('\n', out);
+}
+
+/** Prints the values of a row, separated by semicolons. */
+static void print_csv_row(FILE* out, const char* name, const imc_histogram_t* hist) {
+    print_upper(out, name);
+    fprintf(out, "%lu;%.1f;%.1f;%lu;%lu;%lu;%lu\n", (unsigned long) hist->count,
+        imc_histogram_mean(hist), imc_histogram_ci95(hist),
+        (unsigned long) imc_histogram_percentile(hist, 50),
+        (unsigned long) imc_histogram_percentile(hist, 99),
+        (unsigned long) imc_histogram_percentile(hist, 99.9),
+        (unsigned long) hist->max);
+}
+
+static void print_csv(const imc_bench_t* bench, FILE* out) {
+    print_upper(out, bench->implem);
+    fprintf(out, "count;mean;ci95;p50;p99;p999;max\n");
+    print_csv_row(out, "run", &bench->runs);
+    for (int i = 0; i < bench->ops; i++) {
+        if (bench->latencies[i].count > 0) {
+            print_csv_row(out, bench->op_names[i], &bench->latencies[i]);
+        }
+    }
+}
+
+/** Prints a string of JSON, escaping the quotes and backslashes. */
+static void print_json_string(FILE* out, const char* string) {
+    fputc('"', out);
+    for (const char* c = string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void print_json_row(FILE* out, const char* name, const imc_histogram_t* hist) {
+    fprintf(out, "    { \"op\": ");
+    print_json_string(out, name);
+    fprintf(out, ", \"count\": %lu, \"mean\": %.1f, \"ci95\": %.1f, \"p50\": %lu, "
+        "\"p99\": %lu, \"p999\": %lu, \"max\": %lu }", (unsigned long) hist->count,
+        imc_histogram_mean(hist), imc_histogram_ci95(hist),
+        (unsigned long) imc_histogram_percentile(hist, 50),
+        (unsigned long) imc_histogram_percentile(hist, 99),
+        (unsigned long) imc_histogram_percentile(hist, 99.9),
+        (unsigned long) hist->max);
+}
+
+static void print_json(const imc_bench_t* bench, FILE* out) {
+    fprintf(out, "{\n  \"implem\": ");
+    print_json_string(out, bench->implem);
+    fprintf(out, ",\n  \"file\": ");
+    print_json_string(out, bench->file);
+    fprintf(out, ",\n  \"warmups\": %d,\n  \"iterations\": %d,\n  \"unit\": \"ns\",\n"
+        "  \"rows\": [\n", bench->warmups, bench->iterations);
+    print_json_row(out, "run", &bench->runs);
+    for (int i = 0; i < bench->ops; i++) {
+        if (bench->latencies[i].count > 0) {
+            fprintf(out, ",\n");
+            print_json_row(out, bench->op_names[i], &bench->latencies[i]);
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
+
+void imc_bench_print(const imc_bench_t* bench, imc_bench_format_t format, FILE* out) {
+    switch (format) {
+    case IMC_BENCH_CSV:
+        print_csv(bench, out);
+        break;
+    case IMC_BENCH_JSON:
+        print_json(bench, out);
+        break;
+    case IMC_BENCH_TEXT:
+    default:
+        print_text(bench, out);
+        break;
+    }
+}
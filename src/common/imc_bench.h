@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+/** Buckets of a histogram: exact below 32, then 32 per power of two. */
+#define IMC_HISTOGRAM_BUCKETS (32 + 59 * 32)
+
+/** Most types of commands a bench records latencies of. */
+#define IMC_BENCH_OPS 16
+
+/**
+ * Histogram of durations in nanoseconds. Buckets are at most 1/32 wide
+ * relatively to their values, so percentiles are within about 1.5%, while
+ * the count, mean, standard deviation and max are exact.
+ */
+typedef struct _imc_histogram {
+    uint64_t count;
+    double sum;
+    double sum_sq;
+    uint64_t max;
+    uint64_t buckets[IMC_HISTOGRAM_BUCKETS];
+} imc_histogram_t;
+
+/** Formats of the results of a bench. */
+typedef enum { IMC_BENCH_TEXT, IMC_BENCH_CSV, IMC_BENCH_JSON } imc_bench_format_t;
+
+/**
+ * Harness running the script of a bench, all in the same process: some
+ * warmup runs, then the measured runs, kept in a histogram of their
+ * durations. Reading the clock around every command would slow these runs
+ * down, so as many runs follow to time each command, kept in a histogram
+ * of the latencies of each type of command.
+ */
+typedef struct _imc_bench {
+    const char* implem;               // Name of the structure benched.
+    const char* file;                 // Script of the bench.
+    const char* const* op_names;      // Name of each type of command.
+    int ops;                          // Number of types of commands.
+    int warmups;                      // Runs before the measured ones.
+    int iterations;                   // Measured runs.
+    bool recording;                   // Whether the current run is measured.
+    bool timing;                      // Whether its commands are timed.
+    imc_histogram_t runs;
+    imc_histogram_t latencies[IMC_BENCH_OPS];
+} imc_bench_t;
+
+/** A run of a bench, giving the nanoseconds of its timed part. */
+typedef uint64_t (*imc_bench_fn)(void* arg);
+
+/**
+ * Reads the monotonic clock.
+ * @return The time in nanoseconds.
+ */
+static inline uint64_t imc_bench_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * Adds a duration to a histogram.
+ * @param hist  The histogram.
+ * @param value The duration in nanoseconds.
+ */
+void imc_histogram_add(imc_histogram_t* hist, uint64_t value);
+
+/**
+ * Gets a percentile of a histogram, at the middle of its bucket.
+ * @param hist    The histogram.
+ * @param percent The percentile, from 0 to 100.
+ * @return The duration in nanoseconds, 0 if the histogram is empty.
+ */
+uint64_t imc_histogram_percentile(const imc_histogram_t* hist, double percent);
+
+/**
+ * Gets the mean of a histogram.
+ * @param hist The histogram.
+ * @return The mean in nanoseconds.
+ */
+double imc_histogram_mean(const imc_histogram_t* hist);
+
+/**
+ * Gets the half width of the 95% confidence interval of the mean of a
+ * histogram, with the t distribution.
+ * @param hist The histogram.
+ * @return The half width in nanoseconds, 0 below two values.
+ */
+double imc_histogram_ci95(const imc_histogram_t* hist);
+
+/**
+ * Initializes a harness, with 10 warmup runs and 100 measured ones.
+ * @param bench    The harness.
+ * @param implem   The name of the structure benched.
+ * @param file     The script of the bench.
+ * @param op_names The name of each type of command.
+ * @param ops      The number of types of commands, at most IMC_BENCH_OPS.
+ */
+void imc_bench_init(imc_bench_t* bench, const char* implem, const char* file,
+                    const char* const* op_names, int ops);
+
+/**
+ * Starts timing a command, if the commands of the current run are timed.
+ * @param bench The harness.
+ * @return The start of the command, for imc_bench_record.
+ */
+static inline uint64_t imc_bench_start(const imc_bench_t* bench) {
+    return bench->timing ? imc_bench_now() : 0;
+}
+
+/**
+ * Records the latency of a command, if the commands of the current run are
+ * timed.
+ * @param bench The harness.
+ * @param op    The type of the command.
+ * @param start What imc_bench_start returned before the command.
+ */
+static inline void imc_bench_record(imc_bench_t* bench, int op, uint64_t start) {
+    if (bench->timing) {
+        imc_histogram_add(&bench->latencies[op], imc_bench_now() - start);
+    }
+}
+
+/**
+ * Runs a bench: the warmup runs, the measured ones, then as many with their
+ * commands timed.
+ * @param bench The harness.
+ * @param run   A run of the bench.
+ * @param arg   The argument of run.
+ */
+void imc_bench_run(imc_bench_t* bench, imc_bench_fn run, void* arg);
+
+/**
+ * Parses the name of a format: text, csv or json.
+ * @param name   The name.
+ * @param format The format to set.
+ * @return true if the name is known, false otherwise.
+ */
+bool imc_bench_parse_format(const char* name, imc_bench_format_t* format);
+
+/**
+ * Prints the results of a bench: for the runs, then for each type of
+ * command recorded, the count, mean, 95% confidence interval, p50, p99,
+ * p999 and max, in nanoseconds. The CSV is laid out like stats.csv: the
+ * structure, the columns, then the name and values of each row.
+ * @param bench  The harness.
+ * @param format The format.
+ * @param out    The stream to print to.
+ */
+void imc_bench_print(const imc_bench_t* bench, imc_bench_format_t format, FILE* out);
@@ -0,0 +1,226 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "imc_pool.h"
+
+#define ALIGN 16
+#define CLASSES (IMC_POOL_MAX_SIZE / ALIGN)
+#define SLAB_SIZE (64 * 1024)
+#define BATCH 64
+
+/** A free block, linked to the next one of its class. */
+typedef struct _imc_block {
+    struct _imc_block* next;
+} imc_block_t;
+
+/** A list of free blocks of a class. */
+typedef struct _imc_free_list {
+    imc_block_t* head;
+    size_t count;
+} imc_free_list_t;
+
+/** A slab, linked to the previous one. Blocks follow the header. */
+typedef struct _imc_slab {
+    struct _imc_slab* next;
+    char padding[ALIGN - sizeof (struct _imc_slab*)];
+} imc_slab_t;
+
+/** Free lists and counters of the current thread. */
+static __thread imc_free_list_t cache[CLASSES];
+static __thread imc_pool_stats_t local = { 0, 0, 0, 0, 0, 0 };
+static __thread bool registered = false;
+static __thread bool flushed = false;
+
+/** Free lists shared by every thread, and counters of the exited threads. */
+static imc_free_list_t shared[CLASSES];
+static imc_slab_t* slabs = NULL;
+static imc_pool_stats_t retired = { 0, 0, 0, 0, 0, 0 };
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** Gives the free lists of the current thread back when it exits. */
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+
+/** Gets the class of a size. */
+static size_t size_class(size_t size) {
+    return size == 0 ? 0 : (size - 1) / ALIGN;
+}
+
+/** Moves count blocks, or all of them if there are less, from the head of
+  * src to the head of dest. */
+static void list_move(imc_free_list_t* dest, imc_free_list_t* src, size_t count) {
+    if (src->head == NULL) {
+        return;
+    }
+    imc_block_t* first = src->head;
+    imc_block_t* last = first;
+    size_t moved = 1;
+    while (moved < count && last->next != NULL) {
+        last = last->next;
+        moved++;
+    }
+    src->head = last->next;
+    src->count -= moved;
+    last->next = dest->head;
+    dest->head = first;
+    dest->count += moved;
+}
+
+/** Gives every block and counter of an exiting thread back. */
+static void cache_exit(void* arg) {
+    (void) arg;
+    pthread_mutex_lock(&shared_lock);
+    for (int i = 0; i < CLASSES; i++) {
+        list_move(&shared[i], &cache[i], cache[i].count);
+    }
+    retired.allocs  += local.allocs;
+    retired.frees   += local.frees;
+    retired.large   += local.large;
+    retired.refills += local.refills;
+    retired.spills  += local.spills;
+    pthread_mutex_unlock(&shared_lock);
+    local = (imc_pool_stats_t) { 0, 0, 0, 0, 0, 0 };
+    flushed = true;
+}
+
+/** Creates the key giving the free lists back. */
+static void cache_key_create(void) {
+    pthread_key_create(&cache_key, cache_exit);
+}
+
+/** Makes the lists and counters of the current thread given back when it
+  * exits. Called before its first block is cached, allocated or freed. */
+static void cache_register(void) {
+    if (registered == false) {
+        pthread_once(&cache_key_once, cache_key_create);
+        pthread_setspecific(cache_key, cache);
+        registered = true;
+    }
+}
+
+/** Cuts a new slab in blocks of a class, put in the list. The shared lock
+  * must be held. */
+static void carve_slab(imc_free_list_t* list, size_t class) {
+    imc_slab_t* slab = malloc(SLAB_SIZE);
+    slab->next = slabs;
+    slabs = slab;
+    retired.slabs += 1;
+
+    size_t size = (class + 1) * ALIGN;
+    char* end = (char*) slab + SLAB_SIZE;
+    for (char* block = (char*) (slab + 1); block + size <= end; block += size) {
+        ((imc_block_t*) block)->next = list->head;
+        list->head = (imc_block_t*) block;
+        list->count += 1;
+    }
+}
+
+/** Refills the list of a class of the current thread with a batch from the
+  * shared list, or with a new slab. */
+static void refill(size_t class) {
+    cache_register();
+    pthread_mutex_lock(&shared_lock);
+    if (shared[class].head != NULL) {
+        list_move(&cache[class], &shared[class], BATCH);
+    } else {
+        carve_slab(&cache[class], class);
+    }
+    pthread_mutex_unlock(&shared_lock);
+    local.refills += 1;
+}
+
+/** Gives a batch of a class of the current thread back to the shared list. */
+static void spill(size_t class) {
+    pthread_mutex_lock(&shared_lock);
+    list_move(&shared[class], &cache[class], BATCH);
+    pthread_mutex_unlock(&shared_lock);
+    local.spills += 1;
+}
+
+/** Pops a block from the list of its class, refilled if empty. */
+void* imc_pool_alloc(size_t size) {
+    if (size > IMC_POOL_MAX_SIZE) {
+        cache_register();
+        local.large += 1;
+        return malloc(size);
+    }
+    size_t class = size_class(size);
+    imc_free_list_t* list = &cache[class];
+    if (list->head == NULL) {
+        refill(class);
+    }
+    imc_block_t* block = list->head;
+    list->head = block->next;
+    list->count -= 1;
+    local.allocs += 1;
+    return block;
+}
+
+/** Pushes a block on the list of its class, spilled if too long. A thread
+  * which only frees blocks, like the background reclaimer, registers its
+  * lists on the first one. After the thread gave its lists back, the block
+  * goes to the shared list, and is counted with the exited threads. */
+void imc_pool_free(void* block, size_t size) {
+    if (block == NULL) {
+        return;
+    } else if (size > IMC_POOL_MAX_SIZE) {
+        free(block);
+        return;
+    }
+    size_t class = size_class(size);
+    if (flushed == true) {
+        pthread_mutex_lock(&shared_lock);
+        ((imc_block_t*) block)->next = shared[class].head;
+        shared[class].head = block;
+        shared[class].count += 1;
+        retired.frees += 1;
+        pthread_mutex_unlock(&shared_lock);
+        return;
+    }
+    cache_register();
+    imc_free_list_t* list = &cache[class];
+    ((imc_block_t*) block)->next = list->head;
+    list->head = block;
+    list->count += 1;
+    local.frees += 1;
+    if (list->count >= 4 * BATCH) {
+        spill(class);
+    }
+}
+
+/** Adds the counters of the current thread to those of the exited ones. */
+void imc_pool_stats(imc_pool_stats_t* stats) {
+    pthread_mutex_lock(&shared_lock);
+    *stats = retired;
+    pthread_mutex_unlock(&shared_lock);
+    stats->allocs  += local.allocs;
+    stats->frees   += local.frees;
+    stats->large   += local.large;
+    stats->refills += local.refills;
+    stats->spills  += local.spills;
+}
+
+/** Prints the counters on a line. */
+void imc_pool_print_stats(FILE* out) {
+    imc_pool_stats_t stats;
+    imc_pool_stats(&stats);
+    fprintf(out, "Pool: %zu allocs, %zu frees, %zu large, %zu refills, "
+        "%zu spills, %zu slabs (%zu KiB)\n", stats.allocs, stats.frees,
+        stats.large, stats.refills, stats.spills, stats.slabs,
+        stats.slabs * SLAB_SIZE / 1024);
+}
+
+/** Allocates with malloc. */
+static void* malloc_alloc(size_t size) {
+    return malloc(size);
+}
+
+/** Frees with free. */
+static void malloc_free(void* block, size_t size) {
+    (void) size;
+    free(block);
+}
+
+const imc_allocator_t imc_pool_allocator = { imc_pool_alloc, imc_pool_free };
+const imc_allocator_t imc_malloc_allocator = { malloc_alloc, malloc_free };
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Allocator of the nodes of the immutable structures. Blocks are freed with
+ * their size, so that no header is needed to find it back.
+ */
+typedef struct _imc_allocator {
+    void* (*alloc)(size_t size);
+    void  (*free)(void* block, size_t size);
+} imc_allocator_t;
+
+/** The pool allocator below, used by default by every structure. */
+extern const imc_allocator_t imc_pool_allocator;
+
+/** The C library allocator. */
+extern const imc_allocator_t imc_malloc_allocator;
+
+/**
+ * Pool of blocks, by size class of 16 bytes up to IMC_POOL_MAX_SIZE. Each
+ * thread keeps a free list by class, and exchanges blocks by batches with
+ * lists shared by every thread, refilled from slabs. Larger blocks are left
+ * to malloc.
+ */
+#define IMC_POOL_MAX_SIZE 1024
+
+/** Counters of the pool. */
+typedef struct _imc_pool_stats {
+    size_t allocs;   // Blocks allocated from the pool.
+    size_t frees;    // Blocks given back to the pool.
+    size_t large;    // Blocks too large for the pool, left to malloc.
+    size_t refills;  // Batches taken by a thread from the shared lists or a slab.
+    size_t spills;   // Batches given back by a thread to the shared lists.
+    size_t slabs;    // Slabs reserved from the system.
+} imc_pool_stats_t;
+
+/**
+ * Allocates a block from the pool.
+ * @param size The size of the block.
+ * @return The block.
+ */
+void* imc_pool_alloc(size_t size);
+
+/**
+ * Gives a block back to the pool.
+ * @param block The block, may be NULL.
+ * @param size  The size it was allocated with.
+ */
+void imc_pool_free(void* block, size_t size);
+
+/**
+ * Gets the counters of the current thread, and of the threads which exited.
+ * @param stats The counters to fill.
+ */
+void imc_pool_stats(imc_pool_stats_t* stats);
+
+/**
+ * Prints the counters of the pool.
+ * @param out The stream to print to.
+ */
+void imc_pool_print_stats(FILE* out);
@@ -0,0 +1,180 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "imc_reclaim.h"
+
+/** A node waiting to be freed, with its function. */
+typedef struct _imc_reclaim_item {
+    void* node;
+    imc_reclaim_fn fn;
+} imc_reclaim_item_t;
+
+/** A stack of nodes waiting to be freed. */
+typedef struct _imc_worklist {
+    imc_reclaim_item_t* items;
+    size_t size;
+    size_t capacity;
+} imc_worklist_t;
+
+/** Nodes waiting in the current thread, and its mode. */
+static __thread imc_worklist_t local = { NULL, 0, 0 };
+static __thread size_t budget = 0;
+static __thread bool reclaiming = false;
+
+/** Frees the worklist of a thread when it exits. */
+static pthread_key_t local_key;
+static pthread_once_t local_key_once = PTHREAD_ONCE_INIT;
+
+/** Nodes handed to the background thread. */
+static imc_worklist_t shared = { NULL, 0, 0 };
+static pthread_mutex_t shared_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t shared_filled = PTHREAD_COND_INITIALIZER;
+static pthread_t background;
+static bool background_running = false;
+static bool background_stop = false;
+
+/** Makes room for size more nodes in a worklist. */
+static void worklist_reserve(imc_worklist_t* worklist, size_t size) {
+    if (worklist->size + size > worklist->capacity) {
+        while (worklist->size + size > worklist->capacity) {
+            worklist->capacity = worklist->capacity == 0 ? 64 : worklist->capacity * 2;
+        }
+        worklist->items = realloc(worklist->items,
+            worklist->capacity * sizeof *worklist->items);
+    }
+}
+
+/** Moves every node of src at the end of dest. */
+static void worklist_move(imc_worklist_t* dest, imc_worklist_t* src) {
+    worklist_reserve(dest, src->size);
+    memcpy(&dest->items[dest->size], src->items, src->size * sizeof *src->items);
+    dest->size += src->size;
+    src->size = 0;
+}
+
+/** Frees the nodes of the current thread, at most limit of them if it is not
+  * 0. The children of a node freed are pushed, and freed next. */
+static void reclaim_local(size_t limit) {
+    reclaiming = true;
+    for (size_t freed = 0; local.size > 0 && (limit == 0 || freed < limit); freed++) {
+        imc_reclaim_item_t item = local.items[--local.size];
+        item.fn(item.node);
+    }
+    reclaiming = false;
+}
+
+/** Frees the worklist of an exiting thread, after its last nodes. */
+static void local_exit(void* worklist) {
+    reclaim_local(0);
+    free(((imc_worklist_t*) worklist)->items);
+    ((imc_worklist_t*) worklist)->items = NULL;
+    ((imc_worklist_t*) worklist)->capacity = 0;
+}
+
+/** Creates the key freeing the worklists. */
+static void local_key_create(void) {
+    pthread_key_create(&local_key, local_exit);
+}
+
+/** Makes the worklist of the current thread freed when it exits. */
+static void local_register(void) {
+    pthread_once(&local_key_once, local_key_create);
+    pthread_setspecific(local_key, &local);
+}
+
+#ifdef IMC_THREAD_SAFE
+/** Frees the nodes handed to the background thread, until it is stopped. */
+static void* background_loop(void* arg) {
+    (void) arg;
+    local_register();
+    pthread_mutex_lock(&shared_lock);
+    while (true) {
+        while (shared.size == 0 && background_stop == false) {
+            pthread_cond_wait(&shared_filled, &shared_lock);
+        }
+        if (shared.size == 0) {
+            break;
+        }
+        worklist_move(&local, &shared);
+        pthread_mutex_unlock(&shared_lock);
+        reclaim_local(0);
+        pthread_mutex_lock(&shared_lock);
+    }
+    pthread_mutex_unlock(&shared_lock);
+    return NULL;
+}
+#endif
+
+/** Queues the node, then frees the nodes of the current thread according to
+  * the mode, unless they are already being freed. */
+void imc_reclaim(void* node, imc_reclaim_fn fn) {
+    if (local.capacity == 0) {
+        local_register();
+    }
+    worklist_reserve(&local, 1);
+    local.items[local.size++] = (imc_reclaim_item_t) { node, fn };
+    if (reclaiming == true) {
+        return;
+    }
+
+    if (__atomic_load_n(&background_running, __ATOMIC_ACQUIRE) == true) {
+        pthread_mutex_lock(&shared_lock);
+        worklist_move(&shared, &local);
+        pthread_cond_signal(&shared_filled);
+        pthread_mutex_unlock(&shared_lock);
+    } else {
+        reclaim_local(budget);
+    }
+}
+
+/** Sets the budget of the current thread. */
+void imc_reclaim_set_budget(size_t size) {
+    budget = size;
+}
+
+/** Frees every node of the current thread. */
+void imc_reclaim_drain(void) {
+    if (reclaiming == false) {
+        reclaim_local(0);
+    }
+}
+
+/** Gets the number of nodes of the current thread. */
+size_t imc_reclaim_pending(void) {
+    return local.size;
+}
+
+/** Starts the background thread, if not started yet. Without atomic
+  * reference counts, it would race with the threads using the nodes. */
+bool imc_reclaim_start(void) {
+#ifdef IMC_THREAD_SAFE
+    pthread_mutex_lock(&shared_lock);
+    if (background_running == false) {
+        background_stop = false;
+        pthread_create(&background, NULL, background_loop, NULL);
+        __atomic_store_n(&background_running, true, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&shared_lock);
+    return true;
+#else
+    return false;
+#endif
+}
+
+/** Stops the background thread, and waits for it. */
+void imc_reclaim_stop(void) {
+    pthread_mutex_lock(&shared_lock);
+    if (background_running == false) {
+        pthread_mutex_unlock(&shared_lock);
+        return;
+    }
+    __atomic_store_n(&background_running, false, __ATOMIC_RELEASE);
+    background_stop = true;
+    pthread_cond_signal(&shared_filled);
+    pthread_mutex_unlock(&shared_lock);
+    pthread_join(background, NULL);
+    free(shared.items);
+    shared = (imc_worklist_t) { NULL, 0, 0 };
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Reclamation of the nodes of the immutable structures. Instead of freeing a
+ * whole tree recursively when its last reference is dropped, the structures
+ * hand the unreferenced nodes to the reclaimer, which frees them from a
+ * worklist. According to the mode, the nodes are freed:
+ * - right away, all of them (default);
+ * - at most budget of them per call, the others in the next calls;
+ * - by a background thread, which needs thread safe reference counts.
+ */
+
+/**
+ * Function freeing a node whose last reference was dropped. It releases the
+ * children of the node, and hands those left unreferenced to imc_reclaim.
+ * @param node The node to free.
+ */
+typedef void (*imc_reclaim_fn)(void* node);
+
+/**
+ * Hands an unreferenced node to the reclaimer. When called from a function
+ * freeing a node, the node is only queued.
+ * @param node The node to free.
+ * @param fn   The function freeing it.
+ */
+void imc_reclaim(void* node, imc_reclaim_fn fn);
+
+/**
+ * Sets the number of nodes freed at most by each call to imc_reclaim, in the
+ * current thread. The nodes left wait for the next calls.
+ * @param budget The number of nodes, 0 for no limit.
+ */
+void imc_reclaim_set_budget(size_t budget);
+
+/**
+ * Frees every node waiting in the current thread.
+ */
+void imc_reclaim_drain(void);
+
+/**
+ * Gets the number of nodes waiting in the current thread.
+ * @return The number of nodes not freed yet.
+ */
+size_t imc_reclaim_pending(void);
+
+/**
+ * Starts the background thread. From then, the nodes handed to the reclaimer
+ * are freed by it, in every thread. It frees nodes while the other threads
+ * use their neighbours, so it needs the atomic reference counts of
+ * IMC_THREAD_SAFE builds (THREAD_SAFE=1), and is refused otherwise.
+ * @return true if the thread runs, false if the build isn't thread safe.
+ */
+bool imc_reclaim_start(void);
+
+/**
+ * Stops the background thread, once it freed every node handed to it.
+ */
+void imc_reclaim_stop(void);
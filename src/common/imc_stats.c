@@ -0,0 +1,51 @@
+#include "imc_stats.h"
+
+#ifdef IMC_STATS
+__thread imc_stats_t imc_stats = { 0, 0, 0, 0, 0, 0, 0 };
+#endif
+
+/** Copies the counters, or zeros without IMC_STATS. */
+void imc_stats_get(imc_stats_t* stats) {
+#ifdef IMC_STATS
+    *stats = imc_stats;
+#else
+    *stats = (imc_stats_t) { 0, 0, 0, 0, 0, 0, 0 };
+#endif
+}
+
+/** Zeros the counters. */
+void imc_stats_reset(void) {
+#ifdef IMC_STATS
+    imc_stats = (imc_stats_t) { 0, 0, 0, 0, 0, 0, 0 };
+#endif
+}
+
+/** Adds the differences of each counter. */
+void imc_stats_add_since(imc_stats_t* total, const imc_stats_t* before) {
+    imc_stats_t now;
+    imc_stats_get(&now);
+    total->copies  += now.copies  - before->copies;
+    total->allocs  += now.allocs  - before->allocs;
+    total->bytes   += now.bytes   - before->bytes;
+    total->incs    += now.incs    - before->incs;
+    total->decs    += now.decs    - before->decs;
+    total->lookups += now.lookups - before->lookups;
+    total->visited += now.visited - before->visited;
+}
+
+/** Prints the names of the columns. */
+void imc_stats_print_header(FILE* out) {
+    fprintf(out, "%-8s %10s %10s %10s %10s %10s %10s %14s\n", "op", "count",
+        "copies/op", "allocs/op", "bytes/op", "incs/op", "decs/op",
+        "visited/lookup");
+}
+
+/** Prints the averages, per operation and per lookup. */
+void imc_stats_print(FILE* out, const char* name, size_t operations,
+                     const imc_stats_t* stats) {
+    double n = operations > 0 ? (double) operations : 1;
+    double lookups = stats->lookups > 0 ? (double) stats->lookups : 1;
+    fprintf(out, "%-8s %10zu %10.2f %10.2f %10.1f %10.2f %10.2f %14.2f\n", name,
+        operations, stats->copies / n, stats->allocs / n, stats->bytes / n,
+        stats->incs / n, stats->decs / n, stats->visited / lookups);
+}
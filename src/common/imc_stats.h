@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Counters of the work done by the operations of the immutable structures,
+ * for each thread. Built with IMC_STATS (make STATS=1), the structures count
+ * as they go; built without, the counting is compiled out and the counters
+ * stay at 0.
+ */
+typedef struct _imc_stats {
+    size_t copies;    // Nodes copied.
+    size_t allocs;    // Blocks allocated, for nodes and versions.
+    size_t bytes;     // Bytes of these blocks.
+    size_t incs;      // References taken.
+    size_t decs;      // References dropped.
+    size_t lookups;   // Lookups.
+    size_t visited;   // Nodes visited by the lookups.
+} imc_stats_t;
+
+#ifdef IMC_STATS
+extern __thread imc_stats_t imc_stats __attribute__((tls_model("initial-exec")));
+#define imc_count(field, n) ((void) (imc_stats.field += (n)))
+#else
+#define imc_count(field, n) ((void) 0)
+#endif
+
+/**
+ * Gets the counters of the current thread.
+ * @param stats The counters to fill.
+ */
+void imc_stats_get(imc_stats_t* stats);
+
+/**
+ * Resets the counters of the current thread.
+ */
+void imc_stats_reset(void);
+
+/**
+ * Adds to total what the current thread counted since before was taken.
+ * @param total  The counters to add to.
+ * @param before Counters taken earlier with imc_stats_get.
+ */
+void imc_stats_add_since(imc_stats_t* total, const imc_stats_t* before);
+
+/**
+ * Prints the header of the rows printed by imc_stats_print.
+ * @param out The stream to print to.
+ */
+void imc_stats_print_header(FILE* out);
+
+/**
+ * Prints counters as a row, averaged on a number of operations.
+ * @param out        The stream to print to.
+ * @param name       The name of the operations.
+ * @param operations The number of operations counted.
+ * @param stats      The counters.
+ */
+void imc_stats_print(FILE* out, const char* name, size_t operations,
+                     const imc_stats_t* stats);
@@ -0,0 +1,168 @@
+#include <sched.h>
+#include <stdlib.h>
+
+#include "imc_thread_pool.h"
+
+/** Pool and deque of the current thread, NULL and -1 outside of a pool. */
+static __thread thread_pool_t* current_pool = NULL;
+static __thread int current_deque = -1;
+
+/** Argument of a worker thread. */
+typedef struct _thread_pool_worker {
+    thread_pool_t* pool;
+    int deque;
+} thread_pool_worker_t;
+
+/** Gets the deque used by the current thread in pool. */
+int own_deque(const thread_pool_t* pool) {
+    return current_pool == pool ? current_deque : pool->threads;
+}
+
+/** Pushes a task at the tail of a deque, growing it if needed. */
+void deque_push(thread_pool_deque_t* deque, thread_pool_task_t* task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail == deque->capacity) {
+        deque->capacity = deque->capacity == 0 ? 64 : deque->capacity * 2;
+        deque->tasks = realloc(deque->tasks, deque->capacity * sizeof *deque->tasks);
+    }
+    deque->tasks[deque->tail++] = task;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+/** Takes the task at the tail of a deque, or at its head if steal is set.
+  * Returns NULL if the deque is empty. */
+thread_pool_task_t* deque_take(thread_pool_deque_t* deque, bool steal) {
+    thread_pool_task_t* task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->head < deque->tail) {
+        task = steal == true ? deque->tasks[deque->head++] : deque->tasks[--deque->tail];
+        if (deque->head == deque->tail) {
+            deque->head = 0;
+            deque->tail = 0;
+        }
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+/** Takes a task from the own deque of the current thread, else steals one
+  * from the other deques. Returns NULL if there is none. */
+thread_pool_task_t* take_task(thread_pool_t* pool) {
+    int own = own_deque(pool);
+    thread_pool_task_t* task = deque_take(&pool->deques[own], false);
+    for (int i = 1; task == NULL && i <= pool->threads; i++) {
+        task = deque_take(&pool->deques[(own + i) % (pool->threads + 1)], true);
+    }
+    if (task != NULL) {
+        __atomic_sub_fetch(&pool->pending, 1, __ATOMIC_RELAXED);
+    }
+    return task;
+}
+
+/** Runs a task, and marks it as done. */
+void run_task(thread_pool_task_t* task) {
+    task->fn(task->arg);
+    __atomic_store_n(&task->done, true, __ATOMIC_RELEASE);
+}
+
+/** Runs the tasks of the pool, and sleeps while there is none. */
+void* worker_loop(void* arg) {
+    thread_pool_worker_t* worker = arg;
+    thread_pool_t* pool = worker->pool;
+    current_pool = pool;
+    current_deque = worker->deque;
+    free(worker);
+
+    while (true) {
+        thread_pool_task_t* task = take_task(pool);
+        if (task != NULL) {
+            run_task(task);
+            continue;
+        }
+        pthread_mutex_lock(&pool->idle_lock);
+        while (__atomic_load_n(&pool->pending, __ATOMIC_RELAXED) <= 0 && pool->stop == false) {
+            pthread_cond_wait(&pool->idle, &pool->idle_lock);
+        }
+        bool stop = pool->stop;
+        pthread_mutex_unlock(&pool->idle_lock);
+        if (stop == true) {
+            return NULL;
+        }
+    }
+}
+
+/** Creates a pool, and starts its workers. */
+thread_pool_t* thread_pool_create(int threads) {
+    thread_pool_t* pool = malloc(sizeof *pool);
+    pool->threads = threads;
+    pool->pending = 0;
+    pool->stop = false;
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pool->deques = calloc(threads + 1, sizeof *pool->deques);
+    for (int i = 0; i <= threads; i++) {
+        pthread_mutex_init(&pool->deques[i].lock, NULL);
+    }
+    pool->workers = malloc(threads * sizeof *pool->workers);
+    for (int i = 0; i < threads; i++) {
+        thread_pool_worker_t* worker = malloc(sizeof *worker);
+        worker->pool = pool;
+        worker->deque = i;
+        pthread_create(&pool->workers[i], NULL, worker_loop, worker);
+    }
+    return pool;
+}
+
+/** Pushes a task, and wakes up a worker. */
+void thread_pool_spawn(thread_pool_t* pool, thread_pool_task_t* task) {
+    task->done = false;
+    deque_push(&pool->deques[own_deque(pool)], task);
+    pthread_mutex_lock(&pool->idle_lock);
+    __atomic_add_fetch(&pool->pending, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&pool->idle);
+    pthread_mutex_unlock(&pool->idle_lock);
+}
+
+/** Waits for a task, by running the tasks of the pool meanwhile. */
+void thread_pool_join(thread_pool_t* pool, thread_pool_task_t* task) {
+    while (__atomic_load_n(&task->done, __ATOMIC_ACQUIRE) == false) {
+        thread_pool_task_t* other = take_task(pool);
+        if (other != NULL) {
+            run_task(other);
+        } else {
+            sched_yield();
+        }
+    }
+}
+
+/** Spawns every task but the first, which is run right away, then joins
+  * them. The last spawned is the first taken back by the current thread. */
+void thread_pool_run(thread_pool_t* pool, thread_pool_task_t* tasks, int size) {
+    for (int i = size - 1; i > 0; i--) {
+        thread_pool_spawn(pool, &tasks[i]);
+    }
+    run_task(&tasks[0]);
+    for (int i = 1; i < size; i++) {
+        thread_pool_join(pool, &tasks[i]);
+    }
+}
+
+/** Stops and joins the workers, then frees the pool. */
+void thread_pool_free(thread_pool_t* pool) {
+    pthread_mutex_lock(&pool->idle_lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->idle);
+    pthread_mutex_unlock(&pool->idle_lock);
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_join(pool->workers[i], NULL);
+    }
+    for (int i = 0; i <= pool->threads; i++) {
+        pthread_mutex_destroy(&pool->deques[i].lock);
+        free(pool->deques[i].tasks);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle);
+    free(pool->deques);
+    free(pool->workers);
+    free(pool);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+
+/**
+ * A task run by a pool: a function and its argument. done is set once the
+ * function returned.
+ */
+typedef struct _thread_pool_task {
+    void (*fn)(void* arg); // The function to run.
+    void* arg;             // The argument given to fn.
+    bool done;             // Indicates if fn returned.
+} thread_pool_task_t;
+
+/**
+ * The tasks waiting in a worker. The worker takes the last one pushed, the
+ * others steal the first one.
+ */
+typedef struct _thread_pool_deque {
+    pthread_mutex_t lock;
+    thread_pool_task_t** tasks; // Tasks from head to tail.
+    int head;                   // Index of the first task.
+    int tail;                   // Index after the last task.
+    int capacity;               // Number of tasks allocated.
+} thread_pool_deque_t;
+
+/**
+ * A work-stealing pool of threads. Each worker has a deque, and the threads
+ * outside the pool share an extra one. A thread waiting for a task runs the
+ * tasks it finds meanwhile, so tasks can spawn and join other tasks.
+ */
+typedef struct _thread_pool {
+    int threads;                 // Number of workers.
+    pthread_t* workers;          // The threads of the workers.
+    thread_pool_deque_t* deques; // A deque per worker, then the shared one.
+    int pending;                 // Number of tasks waiting in the deques.
+    bool stop;                   // Indicates if the workers must stop.
+    pthread_mutex_t idle_lock;   // Protects the wake up of idle workers.
+    pthread_cond_t idle;         // Signaled when a task is pushed.
+} thread_pool_t;
+
+/**
+ * Creates a pool of threads.
+ * @param  threads The number of workers.
+ * @return         A newly created pool.
+ */
+thread_pool_t* thread_pool_create(int threads);
+
+/**
+ * Pushes a task in the deque of the current thread. The task must live until
+ * it is joined.
+ * @param pool The pool.
+ * @param task The task to run.
+ */
+void thread_pool_spawn(thread_pool_t* pool, thread_pool_task_t* task);
+
+/**
+ * Waits for a task to be done, running the other tasks of the pool meanwhile.
+ * @param pool The pool.
+ * @param task The task to wait for.
+ */
+void thread_pool_join(thread_pool_t* pool, thread_pool_task_t* task);
+
+/**
+ * Runs tasks in parallel: the first one in the current thread, the others
+ * spawned, then waits for all of them.
+ * @param pool  The pool.
+ * @param tasks The tasks to run.
+ * @param size  The number of tasks.
+ */
+void thread_pool_run(thread_pool_t* pool, thread_pool_task_t* tasks, int size);
+
+/**
+ * Stops the workers and frees a pool. No task must remain.
+ * @param pool The pool to free.
+ */
+void thread_pool_free(thread_pool_t* pool);
@@ -7,21 +7,40 @@
 
 #define NODE_MAX_SIZE 4
 
+/* Take a reference on a finger node or a deep */
+#define incr_ref(node) ((node)->ref_counter++, imc_count(incs, 1))
+
+/* Allocator of the finger nodes and the deeps */
+static const imc_allocator_t* allocator = &imc_pool_allocator;
+
+void finger_set_allocator(const imc_allocator_t* new_allocator) {
+    allocator = new_allocator;
+}
+
+/**
+ * Allocate a block with the allocator
+ */
+static void* alloc_block(size_t size) {
+    imc_count(allocs, 1);
+    imc_count(bytes, size);
+    return allocator->alloc(size);
+}
+
 /**
  * Return blank finger node with ref counter properly set
  */
 fingernode_t* make_fingernode(int arity, node_type_t type) {
     finger_debug("make_fingernode\n");
-    fingernode_t* res = malloc(sizeof(fingernode_t));
+    fingernode_t* res = alloc_block(sizeof(fingernode_t));
     res->ref_counter = 1;
     res->arity = arity;
     res->node_type = type;
     switch (type) {
     case DATA_NODE:
-        res->content.data = malloc(arity * sizeof(finger_data_t*));
+        res->content.data = alloc_block(arity * sizeof(finger_data_t*));
         break;
     case TREE_NODE:
-        res->content.children = malloc(arity * sizeof(fingernode_t*));
+        res->content.children = alloc_block(arity * sizeof(fingernode_t*));
         break;
     default:
         break;
@@ -34,6 +53,7 @@ fingernode_t* make_fingernode(int arity, node_type_t type) {
  */
 fingernode_t* copy_node(fingernode_t* node){
     fingernode_t* res = make_fingernode(node->arity, node->node_type);
+    imc_count(copies, 1);
     res->lookup_idx = node->lookup_idx;
     switch (res->node_type) {
     case DATA_NODE:
@@ -74,7 +94,7 @@ void update_lookup_idx(fingernode_t* node) {
 void increment_children_refs(fingernode_t* node) {
     if (node->node_type == TREE_NODE) {
         for (int i=0; i<node->arity; i++) {
-            node->content.children[i]->ref_counter++;
+            incr_ref(node->content.children[i]);
         }
     }
 }
@@ -141,13 +161,13 @@ fingernode_t* make_treenode_and_cpy(int node_count, fingernode_t* new_node, fing
         res->content.children[0] = new_node;
         for (int i=1; i<node_count+1; i++) {
             res->content.children[i] = old_nodes[i-1];
-            res->content.children[i]->ref_counter++;
+            incr_ref(res->content.children[i]);
         }
         break;
     case FINGER_RIGHT:
         for (int i=0; i<node_count; i++) {
             res->content.children[i] = old_nodes[i];
-            res->content.children[i]->ref_counter++;
+            incr_ref(res->content.children[i]);
         }
         res->content.children[node_count] = new_node;
         break;
@@ -258,7 +278,7 @@ fingernode_t* split_append_datanode (finger_data_t* new_value, fingernode_t* old
  */
 deep_t* make_deep() {
     finger_debug("make_deep\n");
-    deep_t* res = malloc(sizeof(deep_t));
+    deep_t* res = alloc_block(sizeof(deep_t));
     res->ref_counter = 1;
     res->tag = 0;
     return res;
@@ -306,15 +326,15 @@ void destroy_fingernode(fingernode_t* node) {
     finger_debug("destroy_fingernode\n");
     switch (node->node_type) {
     case TREE_NODE:
-        free(node->content.children);
+        allocator->free(node->content.children, node->arity * sizeof(fingernode_t*));
         break;
     case DATA_NODE:
-        free(node->content.data);
+        allocator->free(node->content.data, node->arity * sizeof(finger_data_t*));
         break;
     default:
         break;
     }
-    free(node);
+    allocator->free(node, sizeof(fingernode_t));
 }
 
 /**
@@ -322,7 +342,7 @@ void destroy_fingernode(fingernode_t* node) {
  */
 void destroy_deep(deep_t* deep) {
     finger_debug("destroy_deep\n");
-    free(deep);
+    allocator->free(deep, sizeof(deep_t));
 }
 
 /**
@@ -331,6 +351,7 @@ void destroy_deep(deep_t* deep) {
 int unref_fingernode(fingernode_t* node) {
     finger_debug("unref_fingernode\n");
     node->ref_counter--;
+    imc_count(decs, 1);
     if (node->ref_counter) { // i.e. ref_count != 0
         return 1;
     }
@@ -352,6 +373,7 @@ int unref_fingernode(fingernode_t* node) {
 int unref_deep(deep_t* deep) {
     finger_debug("unref_deep\n");
     deep->ref_counter--;
+    imc_count(decs, 1);
     if (deep->ref_counter) {
         return 0;
     }
@@ -469,14 +491,14 @@ deep_t* append_node(deep_t* deep, fingernode_t* node, side_t side) {
                 newdeep->left = new_mod_node;
                 newdeep->right = deep->right;
                 if (newdeep->right) {
-                    newdeep->right->ref_counter++;
+                    incr_ref(newdeep->right);
                 }
                 break;
             case FINGER_RIGHT:
                 newdeep->right = new_mod_node;
                 newdeep->left = deep->left;
                 if (newdeep->left) {
-                    newdeep->left->ref_counter++;
+                    incr_ref(newdeep->left);
                 }
                 break;
             default:
@@ -486,16 +508,16 @@ deep_t* append_node(deep_t* deep, fingernode_t* node, side_t side) {
             newdeep->content.deeper = append_node(deep->content.deeper, append, side);
         } else {
             newdeep->content.deeper = deep->content.deeper;
-            newdeep->content.deeper->ref_counter++;
+            incr_ref(newdeep->content.deeper);
             switch (side) {
             case FINGER_LEFT:
                 newdeep->right = deep->right;
-                newdeep->right->ref_counter++;
+                incr_ref(newdeep->right);
                 newdeep->left = make_treenode_and_cpy(mod_node->arity, node, mod_node->content.children, side);
                 break;
             case FINGER_RIGHT:
                 newdeep->left = deep->left;
-                newdeep->left->ref_counter++;
+                incr_ref(newdeep->left);
                 newdeep->right = make_treenode_and_cpy(mod_node->arity, node, mod_node->content.children, side);
             default:
                 break;
@@ -508,7 +530,7 @@ deep_t* append_node(deep_t* deep, fingernode_t* node, side_t side) {
         finger_debug("single\n");
         fingernode_t* single = deep->content.single;
         if (single->arity == NODE_MAX_SIZE) {
-            single->ref_counter++;
+            incr_ref(single);
             switch (side) {
             case FINGER_LEFT:
                 return make_deep_node(node, make_empty_node(), single);
@@ -554,14 +576,14 @@ deep_t* append(deep_t* tree, finger_data_t* value, side_t side) {
                 newdeep->left = new_mod_node;
                 newdeep->right = tree->right;
                 if (newdeep->right) {
-                    newdeep->right->ref_counter++;
+                    incr_ref(newdeep->right);
                 }
                 break;
             case FINGER_RIGHT:
                 newdeep->right = new_mod_node;
                 newdeep->left = tree->left;
                 if (newdeep->left) {
-                    newdeep->left->ref_counter++;
+                    incr_ref(newdeep->left);
                 }
                 break;
             default:
@@ -571,16 +593,16 @@ deep_t* append(deep_t* tree, finger_data_t* value, side_t side) {
             newdeep->content.deeper = append_node(tree->content.deeper, append, side);
         } else {
             newdeep->content.deeper = tree->content.deeper;
-            newdeep->content.deeper->ref_counter++;
+            incr_ref(newdeep->content.deeper);
             switch (side) {
             case FINGER_LEFT:
                 newdeep->right = tree->right;
-                newdeep->right->ref_counter++;
+                incr_ref(newdeep->right);
                 newdeep->left = make_datanode_and_cpy(mod_node->arity, value, mod_node->content.data, side);
                 break;
             case FINGER_RIGHT:
                 newdeep->left = tree->left;
-                newdeep->left->ref_counter++;
+                incr_ref(newdeep->left);
                 newdeep->right = make_datanode_and_cpy(mod_node->arity, value, mod_node->content.data, side);
             default:
                 break;
@@ -595,7 +617,7 @@ deep_t* append(deep_t* tree, finger_data_t* value, side_t side) {
         finger_debug("single\n");
         fingernode_t* single = tree->content.single;
         if (single->arity >= NODE_MAX_SIZE) {
-            single->ref_counter++;
+            incr_ref(single);
             switch (side) {
             case FINGER_LEFT:
                 return make_deep_node(valuenode, make_empty_node(), single);
@@ -640,15 +662,15 @@ deep_t* pop_deep(deep_t* tree, fingernode_t** data) {
         deep_t* new_deep = NULL;
         if (cur_node->arity > 1) { // Just chop from the suffix
             fingernode_t* new_suffix = copy_remove_tail(cur_node);
-            tree->left->ref_counter++;
-            tree->content.deeper->ref_counter++;
+            incr_ref(tree->left);
+            incr_ref(tree->content.deeper);
             new_deep = make_deep_node(tree->left, tree->content.deeper, new_suffix);
         } else if (cur_node->arity == 1) {                 // We recursive boyz
             fingernode_t* promo_node;
             deep_t* pop_deeper = pop_deep(tree->content.deeper, &promo_node);
             if (!pop_deeper) {   // We're splitting the prefix/suffix and making a deep->empty
                 if (tree->left->arity == 1) {
-                    tree->left->ref_counter++;
+                    incr_ref(tree->left);
                     new_deep = make_single_node(tree->left);
                 } else {
                     fingernode_t* prefix;
@@ -657,7 +679,7 @@ deep_t* pop_deep(deep_t* tree, fingernode_t** data) {
                     new_deep = make_deep_node(prefix, make_empty_node(), suffix);
                 }
             } else {               // Just append node to the prefix/suffix
-                promo_node->ref_counter++;
+                incr_ref(promo_node);
                 new_deep = make_deep_node(tree->left, pop_deeper, promo_node);
             }
         }
@@ -691,15 +713,15 @@ deep_t* pop(deep_t* tree, finger_data_t** data) {
         deep_t* new_deep = NULL;
         if (cur_node->arity > 1) { // Just chop from the suffix
             fingernode_t* new_suffix = copy_remove_tail(cur_node);
-            tree->left->ref_counter++;
-            tree->content.deeper->ref_counter++;
+            incr_ref(tree->left);
+            incr_ref(tree->content.deeper);
             new_deep = make_deep_node(tree->left, tree->content.deeper, new_suffix);
         } else if (cur_node->arity == 1) {                 // We recursive boyz
             fingernode_t* promo_node;
             deep_t* pop_deeper = pop_deep(tree->content.deeper, &promo_node);
             if (!pop_deeper) {                // We're splitting the prefix/suffix and making a deep->empty
                 if (tree->left->arity == 1) {
-                    tree->left->ref_counter++;
+                    incr_ref(tree->left);
                     new_deep = make_single_node(tree->left);
                 } else {
                     fingernode_t* prefix;
@@ -708,7 +730,7 @@ deep_t* pop(deep_t* tree, finger_data_t** data) {
                     new_deep = make_deep_node(prefix, make_empty_node(), suffix);
                 }
             } else {               // We're promoting the node lower node, so suffix should actually be empty rn
-                promo_node->ref_counter++;
+                incr_ref(promo_node);
                 new_deep = make_deep_node(tree->left, pop_deeper, promo_node);
             }
         }
@@ -741,6 +763,7 @@ int vector_size(deep_t* tree) {
  */
 finger_data_t* lookup_fingernodes(fingernode_t* node, int idx, int idx_cur) {
     finger_debug("lookup_fingernodes\n");
+    imc_count(visited, 1);
     if (node->node_type == DATA_NODE) {
         return node->content.data[idx_cur-idx];
     }
@@ -762,11 +785,13 @@ finger_data_t* lookup_fingernodes(fingernode_t* node, int idx, int idx_cur) {
  */
 finger_data_t* lookup(deep_t* tree, int idx) {
     finger_debug("lookup\n");
+    imc_count(lookups, 1);
     int i=0;
     fingernode_t* finger_cur;
     deep_list_t* stack = NULL;
     while (tree->deep_type == DEEP_NODE) {
         finger_debug("deep node\n");
+        imc_count(visited, 1);
         finger_cur = tree->left;
         if (i+finger_cur->lookup_idx >= idx) {
             return lookup_fingernodes(finger_cur, i, idx);
@@ -813,7 +838,7 @@ fingernode_t* update_fingernode(fingernode_t* node, int cur_idx, int idx, finger
                 res->content.children[i] = update_fingernode(res->content.children[i], cur_idx, idx, new_value);
                 for (int j=0; j<node->arity; j++) {
                     if (j != i) {
-                        res->content.children[i]->ref_counter++;
+                        incr_ref(res->content.children[i]);
                     }
                 }
                 break;
@@ -837,12 +862,12 @@ deep_t* update_up_to_depth (deep_t* tree, int depth, int cur_idx, int idx, side_
         }
         switch (side) {
         case FINGER_LEFT:
-            tree->right->ref_counter++;
-            tree->content.deeper->ref_counter++;
+            incr_ref(tree->right);
+            incr_ref(tree->content.deeper);
             return make_deep_node(update_fingernode(tree->left, cur_idx, idx, new_value), tree->content.deeper, tree->right);
         case FINGER_RIGHT:
-            tree->left->ref_counter++;
-            tree->content.deeper->ref_counter++;
+            incr_ref(tree->left);
+            incr_ref(tree->content.deeper);
             return make_deep_node(tree->left, tree->content.deeper, update_fingernode(tree->right, cur_idx, idx, new_value));
         default:
             return NULL;
@@ -852,8 +877,8 @@ deep_t* update_up_to_depth (deep_t* tree, int depth, int cur_idx, int idx, side_
     switch (tree->deep_type) {
     case DEEP_NODE:
         deeper = update_up_to_depth(tree->content.deeper, depth-1, cur_idx, idx, side, new_value);
-        tree->left->ref_counter++;
-        tree->right->ref_counter++;
+        incr_ref(tree->left);
+        incr_ref(tree->right);
         return make_deep_node(tree->left, deeper, tree->right);
     case SINGLE_NODE: // We've made a mistake if we're here or below.
     case EMPTY_NODE:
@@ -2,6 +2,12 @@
 #define _FINGER_TYPES_
 
 #include "tools.h"
+#include "imc_pool.h"
+#include "imc_stats.h"
+
+/* Allocator of the finger nodes and the deeps, the pool by default. It must be
+ * set before the first tree is created. */
+void finger_set_allocator(const imc_allocator_t* allocator);
 
 /* Finger node allocation and movement helpers */
 fingernode_t* make_fingernode(int arity, node_type_t type);
@@ -1,66 +1,46 @@
 #include "rrb_vector.h"
 
-rrb_t* make_meta_vector() {
+rrb_node_t* make_meta_leaf(int size, int* counter) {
     int *temp;
-    int counter = 0;
-
-    rrb_t* rrb0 = rrb_create();
-    for (int i = 0; i < 32; i++) {
-        temp = malloc(sizeof *temp);
-        *temp = counter++;
-        if (i % 3 == 0) {
-            rrb0 = rrb_push(rrb0, temp);
-        } else if (i % 3 == 1) {
-            rrb0 = rrb_push(rrb0, temp);
-        } else {
-            rrb0 = rrb_push(rrb0, temp);
-        }
-    }
 
-    rrb_t* rrb1 = rrb_create();
-    for (int i = 0; i < 10; i++) {
+    rrb_node_t* leaf = calloc(1, sizeof *leaf + 32 * sizeof *leaf->nodes);
+    leaf->level = 1;
+    leaf->ref = 1;
+    leaf->elements = size;
+    leaf->meta = NULL;
+    leaf->slots = 32;
+    leaf->full = size == 32;
+    for (int i = 0; i < size; i++) {
         temp = malloc(sizeof *temp);
-        *temp = counter++;
-        if (i % 3 == 0) {
-            rrb1 = rrb_push(rrb1, temp);
-        } else if (i % 3 == 1) {
-            rrb1 = rrb_push(rrb1, temp);
-        } else {
-            rrb1 = rrb_push(rrb1, temp);
-        }
+        *temp = (*counter)++;
+        leaf->nodes[i].leaf = temp;
     }
+    return leaf;
+}
 
-    rrb1->full = true;
+rrb_t* make_meta_vector() {
+    int counter = 0;
 
-    rrb_t* rrb2 = rrb_create();
-    for (int i = 0; i < 20; i++) {
-        temp = malloc(sizeof *temp);
-        *temp = counter++;
-        if (i % 3 == 0) {
-            rrb2 = rrb_push(rrb2, temp);
-        } else if (i % 3 == 1) {
-            rrb2 = rrb_push(rrb2, temp);
-        } else {
-            rrb2 = rrb_push(rrb2, temp);
-        }
-    }
+    rrb_node_t* rrb0 = make_meta_leaf(32, &counter);
+    rrb_node_t* rrb1 = make_meta_leaf(10, &counter);
+    rrb_node_t* rrb2 = make_meta_leaf(20, &counter);
 
-    rrb_t* rrb3 = malloc(sizeof *rrb3);
+    rrb_node_t* rrb3 = calloc(1, sizeof *rrb3 + 32 * (sizeof *rrb3->nodes + sizeof (int)));
     rrb3->level = 2;
     rrb3->ref = 1;
     rrb3->elements = 62;
-    rrb3->meta = calloc(32, sizeof *rrb3->meta);
+    rrb3->slots = 32;
+    rrb3->meta = (int*) &rrb3->nodes[32];
     rrb3->meta[0] = 32;
     rrb3->meta[1] = 42;
     rrb3->meta[2] = 62;
     rrb3->full = false;
-    rrb3->nodes.child = calloc(32, sizeof *rrb3->nodes.child);
-    rrb3->nodes.child[0] = rrb0;
-    rrb3->nodes.child[1] = rrb1;
-    rrb3->nodes.child[2] = rrb2;
+    rrb3->nodes[0].child = rrb0;
+    rrb3->nodes[1].child = rrb1;
+    rrb3->nodes[2].child = rrb2;
 
-    rrb1->ref = 2;
-    rrb2->ref = 2;
+    rrb_t* rrb4 = rrb_create();
+    rrb4->root = rrb3;
 
-    return rrb3;
+    return rrb4;
 }
@@ -6,47 +6,47 @@ void tabulation(int number, FILE* file) {
 }
 
 /** Dump the nodes into the dotfile. */
-void dump_nodes(rrb_t* rrb, FILE* file, int tab) {
+void dump_nodes(rrb_node_t* rrb, FILE* file, int tab) {
     tabulation(tab, file);
     fprintf(file, "node%p[label = \"", rrb);
     if (rrb->level == 1) {
-        for (int i = 0; i < 32; i++) {
-            if (rrb->nodes.leaf[i] != NULL) {
-                if (i == 0) fprintf(file, "<f%p> %d", rrb->nodes.leaf[i], i);
-                else fprintf(file, " | <f%p> %d", rrb->nodes.leaf[i], i);
+        for (int i = 0; i < rrb->slots; i++) {
+            if (rrb->nodes[i].leaf != NULL) {
+                if (i == 0) fprintf(file, "<f%p> %d", rrb->nodes[i].leaf, i);
+                else fprintf(file, " | <f%p> %d", rrb->nodes[i].leaf, i);
             }
         }
         fprintf(file, "\"];\n");
         return;
     }
-    for (int i = 0; i < 32; i++) {
-        if (rrb->nodes.child[i] != NULL) {
-            if (i == 0) fprintf(file, "<f%p> %d", rrb->nodes.child[i], i);
-            else fprintf(file, " | <f%p> %d", rrb->nodes.child[i], i);
+    for (int i = 0; i < rrb->slots; i++) {
+        if (rrb->nodes[i].child != NULL) {
+            if (i == 0) fprintf(file, "<f%p> %d", rrb->nodes[i].child, i);
+            else fprintf(file, " | <f%p> %d", rrb->nodes[i].child, i);
         }
     }
     fprintf(file, "\"];\n");
-    for (int i = 0; i < 32; i++) {
-        if (rrb->nodes.child[i] != NULL) {
-            dump_nodes(rrb->nodes.child[i], file, tab);
+    for (int i = 0; i < rrb->slots; i++) {
+        if (rrb->nodes[i].child != NULL) {
+            dump_nodes(rrb->nodes[i].child, file, tab);
         }
     }
 }
 
 /** Dump the edges into the dotfile. */
-void dump_edges(rrb_t* rrb, FILE* file, int tab) {
+void dump_edges(rrb_node_t* rrb, FILE* file, int tab) {
     tabulation(tab, file);
     if (rrb->level == 1) {
         return;
     }
-    for (int i = 0; i < 32; i++) {
-        if (rrb->nodes.child[i] != NULL) {
-            fprintf(file, "\"node%p\":f%p -> \"node%p\";\n", rrb, rrb->nodes.child[i], rrb->nodes.child[i]);
+    for (int i = 0; i < rrb->slots; i++) {
+        if (rrb->nodes[i].child != NULL) {
+            fprintf(file, "\"node%p\":f%p -> \"node%p\";\n", rrb, rrb->nodes[i].child, rrb->nodes[i].child);
         }
     }
-    for (int i = 0; i < 32; i++) {
-        if (rrb->nodes.child[i] != NULL) {
-            dump_edges(rrb->nodes.child[i], file, tab);
+    for (int i = 0; i < rrb->slots; i++) {
+        if (rrb->nodes[i].child != NULL) {
+            dump_edges(rrb->nodes[i].child, file, tab);
         }
     }
 }
@@ -61,32 +61,34 @@ void rrb_to_dotfile(rrb_t* rrb, char* path) {
         fprintf(file, "digraph rrbtree {\n");
         tabulation(2, file);
         fprintf(file, "node [shape = record, height = 0.1];\n");
-        dump_nodes(rrb, file, 2);
+        if (rrb->root != NULL) {
+            dump_nodes(rrb->root, file, 2);
+        }
         fprintf(file, "}\n");
         fclose(file);
     }
 }
 
 /** Pretty print the structure into the file. */
-void pp(const rrb_t* rrb, int tab, FILE* file) {
+void pp(const rrb_node_t* rrb, int tab, FILE* file) {
     if (rrb != NULL) {
         if (rrb->level == 1) {
             tabulation(tab, file);
             fprintf(file, "Node {\n");
-            for (int i = 0; i < 32; i++) {
-                if (rrb->nodes.leaf[i] != NULL) {
+            for (int i = 0; i < rrb->slots; i++) {
+                if (rrb->nodes[i].leaf != NULL) {
                     tabulation(tab + 2, file);
-                    fprintf(file, "Leaf : %d\n", *rrb->nodes.leaf[i]);
+                    fprintf(file, "Leaf : %d\n", *rrb->nodes[i].leaf);
                 }
             }
             tabulation(tab, file);
             fprintf(file, "}\n");
         } else {
-            for (int i = 0; i < 32; i++) {
-                if (rrb->nodes.child[i] != NULL) {
+            for (int i = 0; i < rrb->slots; i++) {
+                if (rrb->nodes[i].child != NULL) {
                     tabulation(tab, file);
                     fprintf(file, "Node {\n");
-                    pp(rrb->nodes.child[i], tab + 2, file);
+                    pp(rrb->nodes[i].child, tab + 2, file);
                     tabulation(tab, file);
                     fprintf(file, "}\n");
                 }
@@ -95,9 +97,31 @@ void pp(const rrb_t* rrb, int tab, FILE* file) {
     }
 }
 
+/** Pretty print the tail of the vector into the file. */
+void pp_tail(const rrb_t* rrb, bool pointers, FILE* file) {
+    if (rrb->tail_size == 0) {
+        return;
+    }
+    fprintf(file, "Tail {\n");
+    if (pointers == true) {
+        tabulation(2, file);
+        fprintf(file, "Size : %d\n", rrb->tail_size);
+    }
+    for (int i = 0; i < rrb->tail_size; i++) {
+        tabulation(2, file);
+        if (pointers == true) {
+            fprintf(file, "%d: Leaf -> %d\n", i, *rrb->tail[i]);
+        } else {
+            fprintf(file, "Leaf : %d\n", *rrb->tail[i]);
+        }
+    }
+    fprintf(file, "}\n");
+}
+
 /** Pretty print the structure into the stdout. */
 void rrb_pp(const rrb_t* rrb) {
-    pp(rrb, 0, stdout);
+    pp(rrb->root, 0, stdout);
+    pp_tail(rrb, false, stdout);
 }
 
 /** Pretty print the structure into the file indicated by path. */
@@ -107,42 +131,43 @@ void rrb_pp_file(const rrb_t* rrb, char* path) {
         fprintf(stderr, "Unable to open file %s\n", path);
         exit(EXIT_FAILURE);
     } else {
-        pp(rrb, 0, file);
+        pp(rrb->root, 0, file);
+        pp_tail(rrb, false, file);
         fclose(file);
     }
 }
 
 /** Pretty print the structure with pointers to the file, w/ or w/o leafs. */
-void ppp(const rrb_t* rrb, int tab, bool leafs, FILE* file) {
+void ppp(const rrb_node_t* rrb, int tab, bool leafs, FILE* file) {
     if (rrb != NULL) {
         if (rrb->level == 1) {
             tabulation(tab, file);
             fprintf(file, "Node %p { ", rrb);
             if (leafs == false) {
-                fprintf(file, "Size : %zu, ", rrb_size(rrb));
+                fprintf(file, "Size : %zu, ", (size_t) rrb->elements);
                 fprintf(file, "Level : %d }\n", rrb->level);
                 return;
             }
             fprintf(file, "\n");
             tabulation(tab + 2, file);
-            fprintf(file, "Size : %zu\n", rrb_size(rrb));
+            fprintf(file, "Size : %zu\n", (size_t) rrb->elements);
             tabulation(tab + 2, file);
             fprintf(file, "Level : %d\n", rrb->level);
             if (rrb->meta != NULL) {
                 tabulation(tab + 2, file);
                 fprintf(file, "Meta : [");
-                for (int i = 0; i < 32; i++) {
-                    if (i < 31) {
+                for (int i = 0; i < rrb->slots; i++) {
+                    if (i < rrb->slots - 1) {
                         fprintf(file, "%d, ", rrb->meta[i]);
                     } else {
                         fprintf(file, "%d]\n", rrb->meta[i]);
                     }
                 }
             }
-            for (int i = 0; i < 32; i++) {
-                if (rrb->nodes.leaf[i] != NULL) {
+            for (int i = 0; i < rrb->slots; i++) {
+                if (rrb->nodes[i].leaf != NULL) {
                     tabulation(tab + 2, file);
-                    fprintf(file, "%d: Leaf -> %d\n", i, *rrb->nodes.leaf[i]);
+                    fprintf(file, "%d: Leaf -> %d\n", i, *rrb->nodes[i].leaf);
                 }
             }
             tabulation(tab, file);
@@ -151,23 +176,23 @@ void ppp(const rrb_t* rrb, int tab, bool leafs, FILE* file) {
             tabulation(tab, file);
             fprintf(file, "Node %p {\n", rrb);
             tabulation(tab + 2, file);
-            fprintf(file, "Size : %zu\n", rrb_size(rrb));
+            fprintf(file, "Size : %zu\n", (size_t) rrb->elements);
             tabulation(tab + 2, file);
             fprintf(file, "Level : %d\n", rrb->level);
             if (rrb->meta != NULL) {
                 tabulation(tab + 2, file);
                 fprintf(file, "Meta : [");
-                for (int i = 0; i < 32; i++) {
-                    if (i < 31) {
+                for (int i = 0; i < rrb->slots; i++) {
+                    if (i < rrb->slots - 1) {
                         fprintf(file, "%d, ", rrb->meta[i]);
                     } else {
                         fprintf(file, "%d]\n", rrb->meta[i]);
                     }
                 }
             }
-            for (int i = 0; i < 32; i++) {
-                if (rrb->nodes.child[i] != NULL) {
-                    ppp(rrb->nodes.child[i], tab + 2, leafs, file);
+            for (int i = 0; i < rrb->slots; i++) {
+                if (rrb->nodes[i].child != NULL) {
+                    ppp(rrb->nodes[i].child, tab + 2, leafs, file);
                 }
             }
             tabulation(tab, stdout);
@@ -178,12 +203,13 @@ void ppp(const rrb_t* rrb, int tab, bool leafs, FILE* file) {
 
 /** Pretty print the structure with pointers to the console. */
 void rrb_ppp(const rrb_t* rrb) {
-    ppp(rrb, 0, false, stdout);
+    ppp(rrb->root, 0, false, stdout);
 }
 
 /** Pretty print the structure with pointers and leafs to the console. */
 void rrb_ppp_leafs(const rrb_t* rrb) {
-    ppp(rrb, 0, true, stdout);
+    ppp(rrb->root, 0, true, stdout);
+    pp_tail(rrb, true, stdout);
 }
 
 /** Pretty print the structure with pointers to the file indicated by path. */
@@ -193,7 +219,7 @@ void rrb_ppp_file(const rrb_t* rrb, char* path) {
         fprintf(stderr, "Unable to open file %s\n", path);
         exit(EXIT_FAILURE);
     } else {
-        ppp(rrb, 0, false, file);
+        ppp(rrb->root, 0, false, file);
         fclose(file);
     }
 }
@@ -204,7 +230,8 @@ void rrb_ppp_leafs_file(const rrb_t* rrb, char* path) {
         fprintf(stderr, "Unable to open file %s\n", path);
         exit(EXIT_FAILURE);
     } else {
-        ppp(rrb, 0, true, file);
+        ppp(rrb->root, 0, true, file);
+        pp_tail(rrb, true, file);
         fclose(file);
     }
 }
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <getopt.h>
+
+#include "rrb_vector.h"
+
+#ifndef RRB_THREAD_SAFE
+#error "rrb_stress shares versions between threads, build it with RRB_THREAD_SAFE."
+#endif
+
+/** What each thread works on: the shared version, and its own datas. */
+typedef struct _stress {
+    const rrb_t* shared;   // The version shared by every thread.
+    int iterations;        // Number of rounds of each thread.
+    int* datas;            // Datas pushed and updated by the thread.
+    int errors;            // Number of wrong elements found.
+} stress_t;
+
+/** Pushes and updates from the shared version, checks the result and the
+  * shared version, then drops the new versions. */
+void* stress_thread(void* arg) {
+    stress_t* stress = arg;
+    size_t size = rrb_size(stress->shared);
+    unsigned int seed = (unsigned int) (size_t) stress;
+    for (int i = 0; i < stress->iterations; i++) {
+        int index = rand_r(&seed) % size;
+        rrb_t* pushed  = rrb_push((rrb_t*) stress->shared, &stress->datas[i % 64]);
+        rrb_t* updated = rrb_update(pushed, index, &stress->datas[(i + 1) % 64]);
+        if (rrb_lookup(updated, index) != &stress->datas[(i + 1) % 64] ||
+            rrb_lookup(updated, size) != &stress->datas[i % 64] ||
+            *rrb_lookup(stress->shared, index) != index) {
+            stress->errors += 1;
+        }
+        rrb_unref(pushed);
+        rrb_unref(updated);
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[]) {
+    int threads = 4, iterations = 100000, size = 100000;
+
+    struct option long_options[] = {
+        { "threads",    required_argument, NULL, 't' },
+        { "iterations", required_argument, NULL, 'i' },
+        { "size",       required_argument, NULL, 's' },
+        { NULL, 0, NULL, 0 } };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "t:i:s:", long_options, NULL)) != -1) {
+        switch (c) {
+            case 't':
+            threads = atoi(optarg);
+            break;
+            case 'i':
+            iterations = atoi(optarg);
+            break;
+            case 's':
+            size = atoi(optarg);
+            break;
+            default:
+            fprintf(stderr, "Unknown option %c. Aborting.\n", c);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int* datas = malloc(size * sizeof *datas);
+    imc_data_t** items = malloc(size * sizeof *items);
+    for (int i = 0; i < size; i++) {
+        datas[i] = i;
+        items[i] = &datas[i];
+    }
+    rrb_t* shared = rrb_from_array(items, size);
+
+    pthread_t* ids = malloc(threads * sizeof *ids);
+    stress_t* stresses = malloc(threads * sizeof *stresses);
+    struct timeval t1, t2;
+    gettimeofday(&t1, NULL);
+    for (int i = 0; i < threads; i++) {
+        stresses[i] = (stress_t) { shared, iterations, malloc(64 * sizeof (int)), 0 };
+        pthread_create(&ids[i], NULL, stress_thread, &stresses[i]);
+    }
+    int errors = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+        errors += stresses[i].errors;
+        free(stresses[i].datas);
+    }
+    gettimeofday(&t2, NULL);
+
+    // The shared version must be untouched.
+    for (int i = 0; i < size; i++) {
+        errors += *rrb_lookup(shared, i) != i;
+    }
+    rrb_unref(shared);
+
+    double elapsed_time = (t2.tv_sec - t1.tv_sec) * 1000.0;
+    elapsed_time += (t2.tv_usec - t1.tv_usec) / 1000.0;
+    printf("Threads: %d, push + update per thread: %d\n", threads, iterations);
+    printf("Time elapsed: %.3fms\n", elapsed_time);
+    printf("Errors: %d\n", errors);
+
+    free(stresses);
+    free(ids);
+    free(items);
+    free(datas);
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
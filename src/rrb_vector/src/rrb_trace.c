@@ -0,0 +1,63 @@
+#include <string.h>
+
+#include "rrb_trace.h"
+
+#ifdef RRB_TRACE
+
+/** Ring buffer of the current thread: the next event overwrites the oldest
+  * one once it is full. */
+static __thread rrb_trace_event_t ring[RRB_TRACE_SIZE];
+static __thread size_t recorded = 0;
+
+/** Writes an event at the head of the ring. */
+void rrb_trace_record(const char* op, int level, const void* node, int copies) {
+    ring[recorded++ % RRB_TRACE_SIZE] = (rrb_trace_event_t) { op, level, node, copies };
+}
+
+/** Copies the events from the oldest kept. */
+size_t rrb_trace_events(rrb_trace_event_t* events, size_t max) {
+    size_t size = recorded < RRB_TRACE_SIZE ? recorded : RRB_TRACE_SIZE;
+    size_t first = recorded - size;
+    if (size > max) {
+        first += size - max;
+        size = max;
+    }
+    for (size_t i = 0; i < size; i++) {
+        events[i] = ring[(first + i) % RRB_TRACE_SIZE];
+    }
+    return size;
+}
+
+/** Prints the events, without the end of line of the steps. */
+void rrb_trace_dump(FILE* out) {
+    size_t size = recorded < RRB_TRACE_SIZE ? recorded : RRB_TRACE_SIZE;
+    for (size_t i = recorded - size; i < recorded; i++) {
+        const rrb_trace_event_t* event = &ring[i % RRB_TRACE_SIZE];
+        int length = (int) strcspn(event->op, "\n");
+        fprintf(out, "%.*s level=%d node=%p copies=%d\n", length, event->op,
+            event->level, event->node, event->copies);
+    }
+}
+
+/** Empties the ring. */
+void rrb_trace_clear(void) {
+    recorded = 0;
+}
+
+#else
+
+/** Nothing is recorded without RRB_TRACE. */
+size_t rrb_trace_events(rrb_trace_event_t* events, size_t max) {
+    (void) events;
+    (void) max;
+    return 0;
+}
+
+void rrb_trace_dump(FILE* out) {
+    (void) out;
+}
+
+void rrb_trace_clear(void) {
+}
+
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Tracing of the RRB-Vector. Built with RRB_TRACE (make TRACE=1), each thread
+ * records its last RRB_TRACE_SIZE events in a ring buffer. Built without, the
+ * trace points are compiled out, and the trace is always empty.
+ */
+#define RRB_TRACE_SIZE 4096
+
+/** An event of the trace: a step of an operation, on a node. */
+typedef struct _rrb_trace_event {
+    const char* op;      // The step, a string literal.
+    int level;           // Level of the node, 0 if none.
+    const void* node;    // The node, NULL if none.
+    int copies;          // Number of nodes copied by the step.
+} rrb_trace_event_t;
+
+#ifdef RRB_TRACE
+void rrb_trace_record(const char* op, int level, const void* node, int copies);
+#define rrb_trace(op, level, node, copies) rrb_trace_record(op, level, node, copies)
+#else
+#define rrb_trace(op, level, node, copies) ((void) 0)
+#endif
+
+/**
+ * Copies the events of the current thread, oldest first.
+ * @param  events The array to fill.
+ * @param  max    The size of the array.
+ * @return        The number of events copied.
+ */
+size_t rrb_trace_events(rrb_trace_event_t* events, size_t max);
+
+/**
+ * Prints the events of the current thread, oldest first, one per line.
+ * @param  out The stream to print to.
+ */
+void rrb_trace_dump(FILE* out);
+
+/**
+ * Forgets the events of the current thread.
+ */
+void rrb_trace_clear(void);
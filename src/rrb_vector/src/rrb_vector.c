@@ -1,293 +1,331 @@
+#include <string.h>
+
 #include "rrb_vector.h"
 
-#define DEBUG 0
+/* Number of elements under which a subtree is not split between tasks. */
+#define PARALLEL_GRAIN 32768
 
 /* Functions used before defintions. */
-rrb_t* add_leaf(rrb_t* rrb, imc_data_t* data, int where);
-rrb_t* add_node(rrb_t* rrb, imc_data_t* data, bool meta);
-rrb_t* update_leaf(rrb_t* rrb, int  where, imc_data_t* data);
-rrb_t* update_node(rrb_t* rrb, int* index, imc_data_t* data, bool meta);
-rrb_t* pop_node(rrb_t* rrb, imc_data_t** data, int* index, bool meta);
-rrb_t* pop_data(rrb_t* rrb, imc_data_t** data, int* index, bool meta);
-int split_leaf(const rrb_t* rrb, rrb_t** left, rrb_t** right, int* index, bool meta);
-int split_node(const rrb_t* rrb, rrb_t** left, rrb_t** right, int* index, bool meta);
-void consolidate_tree(rrb_t** rrb, bool top);
+rrb_node_t* update_leaf(rrb_node_t* rrb, int  where, imc_data_t* data);
+rrb_node_t* update_node(rrb_node_t* rrb, int* index, imc_data_t* data);
+int find_last_index(const rrb_node_t* rrb);
+
+/* Allocator of the nodes and the heads. */
+const imc_allocator_t* allocator = &imc_pool_allocator;
 
-/** Creates an empty array of nodes into rrb. */
-void make_nodes(rrb_t* rrb) {
-    debug_print("make_nodes, beginning\n");
-    rrb->nodes.child = calloc(32, sizeof *rrb->nodes.child);
-    debug_print("make_nodes, end\n");
+/** Sets the allocator. */
+void rrb_set_allocator(const imc_allocator_t* new_allocator) {
+    allocator = new_allocator;
 }
 
-/** Creates an empty array of leafs into rrb. */
-void make_datas(rrb_t* rrb) {
-    debug_print("make_datas, beginning\n");
-    rrb->nodes.leaf = calloc(32, sizeof *rrb->nodes.leaf);
-    debug_print("make_datas, end\n");
+/** Computes the size of the block of a node. */
+size_t node_bytes(int slots, bool meta) {
+    size_t size = sizeof(rrb_node_t) + slots * sizeof *((rrb_node_t*) 0)->nodes;
+    if (meta == true) {
+        size += slots * sizeof (int);
+    }
+    return size;
 }
 
-int* make_meta() {
-    return calloc(32, sizeof (int* ));
+/** Allocates a block in the arena of the scope if any, else with the
+  * allocator. */
+void* alloc_block(size_t size) {
+    imc_count(allocs, 1);
+    imc_count(bytes, size);
+    return imc_arena_scope != NULL ? imc_arena_alloc(imc_arena_scope, size)
+                                   : allocator->alloc(size);
 }
 
-/** Creates an empty RRB-Tree. Top is used in order to determine if it contains
-* leafs or RRB-Nodes. */
-rrb_t* create(bool top) {
-    debug_print("create, beginning\n");
-    rrb_t* rrb = malloc(sizeof *rrb);
-    rrb->ref = 1;
-    rrb->level = 1;
+/** Frees a block, unless in a scope, where nothing is freed. */
+void free_block(void* block, size_t size) {
+    if (imc_arena_scope == NULL) {
+        allocator->free(block, size);
+    }
+}
+
+/** Allocates a node in a single block, able to contain slots children or
+  * leafs, and a meta if needed. Nodes of arenas are not counted, and have
+  * no reference. */
+rrb_node_t* alloc_node(int level, int slots, bool meta) {
+    rrb_node_t* rrb = alloc_block(node_bytes(slots, meta));
+    rrb->ref = imc_arena_scope != NULL ? 0 : 1;
+    rrb->owner = 0;
+    rrb->level = level;
     rrb->full = false;
-    rrb->meta = NULL;
     rrb->elements = 0;
-    if (top == true) {
-        make_nodes(rrb);
-    } else {
-        make_datas(rrb);
-    }
-    debug_print("create, end\n");
+    rrb->slots = slots;
+    rrb->meta_room = meta;
+    rrb->meta = meta == true ? (int*) &rrb->nodes[slots] : NULL;
+    memset(rrb->nodes, 0, slots * sizeof *rrb->nodes);
+    rrb_trace("alloc_node", level, rrb, 0);
     return rrb;
 }
 
+/** Creates an empty RRB-Tree. Top is used in order to determine if it contains
+* leafs or RRB-Nodes. */
+rrb_node_t* create(bool top) {
+    return alloc_node(top == true ? 2 : 1, 32, false);
+}
+
 /** Creates a RRB-Tree with datas. */
-rrb_t* create_w_leafs() {
-    debug_print("create_w_leafs\n");
+rrb_node_t* create_w_leafs() {
     return create(false);
 }
 
 /** Creates a RRB-Tree with nodes. */
-rrb_t* create_w_nodes() {
-    debug_print("create_w_nodes\n");
+rrb_node_t* create_w_nodes() {
     return create(true);
 }
 
 /** Checks if rrb contains data. */
-bool contains_leafs(const rrb_t* rrb) {
-    debug_print("contains_leafs\n");
+bool contains_leafs(const rrb_node_t* rrb) {
     return rrb->level == 1;
 }
 
 /** Checks if rrb contains nodes. */
-bool contains_nodes(const rrb_t* rrb) {
-    debug_print("contains_nodes\n");
+bool contains_nodes(const rrb_node_t* rrb) {
     return rrb->level > 1;
 }
 
+/** Creates a version of a vector around a tree, with room for slots
+  * elements in its tail. */
+rrb_t* create_head(rrb_node_t* root, int slots) {
+    rrb_t* rrb = alloc_block(sizeof *rrb + slots * sizeof *rrb->tail);
+    rrb->root = root;
+    rrb->tail_size = 0;
+    rrb->tail_slots = slots;
+    return rrb;
+}
+
 /** Creates an empty RRB-Vector. */
 rrb_t* rrb_create() {
-    debug_print("rrb_create\n");
-    return create_w_leafs();
+    return create_head(NULL, 0);
 }
 
-/** Frees a RRB-Tree. */
-void free_rrb(rrb_t* rrb) {
-    debug_print("free_rrb, beginning\n");
-    if (rrb->meta != NULL) {
-        free(rrb->meta);
-    }
-    if (contains_leafs(rrb)) {
-        free(rrb->nodes.leaf);
-    } else {
-        free(rrb->nodes.child);
-    }
-    free(rrb);
-    debug_print("free_rrb, end\n");
+/** Frees a RRB-Tree. Children, leafs and meta are in the same block. */
+void free_rrb(rrb_node_t* rrb) {
+    rrb_trace("free_rrb", rrb->level, rrb, 0);
+    free_block(rrb, node_bytes(rrb->slots, rrb->meta_room));
 }
 
-/** Increases references to the tree. */
-rrb_t* inc_ref(rrb_t* rrb) {
-    debug_print("inc_ref, beginning\n");
+/** Frees a version of a vector, without its tree. */
+void free_head(rrb_t* rrb) {
+    free_block(rrb, sizeof *rrb + rrb->tail_slots * sizeof *rrb->tail);
+}
+
+/** Increases references to the tree. Taking a reference needs no ordering,
+  * as the caller already holds one. Nothing is counted in a scope. */
+rrb_node_t* inc_ref(rrb_node_t* rrb) {
+    if (imc_arena_scope != NULL) {
+        return rrb;
+    }
+    imc_count(incs, 1);
+#ifdef RRB_THREAD_SAFE
+    atomic_fetch_add_explicit(&rrb->ref, 1, memory_order_relaxed);
+#else
     rrb->ref += 1;
-    debug_print("inc_ref, end\n");
+#endif
     return rrb;
 }
 
-/** Decreases references to the tree. */
-void dec_ref(rrb_t* rrb) {
-    debug_print("dec_ref, beginning\n");
+/** Drops a reference, and tells if it was the last one. The release makes
+  * the uses of the node by this thread happen before its free, the acquire
+  * makes the uses by the other threads happen before it too. */
+bool release_ref(rrb_node_t* rrb) {
+    imc_count(decs, 1);
+#ifdef RRB_THREAD_SAFE
+    if (atomic_fetch_sub_explicit(&rrb->ref, 1, memory_order_release) == 1) {
+        atomic_thread_fence(memory_order_acquire);
+        return true;
+    }
+    return false;
+#else
     rrb->ref -= 1;
-    if (rrb->ref == 0) {
-        if (contains_nodes(rrb)) {
-            for (int i = 0; i < 32; i++) {
-                if (rrb->nodes.child[i] != NULL) {
-                    dec_ref(rrb->nodes.child[i]);
-                }
+    return rrb->ref == 0;
+#endif
+}
+
+/** Frees a node left unreferenced, and hands its children left unreferenced
+  * to the reclaimer, which frees them from its worklist instead of
+  * recursing. */
+void reclaim_node(void* node) {
+    rrb_node_t* rrb = node;
+    if (contains_nodes(rrb)) {
+        for (int i = 0; i < rrb->slots; i++) {
+            rrb_node_t* child = rrb->nodes[i].child;
+            if (child != NULL && release_ref(child) == true) {
+                imc_reclaim(child, reclaim_node);
             }
         }
-        free_rrb(rrb);
     }
-    debug_print("dec_ref, end\n");
+    free_rrb(rrb);
+}
+
+/** Decreases references to the tree. The nodes left unreferenced are freed
+  * according to the mode of the reclaimer. Nothing is counted in a scope. */
+void dec_ref(rrb_node_t* rrb) {
+    if (imc_arena_scope == NULL && release_ref(rrb) == true) {
+        imc_reclaim(rrb, reclaim_node);
+    }
 }
 
 /** Checks if a RRB-Tree is full. */
-bool is_full(const rrb_t* rrb) {
-    debug_print("is_full\n");
+bool is_full(const rrb_node_t* rrb) {
     return rrb->full == true;
 }
 
 /** Easily clone the informations. */
-void clone_info(rrb_t* clone, const rrb_t* src) {
-    debug_print("clone_info, beginning\n");
+void clone_info(rrb_node_t* clone, const rrb_node_t* src) {
     clone->full = src->full;
     clone->level = src->level;
     clone->elements = src->elements;
-    debug_print("clone_info, end\n");
 }
 
 /** Easily clone the meta section. */
-void clone_meta(rrb_t* clone, const rrb_t* src) {
-    debug_print("clone_meta, beginning\n");
+void clone_meta(rrb_node_t* clone, const rrb_node_t* src) {
     if (src->meta != NULL) {
-        clone->meta = malloc(sizeof *clone->meta * 32);
-        for (int i = 0; i < 32; i++) {
-            clone->meta[i] = src->meta[i];
+        for (int i = 0; i < clone->slots; i++) {
+            clone->meta[i] = i < src->slots ? src->meta[i] : 0;
         }
-    } else {
-        clone->meta = NULL;
     }
-    debug_print("clone_meta, end\n");
 }
 
 /** Easily clone the nodes section. */
-void clone_nodes(rrb_t* clone, const rrb_t* src) {
-    debug_print("clone_nodes, beginning\n");
-    if (contains_leafs(src)) {
-        clone->nodes.leaf = malloc(sizeof *clone->nodes.leaf * 32);
-        for (int i = 0; i < 32; i++) {
-            clone->nodes.leaf[i] = src->nodes.leaf[i];
-        }
-    } else {
-        clone->nodes.child = malloc(sizeof *clone->nodes.child * 32);
-        for (int i = 0; i < 32; i++) {
-            clone->nodes.child[i] = src->nodes.child[i];
-            if (clone->nodes.child[i] != NULL) {
-                inc_ref(clone->nodes.child[i]);
+void clone_nodes(rrb_node_t* clone, const rrb_node_t* src) {
+    int slots = src->slots < clone->slots ? src->slots : clone->slots;
+    memcpy(clone->nodes, src->nodes, slots * sizeof *src->nodes);
+    if (contains_nodes(src)) {
+        for (int i = 0; i < slots; i++) {
+            if (clone->nodes[i].child != NULL) {
+                inc_ref(clone->nodes[i].child);
             }
         }
     }
-    debug_print("clone_nodes, end\n");
 }
 
-/** Copies the node as is. */
-rrb_t* copy_node(const rrb_t* src) {
-    debug_print("copy_node, beginning\n");
-    rrb_t* clone = malloc(sizeof *clone);
-    clone->ref = 1;
+/** Copies the node into a node of the given number of slots. */
+rrb_node_t* copy_resized(const rrb_node_t* src, int slots) {
+    rrb_node_t* clone = alloc_node(src->level, slots, src->meta != NULL);
     clone_info(clone, src);
     clone_meta(clone, src);
     clone_nodes(clone, src);
-    debug_print("copy_node, end\n");
+    rrb_trace("copy_resized", clone->level, clone, 1);
+    imc_count(copies, 1);
     return clone;
 }
 
-/** Inserts the data at the desired level. */
-rrb_t* create_child(int level, imc_data_t* data) {
-    debug_print("create_level, beginning\n");
-    if (level == 1) {
-        rrb_t* rrb = create_w_leafs();
-        rrb->nodes.leaf[0] = data;
-        rrb->elements = 1;
-        rrb->level = level;
-        debug_print("create_level, end\n");
-        return rrb;
-    } else {
-        rrb_t* rrb = create_w_nodes();
-        rrb->nodes.child[0] = create_child(level - 1, data);
-        rrb->elements = 1;
-        rrb->level = level;
-        debug_print("create_level, end\n");
-        return rrb;
+/** Copies the version of a vector: the tree is shared, the tail copied. The
+  * new tail has room for extra more elements. */
+rrb_t* clone_head(const rrb_t* src, int extra) {
+    rrb_t* clone = create_head(src->root, src->tail_size + extra);
+    if (clone->root != NULL) {
+        inc_ref(clone->root);
     }
+    clone->tail_size = src->tail_size;
+    memcpy(clone->tail, src->tail, src->tail_size * sizeof *src->tail);
+    return clone;
 }
 
-/** Adds a node, parent of the tree, and insert
-  * the data at the correct level. */
-rrb_t* add_as_parent_to(rrb_t* child, imc_data_t* data) {
-    debug_print("add_as_parent_to, beginning\n");
-    rrb_t* parent = create_w_nodes();
-    parent->level = child->level + 1;
-    parent->nodes.child[0] = inc_ref(child);
-    parent->nodes.child[1] = create_child(child->level, data);
-    parent->elements = rrb_size(child) + 1;
-    if (contains_nodes(child) && child->meta != NULL) {
-        parent->meta = malloc(sizeof *parent->meta * 32);
-        parent->meta[0] = rrb_size(child);
-        parent->meta[1] = rrb_size(child) + 1;
-    }
-    debug_print("add_as_parent_to, end\n");
-    return parent;
+/** Gets the number of elements in a node, 0 if there is no node. */
+size_t node_size(const rrb_node_t* rrb) {
+    return rrb == NULL ? 0 : (size_t) rrb->elements;
 }
 
-/** Calc the position according to the formula of research paper. */
-int calc_position(int index, int level) {
-    debug_print("calc_position\n");
-    return (index >> (5 * (level - 1))) & 31;
+/** Calculus the number of elements a node can hold at its level. */
+size_t node_capacity(int level) {
+    return (size_t) 1 << (5 * level);
 }
 
-/** Finds the correct place to insert the new data. */
-int place_to_insert(const rrb_t* rrb, bool meta) {
-    debug_print("place_to_insert, beginning\n");
-    if (rrb->meta == NULL || meta == false) {
-        return calc_position(rrb->elements, rrb->level);
+/** Drops the meta of a node if every child but the last is full and not
+  * relaxed, else computes it from the sizes of the children. The node is
+  * moved in a bigger block if it has no room for a meta. */
+rrb_node_t* refresh_meta(rrb_node_t* rrb) {
+    int last = find_last_index(rrb);
+    bool relaxed = false;
+    for (int i = 0; i <= last && relaxed == false; i++) {
+        const rrb_node_t* child = rrb->nodes[i].child;
+        relaxed = child->meta != NULL || (i < last &&
+            node_size(child) != node_capacity(child->level));
     }
 
-    for (int i = 0; i < 32; i++) {
-        if (contains_nodes(rrb)) {
-            if (rrb->nodes.child[i] == NULL || !is_full(rrb->nodes.child[i])) {
-                debug_print("place_to_insert, leafs\n");
-                return i;
-            }
-        } else {
-            if (rrb->nodes.leaf[i] == NULL) {
-                debug_print("place_to_insert, node\n");
-                return i;
-            }
+    if (relaxed == false) {
+        rrb->meta = NULL;
+    } else {
+        if (rrb->meta == NULL && rrb->meta_room == true) {
+            rrb->meta = (int*) &rrb->nodes[rrb->slots];
+        } else if (rrb->meta == NULL) {
+            rrb_node_t* moved = alloc_node(rrb->level, rrb->slots, true);
+            clone_info(moved, rrb);
+            moved->owner = rrb->owner;
+            memcpy(moved->nodes, rrb->nodes, rrb->slots * sizeof *rrb->nodes);
+            rrb_trace("refresh_meta, moved", moved->level, moved, 1);
+            free_rrb(rrb);
+            rrb = moved;
+        }
+        for (int i = 0, sum = 0; i < rrb->slots; i++) {
+            sum += node_size(rrb->nodes[i].child);
+            rrb->meta[i] = i <= last ? sum : 0;
         }
     }
+    return rrb;
+}
 
-    debug_print("place_to_insert, default case\n");
-    return -1;
+/** Sets the full flag of a node: a node is full when no leaf can be
+  * appended to it anymore. */
+void refresh_full(rrb_node_t* rrb) {
+    const rrb_node_t* last = rrb->slots == 32 ? rrb->nodes[31].child : NULL;
+    rrb->full = last != NULL && (contains_leafs(last) || is_full(last));
 }
 
-/** Adjusts the index in case of existing meta. */
-int check_meta_index(const rrb_t* rrb, int* index) {
-    debug_print("check_meta_index, beginning\n");
-    debug_args("check_meta_index, index: %d\n", *index);
-    for (int i = 0; i < 32; i++) {
-        if (contains_nodes(rrb)) {
-            if ((unsigned int) (*index) < rrb_size(rrb->nodes.child[i])) {
-                return i;
-            } else {
-                *index -= rrb_size(rrb->nodes.child[i]);
-            }
+/** Calc the position according to the formula of research paper. */
+int calc_position(int index, int level) {
+    return (index >> (5 * (level - 1))) & 31;
+}
+
+/** Finds the child containing index with a binary search in the meta, and
+  * makes index relative to that child. The child can't be before the one
+  * computed by the radix, as no child holds more than its capacity. */
+int check_meta_index(const rrb_node_t* rrb, int* index) {
+    int low  = calc_position(*index, rrb->level);
+    int high = rrb->slots - 1;
+    low = low < high ? low : high;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        // Unused slots have a zero meta, and are after the searched child.
+        if (rrb->meta[middle] > *index || rrb->meta[middle] == 0) {
+            high = middle;
         } else {
-            if (*index == 0) {
-                return i;
-            } else {
-                *index -= 1;
-            }
+            low = middle + 1;
         }
     }
-    return -1;
+    if (low > 0) {
+        *index -= rrb->meta[low - 1];
+    }
+    return low;
 }
 
 /** Gets the index needed to look at the right level. */
-int place_to_look(const rrb_t* rrb, int* index, bool meta) {
-    debug_print("place_to_look, beginning\n");
-    if (rrb->meta != NULL || meta == true) {
-        debug_print("place_to_look, check_meta_index\n");
+int place_to_look(const rrb_node_t* rrb, int* index) {
+    if (rrb->meta != NULL) {
         return check_meta_index(rrb, index);
     } else {
-        debug_print("place_to_look, meta null\n");
         return calc_position(*index, rrb->level);
     }
 }
 
+/** Gets the child containing index, and makes index relative to it even if
+  * the node is not relaxed. */
+int place_in_child(const rrb_node_t* rrb, int* index) {
+    int where = place_to_look(rrb, index);
+    if (rrb->meta == NULL) {
+        *index &= node_capacity(rrb->level - 1) - 1;
+    }
+    return where;
+}
+
 /** Copies if the node exists, else creates it at the correct level. */
-rrb_t* create_clone(const rrb_t* src, int level) {
-    debug_print("create_clone, beginning\n");
-    rrb_t* clone;
+rrb_node_t* create_clone(const rrb_node_t* src, int level) {
+    rrb_node_t* clone;
     if (src == NULL) {
         if (level == 1) {
             clone = create_w_leafs();
@@ -296,565 +334,1149 @@ rrb_t* create_clone(const rrb_t* src, int level) {
         }
         clone->level = level;
     } else {
-        clone = copy_node(src);
+        clone = copy_resized(src, src->slots);
     }
-    debug_print("create_clone, end\n");
     return clone;
 }
 
-/** Adds a node to a non fully tree. */
-rrb_t* add(rrb_t* clone, imc_data_t* data, bool meta) {
-    debug_print("add, beginning\n");
-    if (contains_leafs(clone)) {
-        debug_print("add, leafs\n");
-        return add_leaf(clone, data, place_to_insert(clone, meta));
-    } else {
-        debug_print("add, node\n");
-        return add_node(clone, data, meta);
-    }
+/** Creates a leaf holding size items. */
+rrb_node_t* leaf_from_items(imc_data_t** items, int size) {
+    rrb_node_t* leaf = alloc_node(1, size, false);
+    memcpy(leaf->nodes, items, size * sizeof *items);
+    leaf->elements = size;
+    leaf->full = size == 32;
+    return leaf;
+}
+
+/** Turns the tail of a vector into a leaf. */
+rrb_node_t* leaf_from_tail(const rrb_t* rrb) {
+    return leaf_from_items((imc_data_t**) rrb->tail, rrb->tail_size);
 }
 
-/** Easily add a data to a tree leafs. */
-rrb_t* add_leaf(rrb_t* rrb, imc_data_t* data, int where) {
-    debug_print("add_leaf, beginnning\n");
-    rrb->nodes.leaf[where] = data;
-    if (where == 31) {
-        rrb->full = true;
+/** Creates the branch of a tree down to leaf, at the desired level. The nodes
+  * of a transient get every slot, to be filled in place later. */
+rrb_node_t* create_path(int level, rrb_node_t* leaf, unsigned int owner) {
+    if (level == 1) {
+        return leaf;
     }
-    rrb->elements += 1;
-    debug_print("add_leaf, end\n");
+    rrb_node_t* rrb = alloc_node(level, owner == 0 ? 1 : 32, false);
+    rrb->owner = owner;
+    rrb->nodes[0].child = create_path(level - 1, leaf, owner);
+    rrb->elements = leaf->elements;
     return rrb;
 }
 
-/** Easily adds a data to a tree node. */
-rrb_t* add_node(rrb_t* rrb, imc_data_t* data, bool meta) {
-    debug_print("add_node, beginning\n");
-    int where = place_to_insert(rrb, meta);
-    rrb_t* clone = create_clone(rrb->nodes.child[where], rrb->level - 1);
-    rrb_t* child = rrb->nodes.child[where];
-    rrb->nodes.child[where] = add(clone, data, meta);
-    if (child != NULL) {
+/** Appends a leaf after the last one of a non full tree, copying the path. */
+rrb_node_t* append_leaf(const rrb_node_t* src, rrb_node_t* leaf) {
+    int last = find_last_index(src);
+    rrb_node_t* child = last >= 0 ? src->nodes[last].child : NULL;
+    rrb_node_t* rrb;
+    if (child != NULL && contains_nodes(child) && !is_full(child)) {
+        rrb = copy_resized(src, last + 1);
+        rrb->nodes[last].child = append_leaf(child, leaf);
         dec_ref(child);
+    } else {
+        rrb = copy_resized(src, last + 2);
+        rrb->nodes[last + 1].child = create_path(rrb->level - 1, leaf, 0);
     }
-    if (where == 31 && is_full(rrb->nodes.child[where])) {
-        rrb->full = true;
-    }
-    rrb->elements += 1;
-    debug_print("add_node, end\n");
+    rrb->elements += leaf->elements;
+    rrb = refresh_meta(rrb);
+    refresh_full(rrb);
     return rrb;
 }
 
+/** Pushes a leaf at the end of a tree, and returns the new tree. */
+rrb_node_t* push_tail(rrb_node_t* rrb, rrb_node_t* leaf) {
+    if (rrb == NULL) {
+        return leaf;
+    } else if (contains_leafs(rrb) || is_full(rrb)) {
+        rrb_node_t* parent = alloc_node(rrb->level + 1, 2, false);
+        parent->nodes[0].child = inc_ref(rrb);
+        parent->nodes[1].child = create_path(rrb->level, leaf, 0);
+        parent->elements = rrb->elements + leaf->elements;
+        return refresh_meta(parent);
+    } else {
+        return append_leaf(rrb, leaf);
+    }
+}
+
+/** Gets the whole content of a vector in a tree, tail included. */
+rrb_node_t* flush_tail(const rrb_t* rrb) {
+    if (rrb->tail_size == 0) {
+        return rrb->root == NULL ? NULL : inc_ref(rrb->root);
+    }
+    return push_tail(rrb->root, leaf_from_tail(rrb));
+}
+
 /** Adds a data to the tree, and returns a new version of the tree. */
 rrb_t* rrb_push(rrb_t* rrb, imc_data_t* data) {
-    debug_print("rrb_push, beginning\n");
-    if (is_full(rrb)) {
-        debug_print("rrb_push, full\n");
-        return add_as_parent_to(rrb, data);
+    rrb_t* clone;
+    if (rrb->tail_size == 32) {
+        clone = create_head(push_tail(rrb->root, leaf_from_tail(rrb)), 1);
     } else {
-        debug_print("rrb_push, not full\n");
-        rrb_t* clone = create_clone(rrb, rrb->level);
-        if (rrb->meta == NULL) {
-            return add(clone, data, false);
-        } else {
-            return add(clone, data, true);
-        }
+        clone = clone_head(rrb, 1);
     }
+    clone->tail[clone->tail_size++] = data;
+    return clone;
 }
 
 /** Gets the size of rrb. */
 size_t rrb_size(const rrb_t* rrb) {
-    debug_print("rrb_size, beginning\n");
     if (rrb == NULL) {
-        debug_print("rrb_size, null\n");
         return -1;
     } else {
-        debug_print("rrb_size, not null\n");
-        return rrb->elements;
+        return node_size(rrb->root) + rrb->tail_size;
     }
 }
 
-/** Looks for a data into the tree. */
-imc_data_t* lookup(const rrb_t* rrb, int* index, bool meta) {
-    debug_print("lookup, beginning\n");
-    int position = place_to_look(rrb, index, meta);
-    debug_args("lookup, position: %d\n", position);
-    if (contains_nodes(rrb)) {
-        debug_print("lookup, nodes\n");
-        return lookup(rrb->nodes.child[position], index, meta);
-    } else {
-        debug_print("lookup, leafs\n");
-        return rrb->nodes.leaf[position];
+/** Looks for a data into the tree. The relaxed nodes are crossed with their
+  * meta, then the dense subtree below with a shift and a mask per level. */
+imc_data_t* node_lookup(const rrb_node_t* rrb, int index) {
+    imc_count(lookups, 1);
+    while (rrb->meta != NULL) {
+        imc_count(visited, 1);
+        rrb = rrb->nodes[check_meta_index(rrb, &index)].child;
+    }
+    imc_count(visited, rrb->level);
+    // An int index can't go deeper than 7 levels.
+    switch (rrb->level) {
+        case 7: rrb = rrb->nodes[(index >> 30) & 31].child; /* fall through */
+        case 6: rrb = rrb->nodes[(index >> 25) & 31].child; /* fall through */
+        case 5: rrb = rrb->nodes[(index >> 20) & 31].child; /* fall through */
+        case 4: rrb = rrb->nodes[(index >> 15) & 31].child; /* fall through */
+        case 3: rrb = rrb->nodes[(index >> 10) & 31].child; /* fall through */
+        case 2: rrb = rrb->nodes[(index >>  5) & 31].child; /* fall through */
+        default: return rrb->nodes[index & 31].leaf;
     }
-
 }
 
 /** Checks if the index is correct then looks for a data into the tree. */
 imc_data_t* rrb_lookup(const rrb_t* rrb, int index) {
-    debug_print("rrb_lookup, beginning\n");
     if ((size_t) index >= rrb_size(rrb)) {
-        debug_print("rrb_lookup, no index\n");
         return NULL;
+    } else if ((size_t) index >= node_size(rrb->root)) {
+        return rrb->tail[index - node_size(rrb->root)];
     } else {
-        debug_print("rrb_lookup, lookup\n");
-        if (rrb->meta != NULL) {
-            return lookup(rrb, &index, true);
-        } else {
-            return lookup(rrb, &index, false);
-        }
+        return node_lookup(rrb->root, index);
     }
 }
 
 /** Unref rrb and free it automatically if needed. */
 void rrb_unref(rrb_t* rrb) {
-    debug_print("rrb_unref, beginning\n");
-    dec_ref(rrb);
-    debug_print("rrb_unref, end\n");
+    if (rrb->root != NULL) {
+        dec_ref(rrb->root);
+    }
+    free_head(rrb);
+}
+
+/** Checks if a node was allocated in an arena: it has no reference. */
+bool in_arena(const rrb_node_t* rrb) {
+#ifdef RRB_THREAD_SAFE
+    return atomic_load_explicit(&rrb->ref, memory_order_relaxed) == 0;
+#else
+    return rrb->ref == 0;
+#endif
+}
+
+/** Copies the nodes of a tree allocated in arenas, and shares the others. */
+rrb_node_t* promote(rrb_node_t* rrb) {
+    if (in_arena(rrb) == false) {
+        return inc_ref(rrb);
+    }
+    rrb_node_t* copy = alloc_node(rrb->level, rrb->slots, rrb->meta_room);
+    rrb_trace("promote", rrb->level, copy, 1);
+    imc_count(copies, 1);
+    clone_info(copy, rrb);
+    if (rrb->meta == NULL) {
+        copy->meta = NULL;
+    } else {
+        memcpy(copy->meta, rrb->meta, rrb->slots * sizeof *rrb->meta);
+    }
+    if (contains_nodes(rrb)) {
+        for (int i = 0; i < rrb->slots; i++) {
+            if (rrb->nodes[i].child != NULL) {
+                copy->nodes[i].child = promote(rrb->nodes[i].child);
+            }
+        }
+    } else {
+        memcpy(copy->nodes, rrb->nodes, rrb->slots * sizeof *rrb->nodes);
+    }
+    return copy;
+}
+
+/** Promotes the tree of a version, and copies its tail. */
+rrb_t* rrb_promote(const rrb_t* rrb) {
+    rrb_t* promoted = create_head(rrb->root == NULL ? NULL : promote(rrb->root),
+                                  rrb->tail_size);
+    promoted->tail_size = rrb->tail_size;
+    memcpy(promoted->tail, rrb->tail, rrb->tail_size * sizeof *rrb->tail);
+    return promoted;
 }
 
 /** Updates the tree by changing the data at index by data. */
-rrb_t* update(const rrb_t* rrb, int* index, imc_data_t* data, bool meta) {
-    debug_print("update, beginning\n");
-    rrb_t* clone = create_clone(rrb, rrb->level);
+rrb_node_t* update(const rrb_node_t* rrb, int* index, imc_data_t* data) {
+    rrb_node_t* clone = create_clone(rrb, rrb->level);
     if (contains_leafs(clone)) {
-        debug_print("update, leafs\n");
-        return update_leaf(clone, place_to_look(clone, index, meta), data);
+        return update_leaf(clone, place_to_look(clone, index), data);
     } else {
-        debug_print("update, node\n");
-        return update_node(clone, index, data, meta);
+        return update_node(clone, index, data);
     }
 }
 
 /** Easily updates a data in a tree leaf. */
-rrb_t* update_leaf(rrb_t* rrb, int where, imc_data_t* data) {
-    debug_print("update_leaf, beginnning\n");
-    rrb->nodes.leaf[where] = data;
-    debug_print("add_leaf, end\n");
+rrb_node_t* update_leaf(rrb_node_t* rrb, int where, imc_data_t* data) {
+    rrb->nodes[where].leaf = data;
     return rrb;
 }
 
 /** Easily updates a data in a tree node. */
-rrb_t* update_node(rrb_t* rrb, int* index, imc_data_t* data, bool meta) {
-    debug_print("update_node, beginning\n");
-    int where = place_to_look(rrb, index, meta);
-    dec_ref(rrb->nodes.child[where]);
-    rrb->nodes.child[where] = update(rrb->nodes.child[where], index, data, meta);
-    debug_print("update_node, end\n");
+rrb_node_t* update_node(rrb_node_t* rrb, int* index, imc_data_t* data) {
+    int where = place_to_look(rrb, index);
+    dec_ref(rrb->nodes[where].child);
+    rrb->nodes[where].child = update(rrb->nodes[where].child, index, data);
     return rrb;
 }
 
 /** Checks if index is inside the tree, and update the data at index by data. */
 rrb_t* rrb_update(const rrb_t* rrb, int index, imc_data_t* data) {
-    debug_print("rrb_update, beginning\n");
     if ((size_t) index >= rrb_size(rrb)) {
-        debug_print("rrb_lookup, no index\n");
         return NULL;
+    } else if ((size_t) index >= node_size(rrb->root)) {
+        rrb_t* clone = clone_head(rrb, 0);
+        clone->tail[index - node_size(rrb->root)] = data;
+        return clone;
     } else {
-        debug_print("rrb_update, update\n");
-        if (rrb->meta != NULL) {
-            return update(rrb, &index, data, true);
-        } else {
-            return update(rrb, &index, data, false);
-        }
+        rrb_t* clone = create_head(NULL, rrb->tail_size);
+        clone->tail_size = rrb->tail_size;
+        memcpy(clone->tail, rrb->tail, rrb->tail_size * sizeof *rrb->tail);
+        clone->root = update(rrb->root, &index, data);
+        return clone;
     }
 }
 
-/** Pop the last element for the tree, and put the data into data. */
-rrb_t* pop(const rrb_t* rrb, imc_data_t** data, int* index, bool meta) {
-    debug_print("pop, beginning\n");
-    rrb_t* clone = create_clone(rrb, rrb->level);
-    if (contains_nodes(rrb)) {
-        rrb_t* root = pop_node(clone, data, index, meta);
-        if (root->nodes.child[1] == NULL) {
-            rrb_t* child = inc_ref(root->nodes.child[0]);
-            dec_ref(root);
-            return child;
-        } else {
-            return root;
-        }
-    } else {
-        return pop_data(clone, data, index, meta);
+/** Removes the last leaf from the tree, and puts it into leaf. Returns the
+  * new tree, or NULL if nothing remains. */
+rrb_node_t* pop_tail(rrb_node_t* rrb, rrb_node_t** leaf) {
+    if (contains_leafs(rrb)) {
+        *leaf = inc_ref(rrb);
+        return NULL;
     }
-}
 
-/** Convenient way to pop data from leafs. */
-rrb_t* pop_data(rrb_t* rrb, imc_data_t** data, int* index, bool meta) {
-    int position = place_to_look(rrb, index, meta);
-    *data = rrb->nodes.leaf[position];
-    rrb->nodes.leaf[position] = NULL;
-    rrb->elements -= 1;
-    if (rrb_size(rrb) == 0) {
-        dec_ref(rrb);
+    int last = find_last_index(rrb);
+    rrb_node_t* clone = copy_resized(rrb, last + 1);
+    rrb_node_t* child = pop_tail(rrb->nodes[last].child, leaf);
+    dec_ref(clone->nodes[last].child);
+    clone->nodes[last].child = child;
+    clone->elements -= (*leaf)->elements;
+    if (child == NULL && last == 0) {
+        dec_ref(clone);
         return NULL;
-    } else {
-        return rrb;
     }
+    clone = refresh_meta(clone);
+    refresh_full(clone);
+    return clone;
 }
 
-/** Convenient way to pop data from nodes. */
-rrb_t* pop_node(rrb_t* rrb, imc_data_t** data, int* index, bool meta) {
-    int position = place_to_look(rrb, index, meta);
-    rrb_t* child = pop(rrb->nodes.child[position], data, index, meta);
-    dec_ref(rrb->nodes.child[position]);
-    if (rrb_size(child) == 0) {
-        dec_ref(child);
-        rrb->nodes.child[position] = NULL;
-    } else {
-        rrb->nodes.child[position] = child;
+/** Removes the levels of the tree which only contain one child. */
+rrb_node_t* collapse(rrb_node_t* rrb) {
+    while (rrb != NULL && contains_nodes(rrb) &&
+        (rrb->slots == 1 || rrb->nodes[1].child == NULL)) {
+        rrb_node_t* child = inc_ref(rrb->nodes[0].child);
+        dec_ref(rrb);
+        rrb = child;
     }
-    rrb->elements -= 1;
     return rrb;
 }
 
-/** Checks if the meta is NULL and pop the last data from the tree. */
+/** Pop the last element of the vector, and put the data into data. When the
+  * tail is empty, the last leaf of the tree becomes the new tail. */
 rrb_t* rrb_pop(rrb_t* rrb, imc_data_t** data) {
-    debug_print("rrb_pop, beginning\n");
-    int index = rrb_size(rrb) - 1;
     // Check if there's at least an element in the tree.
-    if (index == -1) {
+    if (rrb_size(rrb) == 0) {
         return NULL;
     }
-    if (rrb->meta == NULL) {
-        debug_print("rrb_pop, meta null\n");
-        return pop(rrb, data, &index, false);
+
+    rrb_t* clone;
+    if (rrb->tail_size > 0) {
+        clone = clone_head(rrb, 0);
     } else {
-        debug_print("rrb_pop, meta\n");
-        return pop(rrb, data, &index, true);
+        rrb_node_t* leaf;
+        rrb_node_t* root = collapse(pop_tail(rrb->root, &leaf));
+        clone = create_head(root, leaf->elements);
+        clone->tail_size = leaf->elements;
+        memcpy(clone->tail, leaf->nodes, leaf->elements * sizeof *clone->tail);
+        dec_ref(leaf);
     }
+    *data = clone->tail[--clone->tail_size];
+    return clone;
 }
 
-/** Inits both left and right trees, according to the RRB-Tree provided. */
-void init_left_right(const rrb_t* rrb, rrb_t** left, rrb_t** right, bool leafs) {
-    if (leafs == false) {
-        *left  = create_w_nodes();
-        *right = create_w_nodes();
-        (*left )->level = rrb->level;
-        (*right)->level = rrb->level;
-        (*left )->elements += 1;
-        (*right)->elements += 1;
-    } else {
-        *left  = create_w_leafs();
-        *right = create_w_leafs();
+/** Finds last index used in the nodes array. */
+int find_last_index(const rrb_node_t* rrb) {
+    for (int i = 0; i < rrb->slots; i++) {
+        if (rrb->nodes[i].child == NULL) {
+            return i - 1;
+        }
     }
+    return rrb->slots - 1;
 }
 
-/** Calculus the maximum size of a tree at its level. */
-size_t calc_size(int level) {
-    return 32 << (5 * (level - 2));
+/** Gets the number of slots used in a node: its elements for a leaf, its
+  * children otherwise. */
+int used_slots(const rrb_node_t* rrb) {
+    return contains_leafs(rrb) ? rrb->elements : find_last_index(rrb) + 1;
 }
 
-/** Finds if the tree needs a meta section or not. */
-bool find_if_meta(const rrb_t* rrb) {
-    if (rrb_size(rrb) == 0) {
-        return false;
+/** Creates the node above size children, and gives it their references. */
+rrb_node_t* create_parent(rrb_node_t** children, int size) {
+    rrb_node_t* parent = alloc_node(children[0]->level + 1, size, false);
+    for (int i = 0; i < size; i++) {
+        parent->nodes[i].child = children[i];
+        parent->elements += children[i]->elements;
     }
+    parent = refresh_meta(parent);
+    refresh_full(parent);
+    return parent;
+}
 
-    for (int i = 1; i < 32; i++) {
-        if (rrb->nodes.child[i] == NULL) {
-            return false;
-        } else if (rrb_size(rrb->nodes.child[i - 1]) < calc_size(rrb->level - 2)) {
-            return true;
-        }
+/** Plans the number of slots of the nodes replacing all, in order to use at
+  * most two nodes more than needed. Each node too short is spread over the
+  * next ones, until enough nodes are removed. Returns the number of nodes. */
+int create_concat_plan(rrb_node_t** all, int size, int* plan) {
+    int total = 0;
+    for (int i = 0; i < size; i++) {
+        plan[i] = used_slots(all[i]);
+        total += plan[i];
     }
-    return false;
-}
 
-/** Checks and set the size correctly. */
-void set_proper_size(rrb_t* rrb) {
-    for (int i = 0; i < 32; i ++) {
-        consolidate_tree(&(rrb->nodes.child[i]), false);
-        if (rrb->nodes.child[i] != NULL) {
-            rrb->elements += rrb_size(rrb->nodes.child[i]);
+    int optimal = (total - 1) / 32 + 1;
+    int i = 0;
+    while (optimal + 2 < size) {
+        while (plan[i] > 31) {
+            i++;
         }
+        int remaining = plan[i];
+        while (remaining > 0) {
+            int moved = remaining + plan[i + 1] < 32 ? remaining + plan[i + 1] : 32;
+            remaining += plan[i + 1] - moved;
+            plan[i++] = moved;
+        }
+        // The node after the last one filled has been emptied.
+        memmove(&plan[i], &plan[i + 1], (size - i - 1) * sizeof *plan);
+        size -= 1;
+        i -= 1;
     }
+    return size;
 }
 
-/** Checks and creates meta if needed. */
-void set_proper_meta(rrb_t* rrb) {
-    if (find_if_meta(rrb) == true) {
-        rrb->meta = make_meta();
-        rrb->meta[0] = rrb_size(rrb->nodes.child[0]);
-        for (int i = 1; i < 32; i ++) {
-            if (rrb->nodes.child[i] != NULL) {
-                rrb->meta[i] = rrb_size(rrb->nodes.child[i]) + rrb->meta[i - 1];
+/** Creates the nodes planned by moving the slots of all in them. A node of
+  * all which is already as planned is shared instead. */
+void execute_concat_plan(rrb_node_t** all, const int* plan, int size, rrb_node_t** nodes) {
+    int index = 0, offset = 0;
+    for (int i = 0; i < size; i++) {
+        if (offset == 0 && plan[i] == used_slots(all[index])) {
+            nodes[i] = inc_ref(all[index++]);
+            continue;
+        }
+
+        rrb_node_t* node = alloc_node(all[index]->level, plan[i], false);
+        for (int filled = 0; filled < plan[i];) {
+            const rrb_node_t* src = all[index];
+            int moved = used_slots(src) - offset;
+            moved = moved < plan[i] - filled ? moved : plan[i] - filled;
+            memcpy(&node->nodes[filled], &src->nodes[offset], moved * sizeof *src->nodes);
+            filled += moved;
+            offset += moved;
+            if (offset == used_slots(src)) {
+                index += 1;
+                offset = 0;
             }
         }
+        if (contains_leafs(node)) {
+            node->elements = plan[i];
+            node->full = plan[i] == 32;
+        } else {
+            for (int j = 0; j < plan[i]; j++) {
+                node->elements += inc_ref(node->nodes[j].child)->elements;
+            }
+            node = refresh_meta(node);
+            refresh_full(node);
+        }
+        rrb_trace("execute_concat_plan", node->level, node, 1);
+        nodes[i] = node;
     }
 }
 
-/** Takes a tree just splitted and not well defined, and define everything as
-  * it should be, i.e., setting proper sizes and creating meta if needed. */
-void consolidate_tree(rrb_t** rrb, bool top) {
-    if (*rrb != NULL && contains_nodes(*rrb)) {
-        if (rrb_size(*rrb) == 1 && top == true) {
-            rrb_t* temp = inc_ref((*rrb)->nodes.child[0]);
-            dec_ref(*rrb);
-            *rrb = temp;
-            return consolidate_tree(rrb, true);
-        }
+/** Rebalances the children of left but the last, of centre, and of right but
+  * the first, which are merged by centre. Returns the node above the node(s)
+  * holding them, or at the top their node itself if they fit in one. */
+rrb_node_t* rebalance(const rrb_node_t* left, rrb_node_t* centre,
+    const rrb_node_t* right, bool top) {
+    // At most 31 children from each side, and 2 from centre.
+    rrb_node_t* all[64];
+    int size = 0;
+    for (int i = 0; left != NULL && i < used_slots(left) - 1; i++) {
+        all[size++] = left->nodes[i].child;
+    }
+    for (int i = 0; i < used_slots(centre); i++) {
+        all[size++] = centre->nodes[i].child;
+    }
+    for (int i = 1; right != NULL && i < used_slots(right); i++) {
+        all[size++] = right->nodes[i].child;
+    }
 
-        (*rrb)->elements = 0;
-        if (contains_nodes(*rrb)) {
-            set_proper_size(*rrb);
-            set_proper_meta(*rrb);
+    int plan[64];
+    rrb_node_t* nodes[64];
+    size = create_concat_plan(all, size, plan);
+    execute_concat_plan(all, plan, size, nodes);
+    dec_ref(centre);
+
+    rrb_node_t* rrb;
+    if (size <= 32) {
+        rrb = create_parent(nodes, size);
+        if (top == false) {
+            rrb = create_parent(&rrb, 1);
         }
+    } else {
+        rrb_node_t* halves[2];
+        halves[0] = create_parent(nodes, 32);
+        halves[1] = create_parent(&nodes[32], size - 32);
+        rrb = create_parent(halves, 2);
+    }
+    return rrb;
+}
+
+/** Concatenates two trees following Bagwell and Rompf: the right edge of left
+  * and the left edge of right are merged from the bottom, and rebalanced at
+  * each level. Returns the node above the result, except at the top where it
+  * can be the result itself. left and right are left untouched. */
+rrb_node_t* concat_sub_tree(rrb_node_t* left, rrb_node_t* right, bool top) {
+    if (left->level > right->level) {
+        rrb_node_t* last = left->nodes[used_slots(left) - 1].child;
+        return rebalance(left, concat_sub_tree(last, right, false), NULL, top);
+    } else if (left->level < right->level) {
+        rrb_node_t* first = right->nodes[0].child;
+        return rebalance(NULL, concat_sub_tree(left, first, false), right, top);
+    } else if (contains_nodes(left)) {
+        rrb_node_t* last  = left->nodes[used_slots(left) - 1].child;
+        rrb_node_t* first = right->nodes[0].child;
+        return rebalance(left, concat_sub_tree(last, first, false), right, top);
+    }
+
+    int size = left->elements + right->elements;
+    if (top == true && size <= 32) {
+        rrb_node_t* leaf = alloc_node(1, size, false);
+        memcpy(leaf->nodes, left->nodes, left->elements * sizeof *left->nodes);
+        memcpy(&leaf->nodes[left->elements], right->nodes,
+            right->elements * sizeof *right->nodes);
+        leaf->elements = size;
+        leaf->full = size == 32;
+        rrb_trace("concat_sub_tree, single leaf", 1, leaf, 1);
+        return leaf;
     }
+    rrb_node_t* leafs[2] = { inc_ref(left), inc_ref(right) };
+    return create_parent(leafs, 2);
 }
 
-/** Shortcut, and nicer to read in rrb_split. */
-void consolidate_trees(rrb_t** left, rrb_t** right) {
-    consolidate_tree(left, true);
-    consolidate_tree(right, true);
+/** Merges two RRB-Vectors into one, and returns it. The tail of left goes
+  * into the tree, the tail of right stays the tail of the result. Only the
+  * edges where the trees meet are copied, so merging is in O(log n). */
+rrb_t* rrb_merge(rrb_t* left, rrb_t* right) {
+    rrb_node_t* tree = flush_tail(left);
+    rrb_t* merged = clone_head(right, 0);
+    if (tree == NULL) {
+        return merged;
+    } else if (merged->root == NULL) {
+        merged->root = tree;
+        return merged;
+    }
+
+    rrb_node_t* root = collapse(concat_sub_tree(tree, merged->root, true));
+    dec_ref(tree);
+    dec_ref(merged->root);
+    merged->root = root;
+    return merged;
 }
 
-/** Splits the tree. If the tree is not relaxed, left will not be relaxed.
-  * right will always be relaxed, due to the nature of the split.
-  * Rearranging the tree to make it balanced is possible, but really costly,
-  * as it involves a lot of memory moves from different nodes and leaf in the
-  * tree. It could be a possible improvement to provide different versions:
-  * split and split_balanced, which splits the tree, then do a balancing. */
-int split(const rrb_t* rrb, rrb_t** left, rrb_t** right,
-    int* index, bool meta) {
-    if (contains_leafs(rrb)) {
-        return split_leaf(rrb, left, right, index, meta);
+/** Keeps the first n elements of a tree, 0 < n <= its size. Only the nodes on
+  * the cut are copied, every other subtree is shared. */
+rrb_node_t* take(rrb_node_t* rrb, int n) {
+    if ((size_t) n == node_size(rrb)) {
+        return inc_ref(rrb);
+    } else if (contains_leafs(rrb)) {
+        rrb_node_t* leaf = alloc_node(1, n, false);
+        memcpy(leaf->nodes, rrb->nodes, n * sizeof *rrb->nodes);
+        leaf->elements = n;
+        rrb_trace("take", 1, leaf, 1);
+        return leaf;
+    }
+
+    int index = n - 1;
+    int where = place_in_child(rrb, &index);
+    rrb_node_t* clone = alloc_node(rrb->level, where + 1, rrb->meta != NULL);
+    for (int i = 0; i < where; i++) {
+        clone->nodes[i].child = inc_ref(rrb->nodes[i].child);
+    }
+    clone->nodes[where].child = take(rrb->nodes[where].child, index + 1);
+    clone->elements = n;
+    clone = refresh_meta(clone);
+    refresh_full(clone);
+    rrb_trace("take", clone->level, clone, 1);
+    return clone;
+}
+
+/** Removes the first n elements of a tree, 0 <= n < its size. Only the nodes
+  * on the cut are copied, every other subtree is shared. */
+rrb_node_t* drop(rrb_node_t* rrb, int n) {
+    if (n == 0) {
+        return inc_ref(rrb);
+    } else if (contains_leafs(rrb)) {
+        rrb_node_t* leaf = alloc_node(1, rrb->elements - n, false);
+        memcpy(leaf->nodes, &rrb->nodes[n], (rrb->elements - n) * sizeof *rrb->nodes);
+        leaf->elements = rrb->elements - n;
+        rrb_trace("drop", 1, leaf, 1);
+        return leaf;
+    }
+
+    int where = place_in_child(rrb, &n);
+    int last = find_last_index(rrb);
+    rrb_node_t* clone = alloc_node(rrb->level, last - where + 1, true);
+    clone->nodes[0].child = drop(rrb->nodes[where].child, n);
+    for (int i = where + 1; i <= last; i++) {
+        clone->nodes[i - where].child = inc_ref(rrb->nodes[i].child);
+    }
+    for (int i = 0; i <= last - where; i++) {
+        clone->elements += clone->nodes[i].child->elements;
+    }
+    clone = refresh_meta(clone);
+    refresh_full(clone);
+    rrb_trace("drop", clone->level, clone, 1);
+    return clone;
+}
+
+/** Keeps the first n elements of a vector. The tree is cut with take, and
+  * the tail is kept only if some of its elements remain. */
+rrb_t* rrb_take(const rrb_t* rrb, int n) {
+    if (n < 0 || (size_t) n > rrb_size(rrb)) {
+        return NULL;
+    }
+
+    int tree_size = node_size(rrb->root);
+    rrb_t* taken;
+    if (n > tree_size) {
+        taken = clone_head(rrb, 0);
+        taken->tail_size = n - tree_size;
+    } else if (n > 0) {
+        taken = create_head(collapse(take(rrb->root, n)), 0);
     } else {
-        return split_node(rrb, left, right, index, meta);
+        taken = rrb_create();
     }
+    return taken;
 }
 
-/** Convenient way to split a leaf. */
-int split_leaf(const rrb_t* rrb, rrb_t** left, rrb_t** right,
-    int* index, bool meta) {
-    int where = place_to_look(rrb, index, meta);
-    init_left_right(rrb, left, right, true);
-    for (int i = 0; i < where; i++) {
-        (*left)->nodes.leaf[i] = rrb->nodes.leaf[i];
-        (*left)->elements += 1;
+/** Removes the first n elements of a vector. The tree is cut with drop, and
+  * the tail is always kept. */
+rrb_t* rrb_drop(const rrb_t* rrb, int n) {
+    if (n < 0 || (size_t) n > rrb_size(rrb)) {
+        return NULL;
     }
-    for (int i = where, j = 0; i < 32; i++, j++) {
-        (*right)->nodes.leaf[j] = rrb->nodes.leaf[i];
-        (*right)->elements += 1;
+
+    int tree_size = node_size(rrb->root);
+    rrb_t* dropped;
+    if (n >= tree_size) {
+        dropped = create_head(NULL, rrb->tail_size - (n - tree_size));
+        dropped->tail_size = rrb->tail_size - (n - tree_size);
+        memcpy(dropped->tail, &rrb->tail[n - tree_size],
+            dropped->tail_size * sizeof *rrb->tail);
+    } else {
+        dropped = create_head(collapse(drop(rrb->root, n)), rrb->tail_size);
+        dropped->tail_size = rrb->tail_size;
+        memcpy(dropped->tail, rrb->tail, rrb->tail_size * sizeof *rrb->tail);
     }
-    return 1;
+    return dropped;
 }
 
-/** Convenient way to split a node. */
-int split_node(const rrb_t* rrb, rrb_t** left, rrb_t** right,
-    int* index, bool meta) {
-    int where = place_to_look(rrb, index, meta);
-    init_left_right(rrb, left, right, false);
-    for (int i = 0; i < where; i++) {
-        (*left)->nodes.child[i] = rrb->nodes.child[i];
-        inc_ref(rrb->nodes.child[i]);
-        (*left)->elements += 1;
-    }
-    for (int i = where + 1, j = 1; i < 32; i++, j++) {
-        (*right)->nodes.child[j] = rrb->nodes.child[i];
-        if (rrb->nodes.child[i] != NULL) {
-            inc_ref(rrb->nodes.child[i]);
-            (*right)->elements += 1;
-        }
+/** Keeps the elements from index from to index to, excluded. */
+rrb_t* rrb_slice(const rrb_t* rrb, int from, int to) {
+    if (from < 0 || from > to || (size_t) to > rrb_size(rrb)) {
+        return NULL;
     }
-    return split(rrb->nodes.child[where], &((*left)->nodes.child[where]),
-        &((*right)->nodes.child[0]), index, meta);
+    rrb_t* taken = rrb_take(rrb, to);
+    rrb_t* sliced = rrb_drop(taken, from);
+    rrb_unref(taken);
+    return sliced;
 }
 
 /** Splits the RRB-Tree into two trees and stores both parts into left and
-  * right. Provides the index to indicates the cut. Element pointed by the index
-  * will be contained in right resulting tree. */
+  * right. Element pointed by the index is the last one of left. */
 int rrb_split(const rrb_t* rrb, rrb_t** left, rrb_t** right, int index) {
-    debug_print("rrb_split, beginning\n");
-    int value = 0;
     if ((size_t) ++index > rrb_size(rrb)) {
         *left  = NULL;
         *right = NULL;
-        return value;
+        return 0;
     }
+    *left  = rrb_take(rrb, index);
+    *right = rrb_drop(rrb, index);
+    return 1;
+}
 
-    if (rrb->meta == NULL) {
-        debug_print("rrb_split, meta null\n");
-        value = split(rrb, left, right, &index, false);
+/** Counter giving its owner to each transient. */
+static unsigned int last_owner = 0;
+
+/** Gets a node the transient can modify: the node itself if the transient
+  * owns it, else a copy with every slot, which replaces the node. */
+rrb_node_t* edit_node(rrb_node_t* rrb, unsigned int owner) {
+    if (rrb->owner == owner) {
+        return rrb;
+    }
+    rrb_node_t* clone = copy_resized(rrb, 32);
+    clone->owner = owner;
+    dec_ref(rrb);
+    return clone;
+}
+
+/** Appends a leaf after the last one of a non full tree, in place. */
+rrb_node_t* transient_append_leaf(rrb_node_t* rrb, rrb_node_t* leaf, unsigned int owner) {
+    int last = find_last_index(rrb);
+    rrb_node_t* child = last >= 0 ? rrb->nodes[last].child : NULL;
+    if (child != NULL && contains_nodes(child) && !is_full(child)) {
+        child = edit_node(child, owner);
+        rrb->nodes[last].child = transient_append_leaf(child, leaf, owner);
     } else {
-        debug_print("rrb_split, meta\n");
-        value = split(rrb, left, right, &index, true);
+        rrb->nodes[last + 1].child = create_path(rrb->level - 1, leaf, owner);
     }
-    consolidate_trees(left, right);
-    return value;
+    rrb->elements += leaf->elements;
+    rrb = refresh_meta(rrb);
+    refresh_full(rrb);
+    return rrb;
 }
 
-/** Convenient way to init merge leaves. */
-rrb_t* init_merge_leaves(rrb_t* left, rrb_t* right) {
-    rrb_t* parent = create_w_nodes();
-    parent->level = 2;
-    parent->nodes.child[0] = left;
-    parent->nodes.child[1] = right;
-    parent->elements = rrb_size(left) + rrb_size(right);
-    return parent;
+/** Pushes a leaf at the end of the tree of a transient. */
+rrb_node_t* transient_push_tail(rrb_node_t* rrb, rrb_node_t* leaf, unsigned int owner) {
+    if (rrb == NULL) {
+        return leaf;
+    } else if (contains_leafs(rrb) || is_full(rrb)) {
+        rrb_node_t* parent = alloc_node(rrb->level + 1, 32, false);
+        parent->owner = owner;
+        parent->nodes[0].child = rrb;
+        parent->nodes[1].child = create_path(rrb->level, leaf, owner);
+        parent->elements = rrb->elements + leaf->elements;
+        return refresh_meta(parent);
+    } else {
+        return transient_append_leaf(edit_node(rrb, owner), leaf, owner);
+    }
 }
 
-/** Finds last index used in the nodes array. */
-int find_last_index(const rrb_t* rrb) {
-    for (int i = 0; i < 32; i++) {
-        if (rrb->nodes.child[i] == NULL) {
-            return i - 1;
-        }
+/** Removes the last leaf from the tree of a transient, and puts it into leaf.
+  * Returns the tree, or NULL if nothing remains. */
+rrb_node_t* transient_pop_tail(rrb_node_t* rrb, rrb_node_t** leaf, unsigned int owner) {
+    if (contains_leafs(rrb)) {
+        *leaf = rrb;
+        return NULL;
+    }
+
+    rrb = edit_node(rrb, owner);
+    int last = find_last_index(rrb);
+    rrb_node_t* child = transient_pop_tail(rrb->nodes[last].child, leaf, owner);
+    rrb->nodes[last].child = child;
+    rrb->elements -= (*leaf)->elements;
+    if (child == NULL && last == 0) {
+        dec_ref(rrb);
+        return NULL;
+    }
+    rrb = refresh_meta(rrb);
+    refresh_full(rrb);
+    return rrb;
+}
+
+/** Starts a transient from a version of a vector. */
+rrb_transient_t* rrb_transient(const rrb_t* rrb) {
+    rrb_transient_t* transient = malloc(sizeof *transient);
+    transient->rrb = clone_head(rrb, 32 - rrb->tail_size);
+    do {
+        transient->owner = __sync_add_and_fetch(&last_owner, 1);
+    } while (transient->owner == 0);
+    return transient;
+}
+
+/** Adds a data at the end of a transient. */
+rrb_transient_t* rrb_transient_push(rrb_transient_t* transient, imc_data_t* data) {
+    rrb_t* rrb = transient->rrb;
+    if (rrb->tail_size == 32) {
+        rrb_node_t* leaf = leaf_from_tail(rrb);
+        rrb->root = transient_push_tail(rrb->root, leaf, transient->owner);
+        rrb->tail_size = 0;
+    }
+    rrb->tail[rrb->tail_size++] = data;
+    return transient;
+}
+
+/** Checks if index is inside the transient, and changes the data at index. */
+rrb_transient_t* rrb_transient_update(rrb_transient_t* transient, int index, imc_data_t* data) {
+    rrb_t* rrb = transient->rrb;
+    if ((size_t) index >= rrb_size(rrb)) {
+        return NULL;
+    } else if ((size_t) index >= node_size(rrb->root)) {
+        rrb->tail[index - node_size(rrb->root)] = data;
+        return transient;
+    }
+
+    rrb->root = edit_node(rrb->root, transient->owner);
+    rrb_node_t* node = rrb->root;
+    while (contains_nodes(node)) {
+        int where = place_to_look(node, &index);
+        node->nodes[where].child = edit_node(node->nodes[where].child, transient->owner);
+        node = node->nodes[where].child;
     }
-    return 31;
+    node->nodes[place_to_look(node, &index)].leaf = data;
+    return transient;
 }
 
-/** Balances a data tree. */
-void move_datas(rrb_t* left, rrb_t* right) {
-    int i, j; size_t size = rrb_size(right);
-    for (i = rrb_size(left), j = 0; i < 32 && (size_t) j < size; i++, j++) {
-        left->nodes.leaf[i] = right->nodes.leaf[j];
-        left->elements  += 1;
-        right->elements -= 1;
+/** Removes the last data of a transient. When the tail is empty, the last
+  * leaf of the tree becomes the new tail. */
+rrb_transient_t* rrb_transient_pop(rrb_transient_t* transient, imc_data_t** data) {
+    rrb_t* rrb = transient->rrb;
+    if (rrb_size(rrb) == 0) {
+        return NULL;
     }
 
-    for (i = 0; j < 32; i++, j++) {
-        right->nodes.leaf[i] = right->nodes.leaf[j];
-        right->nodes.leaf[j] = NULL;
+    if (rrb->tail_size == 0) {
+        rrb_node_t* leaf;
+        rrb->root = transient_pop_tail(rrb->root, &leaf, transient->owner);
+        rrb->root = collapse(rrb->root);
+        rrb->tail_size = leaf->elements;
+        memcpy(rrb->tail, leaf->nodes, leaf->elements * sizeof *rrb->tail);
+        dec_ref(leaf);
     }
+    *data = rrb->tail[--rrb->tail_size];
+    return transient;
 }
 
-/** Merges leaves nodes. */
-rrb_t* merge_leaves(rrb_t* left, rrb_t* right) {
-    rrb_t* parent = init_merge_leaves(left, right);
-    rrb_t* n_left  = parent->nodes.child[0];
-    rrb_t* n_right = parent->nodes.child[1];
-    if (!is_full(n_left)) {
-        move_datas(n_left, n_right);
-        if (n_right->elements == 0) {
-            dec_ref(n_right);
-            parent->nodes.child[1] = NULL;
+/** Adds n items at the end of a transient. They go through the tail 32 at a
+  * time, and each full tail goes down into the tree as a leaf. */
+void transient_push_items(rrb_transient_t* transient, imc_data_t** items, size_t n) {
+    rrb_t* rrb = transient->rrb;
+    for (size_t i = 0; i < n;) {
+        if (rrb->tail_size == 32) {
+            rrb_node_t* leaf = leaf_from_tail(rrb);
+            rrb->root = transient_push_tail(rrb->root, leaf, transient->owner);
+            rrb->tail_size = 0;
         }
+        size_t size = 32 - rrb->tail_size;
+        size = n - i < size ? n - i : size;
+        memcpy(&rrb->tail[rrb->tail_size], &items[i], size * sizeof *items);
+        rrb->tail_size += size;
+        i += size;
     }
-    return parent;
 }
 
-/** Deletes first elem from right, and last elem in left. */
-void delete_first_n_last(rrb_t* left, rrb_t* right, int last) {
-    dec_ref(left->nodes.child[last]);
-    dec_ref(right->nodes.child[0]);
-    left->nodes.child[last] = NULL;
-    for (int i = 0; i < 31; i++) {
-        right->nodes.child[i] = right->nodes.child[i + 1];
+/** Ends a transient. Its nodes keep the owner, which is never given again. */
+rrb_t* rrb_persistent(rrb_transient_t* transient) {
+    rrb_t* rrb = transient->rrb;
+    free(transient);
+    return rrb;
+}
+
+/** Adds n items at the end of a vector. The right edge of the tree is copied
+  * once by a transient, then filled in place leaf by leaf. */
+rrb_t* rrb_push_many(const rrb_t* rrb, imc_data_t** items, size_t n) {
+    if (rrb_size(rrb) == 0) {
+        return rrb_from_array(items, n);
     }
-    right->nodes.child[31] = NULL;
+    rrb_transient_t* transient = rrb_transient(rrb);
+    transient_push_items(transient, items, n);
+    return rrb_persistent(transient);
 }
 
-/** Balances a child tree. */
-void move_nodes(rrb_t* left, rrb_t* right) {
-    int i, j; size_t size = rrb_size(right);
-    for (i = rrb_size(left), j = 0; i < 32 && (size_t) j < size; i++, j++) {
-        left->nodes.child[i] = right->nodes.child[j];
-        left->elements  += rrb_size(left->nodes.child[i]);
-        right->elements -= rrb_size(left->nodes.child[i]);
+/** Groups nodes 32 at a time under new parents, stored at the beginning of
+  * nodes. Returns the number of parents. */
+size_t group_nodes(rrb_node_t** nodes, size_t size) {
+    size_t parents = (size + 31) / 32;
+    for (size_t i = 0; i < parents; i++) {
+        int children = size - i * 32 < 32 ? size - i * 32 : 32;
+        nodes[i] = create_parent(&nodes[i * 32], children);
     }
+    return parents;
+}
 
-    for (i = 0; j < 32; i++, j++) {
-        right->nodes.child[i] = right->nodes.child[j];
-        right->nodes.child[j] = NULL;
+/** Builds dense trees bottom-up from leaves full leafs of items: each level
+  * groups 32 nodes of the level below, until a single node remains, at least
+  * at the given level. The trees are stored at the beginning of nodes, which
+  * has room for a node per leaf. Returns their number. */
+size_t build_tree(rrb_node_t** nodes, imc_data_t** items, size_t leaves, int level) {
+    for (size_t i = 0; i < leaves; i++) {
+        nodes[i] = leaf_from_items(&items[i * 32], 32);
     }
+    size_t size = leaves;
+    while (size > 1 || (size == 1 && nodes[0]->level < level)) {
+        size = group_nodes(nodes, size);
+    }
+    return size;
 }
 
-/** Merges three RRB-Tree and balances the result. */
-rrb_t* merge_balance(rrb_t* left, rrb_t* merged, rrb_t* right) {
-    int last = find_last_index(left);
-    if (last < 31) {
-        move_nodes(left, merged);
+/** Creates a vector around a tree built from n items, the last 1 to 32 of
+  * them going into the tail as after pushes. */
+rrb_t* head_from_items(rrb_node_t* root, imc_data_t** items, size_t n) {
+    int tail_size = (n - 1) % 32 + 1;
+    rrb_t* rrb = create_head(root, tail_size);
+    rrb->tail_size = tail_size;
+    memcpy(rrb->tail, &items[n - tail_size], tail_size * sizeof *items);
+    return rrb;
+}
+
+/** Creates a vector from n items, with a tree built bottom-up. */
+rrb_t* rrb_from_array(imc_data_t** items, size_t n) {
+    if (n == 0) {
+        return rrb_create();
     }
-    move_nodes(merged, right);
-    rrb_t* parent = create_w_nodes();
-    parent->level = left->level + 1;
-    parent->nodes.child[0] = left;
-    parent->nodes.child[1] = merged;
-    if (right->nodes.child[0] != NULL) {
-        parent->nodes.child[2] = right;
-        parent->elements = rrb_size(left) + rrb_size(merged) + rrb_size(right);
-    } else {
-        dec_ref(right);
-        parent->elements = rrb_size(left) + rrb_size(merged);
+
+    size_t leaves = (n - 1) / 32;
+    rrb_node_t** nodes = malloc(leaves * sizeof *nodes);
+    size_t size = build_tree(nodes, items, leaves, 0);
+    rrb_t* rrb = head_from_items(size == 1 ? nodes[0] : NULL, items, n);
+    free(nodes);
+    return rrb;
+}
+
+/** Makes the tail of the vector the current leaf of an iterator. */
+void iterator_set_tail(rrb_iterator_t* iterator) {
+    iterator->leaf = (imc_data_t**) iterator->rrb->tail;
+    iterator->leaf_start = node_size(iterator->rrb->root);
+    iterator->leaf_size = iterator->rrb->tail_size;
+}
+
+/** Goes down from a node to its first or its last leaf, filling the path of
+  * an iterator, and makes the leaf the current one. */
+void iterator_descend(rrb_iterator_t* iterator, const rrb_node_t* rrb, bool last) {
+    while (contains_nodes(rrb)) {
+        int where = last == true ? used_slots(rrb) - 1 : 0;
+        iterator->path[rrb->level] = rrb;
+        iterator->where[rrb->level] = where;
+        rrb = rrb->nodes[where].child;
     }
-    return parent;
+    iterator->leaf = (imc_data_t**) rrb->nodes;
+    iterator->leaf_size = rrb->elements;
 }
 
-/** Merges two RRB-Tree into one. */
-rrb_t* merge(const rrb_t* left, const rrb_t* right) {
-    rrb_t* n_left  = copy_node(left);
-    rrb_t* n_right = copy_node(right);
-    if (contains_leafs(n_left)) {
-        return merge_leaves(n_left, n_right);
+/** Moves an iterator to the leaf after the current one, or to the tail. */
+void iterator_next_leaf(rrb_iterator_t* iterator) {
+    int start = iterator->leaf_start + iterator->leaf_size;
+    const rrb_node_t* root = iterator->rrb->root;
+    for (int level = 2; level <= root->level; level++) {
+        const rrb_node_t* rrb = iterator->path[level];
+        if (iterator->where[level] < used_slots(rrb) - 1) {
+            int where = ++iterator->where[level];
+            iterator_descend(iterator, rrb->nodes[where].child, false);
+            iterator->leaf_start = start;
+            return;
+        }
+    }
+    iterator_set_tail(iterator);
+}
+
+/** Moves an iterator to the leaf before the current one. */
+void iterator_prev_leaf(rrb_iterator_t* iterator) {
+    int end = iterator->leaf_start;
+    const rrb_node_t* root = iterator->rrb->root;
+    if (iterator->leaf == (imc_data_t**) iterator->rrb->tail) {
+        iterator_descend(iterator, root, true);
     } else {
-        int last = find_last_index(n_left);
-        rrb_t* merged = merge(n_left->nodes.child[last], n_right->nodes.child[0]);
-        delete_first_n_last(n_left, n_right, last);
-        return merge_balance(n_left, merged, n_right);
+        for (int level = 2; level <= root->level; level++) {
+            const rrb_node_t* rrb = iterator->path[level];
+            if (iterator->where[level] > 0) {
+                int where = --iterator->where[level];
+                iterator_descend(iterator, rrb->nodes[where].child, true);
+                break;
+            }
+        }
     }
+    iterator->leaf_start = end - iterator->leaf_size;
 }
 
-/** Creates a parent for a node. */
-rrb_t* create_parent(const rrb_t* child) {
-    rrb_t* n_child = copy_node(child);
-    rrb_t* parent = create_w_nodes();
-    parent->level = n_child->level + 1;
-    parent->nodes.child[0] = n_child;
-    parent->elements = rrb_size(n_child);
-    n_child->full = true;
-    return parent;
+/** Creates an iterator at the beginning of a vector. */
+rrb_iterator_t* rrb_iterator(const rrb_t* rrb) {
+    rrb_iterator_t* iterator = malloc(sizeof *iterator);
+    iterator->rrb = rrb;
+    return rrb_iterator_seek(iterator, 0);
+}
+
+/** Moves an iterator before index, by looking for its leaf from the root. */
+rrb_iterator_t* rrb_iterator_seek(rrb_iterator_t* iterator, int index) {
+    const rrb_t* rrb = iterator->rrb;
+    if (index < 0 || (size_t) index > rrb_size(rrb)) {
+        return NULL;
+    }
+
+    iterator->position = index;
+    if ((size_t) index >= node_size(rrb->root)) {
+        iterator_set_tail(iterator);
+        return iterator;
+    }
+    const rrb_node_t* node = rrb->root;
+    while (contains_nodes(node)) {
+        int where = place_in_child(node, &index);
+        iterator->path[node->level] = node;
+        iterator->where[node->level] = where;
+        node = node->nodes[where].child;
+    }
+    iterator->leaf = (imc_data_t**) node->nodes;
+    iterator->leaf_start = iterator->position - index;
+    iterator->leaf_size = node->elements;
+    return iterator;
+}
+
+/** Gets the rest of the current leaf, or the next leaf if it is over. */
+int rrb_iterator_next(rrb_iterator_t* iterator, imc_data_t*** chunk) {
+    if ((size_t) iterator->position == rrb_size(iterator->rrb)) {
+        return 0;
+    } else if (iterator->position == iterator->leaf_start + iterator->leaf_size) {
+        iterator_next_leaf(iterator);
+    }
+    int size = iterator->leaf_start + iterator->leaf_size - iterator->position;
+    *chunk = &iterator->leaf[iterator->position - iterator->leaf_start];
+    iterator->position += size;
+    return size;
+}
+
+/** Gets the beginning of the current leaf, or the previous leaf if the
+  * iterator is at its beginning. */
+int rrb_iterator_prev(rrb_iterator_t* iterator, imc_data_t*** chunk) {
+    if (iterator->position == 0) {
+        return 0;
+    } else if (iterator->position == iterator->leaf_start) {
+        iterator_prev_leaf(iterator);
+    }
+    int size = iterator->position - iterator->leaf_start;
+    *chunk = iterator->leaf;
+    iterator->position -= size;
+    return size;
 }
 
-/** Adds a child to a node. */
-void add_child(rrb_t* parent, rrb_t* child, bool first) {
-    int index = first == false ? 1 : 0;
-    if (child->level == parent->level - 1) {
-        inc_ref(child);
-        parent->nodes.child[index] = child;
+/** Frees an iterator. */
+void rrb_iterator_free(rrb_iterator_t* iterator) {
+    free(iterator);
+}
+
+/** Maps a tree into a new tree of the same shape. */
+rrb_node_t* map(const rrb_node_t* rrb, rrb_map_fn fn, void* ctx) {
+    int size = used_slots(rrb);
+    rrb_node_t* clone = alloc_node(rrb->level, size, rrb->meta != NULL);
+    clone_info(clone, rrb);
+    if (contains_leafs(rrb)) {
+        for (int i = 0; i < size; i++) {
+            clone->nodes[i].leaf = fn(rrb->nodes[i].leaf, ctx);
+        }
     } else {
-        parent->nodes.child[index] = create_w_nodes();
-        parent->nodes.child[index]->level = parent->level - 1;
-        add_child(parent->nodes.child[index], child, true);
+        clone_meta(clone, rrb);
+        for (int i = 0; i < size; i++) {
+            clone->nodes[i].child = map(rrb->nodes[i].child, fn, ctx);
+        }
     }
-    parent->elements += rrb_size(child);
+    return clone;
 }
 
-/** Adds child as a node. */
-rrb_t* add_as_child(const rrb_t* parent, rrb_t* child) {
-    int last = find_last_index(parent);
-    if (last == 31) {
-        rrb_t* n_parent = create_parent(parent);
-        add_child(n_parent, child, false);
-        return n_parent;
+/** Maps a vector, its tree then its tail. */
+rrb_t* rrb_map(const rrb_t* rrb, rrb_map_fn fn, void* ctx) {
+    rrb_t* mapped = create_head(rrb->root == NULL ? NULL : map(rrb->root, fn, ctx),
+        rrb->tail_size);
+    for (int i = 0; i < rrb->tail_size; i++) {
+        mapped->tail[i] = fn(rrb->tail[i], ctx);
     }
+    mapped->tail_size = rrb->tail_size;
+    return mapped;
+}
 
-    rrb_t* n_parent = copy_node(parent);
-    n_parent->nodes.child[last]->full = true;
-    n_parent->elements += rrb_size(child);
-    if (child->level == parent->level - 1) {
-        n_parent->nodes.child[last + 1] = child;
-        inc_ref(child);
+/** Filters a vector chunk by chunk into a transient. */
+rrb_t* rrb_filter(const rrb_t* rrb, rrb_filter_fn pred, void* ctx) {
+    rrb_t* empty = rrb_create();
+    rrb_transient_t* transient = rrb_transient(empty);
+    rrb_unref(empty);
+
+    rrb_iterator_t iterator = { .rrb = rrb };
+    rrb_iterator_seek(&iterator, 0);
+    imc_data_t** chunk;
+    for (int size; (size = rrb_iterator_next(&iterator, &chunk)) > 0;) {
+        imc_data_t* kept[32];
+        int count = 0;
+        for (int i = 0; i < size; i++) {
+            if (pred(chunk[i], ctx) == true) {
+                kept[count++] = chunk[i];
+            }
+        }
+        transient_push_items(transient, kept, count);
+    }
+    return rrb_persistent(transient);
+}
+
+/** Folds a vector chunk by chunk. */
+void* rrb_fold(const rrb_t* rrb, rrb_fold_fn fn, void* acc, void* ctx) {
+    rrb_iterator_t iterator = { .rrb = rrb };
+    rrb_iterator_seek(&iterator, 0);
+    imc_data_t** chunk;
+    for (int size; (size = rrb_iterator_next(&iterator, &chunk)) > 0;) {
+        for (int i = 0; i < size; i++) {
+            acc = fn(acc, chunk[i], ctx);
+        }
+    }
+    return acc;
+}
+
+/** Folds a tree, leaf by leaf. */
+void* fold(const rrb_node_t* rrb, rrb_fold_fn fn, void* acc, void* ctx) {
+    if (contains_leafs(rrb)) {
+        for (int i = 0; i < rrb->elements; i++) {
+            acc = fn(acc, rrb->nodes[i].leaf, ctx);
+        }
     } else {
-        n_parent->nodes.child[last + 1] = create_w_nodes();
-        n_parent->nodes.child[last + 1]->level = parent->level - 1;
-        add_child(parent->nodes.child[last + 1], child, true);
+        for (int i = 0; i < used_slots(rrb); i++) {
+            acc = fold(rrb->nodes[i].child, fn, acc, ctx);
+        }
     }
-    return n_parent;
+    return acc;
 }
 
-/** Merges two RRB-Tree into one, and returns it. */
-rrb_t* rrb_merge(rrb_t* left, rrb_t* right) {
-    if (left->level > right->level) {
-        return add_as_child(left, right);
-    } else if (left->level < right->level) {
-        return add_as_child(right, left);
+/** Argument of a task folding a subtree. */
+typedef struct _fold_task {
+    thread_pool_t* pool;
+    const rrb_node_t* rrb;
+    rrb_fold_fn fn;
+    rrb_combine_fn combine;
+    void* acc;    // The identity, then the result.
+    void* ctx;
+} fold_task_t;
+
+/** Folds a subtree, its children in parallel if it is big enough. */
+void par_fold(void* arg) {
+    fold_task_t* task = arg;
+    const rrb_node_t* rrb = task->rrb;
+    if (node_size(rrb) <= PARALLEL_GRAIN) {
+        task->acc = fold(rrb, task->fn, task->acc, task->ctx);
+        return;
     }
 
-    rrb_t* merged = merge(left, right);
-    if (merged->nodes.child[1] == NULL) {
-        rrb_t* temp = merged->nodes.child[0];
-        inc_ref(temp);
-        dec_ref(merged);
-        merged = temp;
+    int size = used_slots(rrb);
+    fold_task_t args[32];
+    thread_pool_task_t tasks[32];
+    for (int i = 0; i < size; i++) {
+        args[i] = *task;
+        args[i].rrb = rrb->nodes[i].child;
+        tasks[i] = (thread_pool_task_t) { par_fold, &args[i], false };
     }
-    consolidate_tree(&merged, true);
-    return merged;
+    thread_pool_run(task->pool, tasks, size);
+    task->acc = args[0].acc;
+    for (int i = 1; i < size; i++) {
+        task->acc = task->combine(task->acc, args[i].acc, task->ctx);
+    }
+}
+
+/** Folds the tree of a vector in parallel, then its tail. */
+void* rrb_par_fold(thread_pool_t* pool, const rrb_t* rrb, rrb_fold_fn fn,
+    rrb_combine_fn combine, void* identity, void* ctx) {
+    void* acc = identity;
+    if (rrb->root != NULL) {
+        fold_task_t task = { pool, rrb->root, fn, combine, identity, ctx };
+        par_fold(&task);
+        acc = task.acc;
+    }
+    for (int i = 0; i < rrb->tail_size; i++) {
+        acc = fn(acc, rrb->tail[i], ctx);
+    }
+    return acc;
+}
+
+/** Argument of a task mapping a subtree. */
+typedef struct _map_task {
+    thread_pool_t* pool;    // NULL to map in the current thread only.
+    const rrb_node_t* rrb;
+    rrb_map_fn fn;
+    void* ctx;
+    rrb_node_t* result;
+} map_task_t;
+
+/** Maps a subtree, its children in parallel if it is big enough. */
+void par_map(void* arg) {
+    map_task_t* task = arg;
+    const rrb_node_t* rrb = task->rrb;
+    if (task->pool == NULL || node_size(rrb) <= PARALLEL_GRAIN) {
+        task->result = map(rrb, task->fn, task->ctx);
+        return;
+    }
+
+    int size = used_slots(rrb);
+    map_task_t args[32];
+    thread_pool_task_t tasks[32];
+    for (int i = 0; i < size; i++) {
+        args[i] = *task;
+        args[i].rrb = rrb->nodes[i].child;
+        tasks[i] = (thread_pool_task_t) { par_map, &args[i], false };
+    }
+    thread_pool_run(task->pool, tasks, size);
+    rrb_node_t* clone = alloc_node(rrb->level, size, rrb->meta != NULL);
+    clone_info(clone, rrb);
+    clone_meta(clone, rrb);
+    for (int i = 0; i < size; i++) {
+        clone->nodes[i].child = args[i].result;
+    }
+    task->result = clone;
+}
+
+/** Maps the tree of a vector in parallel, then its tail. The scope of an
+  * arena is the current thread's, so the tree is mapped in it sequentially. */
+rrb_t* rrb_par_map(thread_pool_t* pool, const rrb_t* rrb, rrb_map_fn fn, void* ctx) {
+    map_task_t task = { imc_arena_scope != NULL ? NULL : pool, rrb->root, fn, ctx, NULL };
+    if (rrb->root != NULL) {
+        par_map(&task);
+    }
+    rrb_t* mapped = create_head(task.result, rrb->tail_size);
+    for (int i = 0; i < rrb->tail_size; i++) {
+        mapped->tail[i] = fn(rrb->tail[i], ctx);
+    }
+    mapped->tail_size = rrb->tail_size;
+    return mapped;
+}
+
+/** Argument of a task building a subtree of level 3. */
+typedef struct _build_task {
+    rrb_node_t** nodes;
+    imc_data_t** items;
+    size_t leaves;
+} build_task_t;
+
+/** Builds a subtree of level 3 from at most 1024 leafs. */
+void par_build(void* arg) {
+    build_task_t* task = arg;
+    build_tree(task->nodes, task->items, task->leaves, 3);
+}
+
+/** Creates a vector from n items. Subtrees of level 3, i.e. of 32768 items,
+  * are built in parallel, then grouped bottom-up. In an arena scope, the
+  * vector is built sequentially in it. */
+rrb_t* rrb_par_from_array(thread_pool_t* pool, imc_data_t** items, size_t n) {
+    size_t leaves = n == 0 ? 0 : (n - 1) / 32;
+    if (leaves <= 1024 || imc_arena_scope != NULL) {
+        return rrb_from_array(items, n);
+    }
+
+    size_t size = (leaves + 1023) / 1024;
+    rrb_node_t** nodes = malloc(leaves * sizeof *nodes);
+    build_task_t* args = malloc(size * sizeof *args);
+    thread_pool_task_t* tasks = malloc(size * sizeof *tasks);
+    for (size_t i = 0; i < size; i++) {
+        size_t rest = leaves - i * 1024;
+        args[i] = (build_task_t) { &nodes[i * 1024], &items[i * 32768], rest < 1024 ? rest : 1024 };
+        tasks[i] = (thread_pool_task_t) { par_build, &args[i], false };
+    }
+    thread_pool_run(pool, tasks, size);
+    for (size_t i = 0; i < size; i++) {
+        nodes[i] = nodes[i * 1024];
+    }
+    while (size > 1) {
+        size = group_nodes(nodes, size);
+    }
+
+    rrb_t* rrb = head_from_items(nodes[0], items, n);
+    free(tasks);
+    free(args);
+    free(nodes);
+    return rrb;
 }
@@ -1,120 +1,390 @@
-#pragma once
-
-// #include <vector.h>
-#include <stdlib.h>
-#include <stdbool.h>
-#include <stdio.h>
-
-typedef int imc_data_t;
-
-typedef struct _rrb {
-    int level;    // Depth of Node.
-    int ref;      // Number of elements pointing to it.
-    int elements; // Number of elements contained.
-    int *meta;    // Indicates if relaxed tree.
-    bool full;    // Indicates if the node is full.
-    union {
-        struct _rrb** child;
-        imc_data_t** leaf;
-    } nodes;   // Contains the lefs or the nodes.
-} rrb_t;
-
-/**
- * Prints the string provided if debug mode enabled.
- * @param  fmt The string which must be printed.
- * @return     None.
- */
-#define debug_print(fmt)                       \
-    do {                                       \
-        if (DEBUG) {                           \
-            fprintf(stderr, fmt);              \
-        }                                      \
-    } while (0)
-
-/**
- * Prints the string provided if debug mode enabled. Handle multiple args.
- * @param  fmt     The string which must be printed.
- * @param  VARARGS The other arguments.
- * @return         None.
- */
-#define debug_args(fmt, ...)                   \
-    do {                                       \
-        if (DEBUG) {                           \
-            fprintf(stderr, fmt, __VA_ARGS__); \
-        }                                      \
-    } while (0)
-
-/**
- * Creates an RRB-Tree.
- * @return A newly created RRB-Tree.
- */
-rrb_t* rrb_create();
-
-/**
- * Add an element to an RRB-Tree. As RRBs are immutable, a new version
- * is created and returned by the function.
- * @param  rrb  The RRB-Tree.
- * @param  data The data to insert into the RRB.
- * @return      A new RRB-Tree containing the data.
- */
-rrb_t* rrb_push(rrb_t* rrb, imc_data_t* data);
-
-/**
- * Pop the last element from an RRB-Tree. As RRBs are immutable, a new version
- * is created and returned. The element is returned as data.
- * @param  rrb  The RRB-Tree.
- * @param data  The removed data.
- * @return      The new tree resulting from pop.
- */
-rrb_t* rrb_pop(rrb_t* rrb, imc_data_t** data);
-
-/**
- * Takes an RRB-Tree, updates the data contained at the corresponding index,
- * and returns the corresponding new RRB.
- * @param  rrb   The RRB-Tree to update.
- * @param  index The index of the element to change.
- * @param  data  The new data which have to be put at index.
- * @return       The new corresponding RRB-Tree.
- */
-rrb_t* rrb_update(const rrb_t* rrb, int index, imc_data_t* data);
-
-/**
- * Looks for an element at the corresponding index into an RRB-Tree.
- * @param  rrb   The RRB-Tree to look in.
- * @param  index The index of the element to look.
- * @return       The element if any, else NULL.
- */
-imc_data_t* rrb_lookup(const rrb_t* rrb, int index);
-
-/**
- * Splits an RRB-Tree according to the given index.
- * @param  rrb   The RRB-Tree to split.
- * @param  left  The left RRB-Tree obtained.
- * @param  right The right RRB-Tree obtained.
- * @param  index The index where cut.
- * @return       0 if didn't work, 1 otherwise.
- */
-int rrb_split(const rrb_t* rrb, rrb_t** left, rrb_t** right, int index);
-
-/**
- * Merges two RRB-Tree into one.
- * @param  left  First RRB-Tree to merge.
- * @param  right Second RRB-Tree to merge.
- * @return       Resulting RRB-Tree.
- */
-rrb_t* rrb_merge(rrb_t* left, rrb_t* right);
-
-/**
- * Returns the size of an RRB-Tree.
- * @param  rrb The RRB-Tree to know the size.
- * @return     The size of the RRB-Tree if any, else -1.
- */
-size_t rrb_size(const rrb_t* rrb);
-
-/**
- * Decreases the references to an RRB-Tree.
- * If an RRB-Tree has no more references, frees it. Accessing to an element
- * after unref could not warranty what happened: probably a segmentation fault.
- * @param rrb The RRB-Tree to unref.
- */
-void rrb_unref(rrb_t* rrb);
+#pragma once
+
+// #include <vector.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "imc_thread_pool.h"
+#include "imc_reclaim.h"
+#include "imc_pool.h"
+#include "imc_arena.h"
+#include "imc_stats.h"
+#include "rrb_trace.h"
+
+#ifdef RRB_THREAD_SAFE
+#include <stdatomic.h>
+#endif
+
+typedef int imc_data_t;
+
+/**
+ * Reference count of a node. When built with RRB_THREAD_SAFE, it is atomic,
+ * and versions sharing nodes can be used and unref from different threads.
+ */
+#ifdef RRB_THREAD_SAFE
+typedef atomic_int rrb_ref_t;
+#else
+typedef int rrb_ref_t;
+#endif
+
+/**
+ * A node of the tree. The header, the children (or the leafs) and the meta
+ * share a single block. Nodes on the right edge of the tree are allocated
+ * with the slots they use only, and grow when copied.
+ */
+typedef struct _rrb_node {
+    int level;    // Depth of Node.
+    rrb_ref_t ref; // Number of elements pointing to it.
+    unsigned int owner; // Transient modifying it in place, 0 if none.
+    int elements; // Number of elements contained.
+    int slots;    // Number of children or leafs allocated in nodes.
+    int *meta;    // Cumulative sizes of the children, NULL if not relaxed.
+    bool full;    // Indicates if the node is full.
+    bool meta_room; // Indicates if the block has room for a meta.
+    union {
+        struct _rrb_node* child;
+        imc_data_t* leaf;
+    } nodes[];    // Contains the lefs or the nodes, then the meta.
+} rrb_node_t;
+
+/**
+ * A version of an RRB-Vector. The last elements are not stored in the tree,
+ * but in the tail: a push only copies the tail, and the tail goes down into
+ * the tree once it is full (i.e. once every 32 pushes). The tail is allocated
+ * with the elements it holds only.
+ */
+typedef struct _rrb {
+    rrb_node_t* root;      // The tree, NULL if every element is in the tail.
+    int tail_size;         // Number of elements in the tail.
+    int tail_slots;        // Number of elements the tail has room for.
+    imc_data_t* tail[];    // The last elements of the vector.
+} rrb_t;
+
+/**
+ * A vector under construction. The nodes tagged with the owner of the
+ * transient are only reachable from it, and are modified in place: only the
+ * nodes shared with persistent versions are copied, once. The tail of the
+ * transient always has room for 32 elements.
+ */
+typedef struct _rrb_transient {
+    rrb_t* rrb;            // The version being modified.
+    unsigned int owner;    // Tag of the nodes owned by the transient.
+} rrb_transient_t;
+
+/**
+ * A cursor between two elements of an RRB-Vector, which hands out the leafs
+ * one at a time. It keeps the path from the root to the current leaf, so
+ * moving to a neighbour leaf only climbs as high as needed. The tail is the
+ * last chunk. The vector must outlive the iterator.
+ */
+typedef struct _rrb_iterator {
+    const rrb_t* rrb;             // The vector iterated.
+    const rrb_node_t* path[8];    // Node of each level leading to the leaf.
+    int where[8];                 // Child taken in each node of the path.
+    imc_data_t** leaf;            // Elements of the current leaf, or the tail.
+    int leaf_start;               // Index of the first element of the leaf.
+    int leaf_size;                // Number of elements in the leaf.
+    int position;                 // Index of the next element.
+} rrb_iterator_t;
+
+/** Function applied to each element by rrb_map, with the context given. */
+typedef imc_data_t* (*rrb_map_fn)(imc_data_t* data, void* ctx);
+
+/** Function telling if rrb_filter keeps an element. */
+typedef bool (*rrb_filter_fn)(imc_data_t* data, void* ctx);
+
+/** Function combining the accumulator of rrb_fold with an element. */
+typedef void* (*rrb_fold_fn)(void* acc, imc_data_t* data, void* ctx);
+
+/** Function combining two accumulators of rrb_par_fold, left then right. */
+typedef void* (*rrb_combine_fn)(void* left, void* right, void* ctx);
+
+/**
+ * Sets the allocator of the nodes and versions, the pool by default. It must
+ * be set before the first vector is created.
+ * @param allocator The allocator.
+ */
+void rrb_set_allocator(const imc_allocator_t* allocator);
+
+/**
+ * Creates an RRB-Tree.
+ * @return A newly created RRB-Tree.
+ */
+rrb_t* rrb_create();
+
+/**
+ * Add an element to an RRB-Tree. As RRBs are immutable, a new version
+ * is created and returned by the function.
+ * @param  rrb  The RRB-Tree.
+ * @param  data The data to insert into the RRB.
+ * @return      A new RRB-Tree containing the data.
+ */
+rrb_t* rrb_push(rrb_t* rrb, imc_data_t* data);
+
+/**
+ * Adds several elements at the end of an RRB-Tree. The path to the end of the
+ * tree is copied only once, and the elements go in 32 at a time.
+ * @param  rrb   The RRB-Tree.
+ * @param  items The data to insert, in order.
+ * @param  n     The number of items.
+ * @return       A new RRB-Tree containing the items after the ones of rrb.
+ */
+rrb_t* rrb_push_many(const rrb_t* rrb, imc_data_t** items, size_t n);
+
+/**
+ * Creates an RRB-Tree from an array, building the tree from the leafs up.
+ * @param  items The data to insert, in order.
+ * @param  n     The number of items.
+ * @return       A newly created RRB-Tree containing the items.
+ */
+rrb_t* rrb_from_array(imc_data_t** items, size_t n);
+
+/**
+ * Pop the last element from an RRB-Tree. As RRBs are immutable, a new version
+ * is created and returned. The element is returned as data.
+ * @param  rrb  The RRB-Tree.
+ * @param data  The removed data.
+ * @return      The new tree resulting from pop, NULL if rrb is empty.
+ */
+rrb_t* rrb_pop(rrb_t* rrb, imc_data_t** data);
+
+/**
+ * Takes an RRB-Tree, updates the data contained at the corresponding index,
+ * and returns the corresponding new RRB.
+ * @param  rrb   The RRB-Tree to update.
+ * @param  index The index of the element to change.
+ * @param  data  The new data which have to be put at index.
+ * @return       The new corresponding RRB-Tree.
+ */
+rrb_t* rrb_update(const rrb_t* rrb, int index, imc_data_t* data);
+
+/**
+ * Looks for an element at the corresponding index into an RRB-Tree.
+ * @param  rrb   The RRB-Tree to look in.
+ * @param  index The index of the element to look.
+ * @return       The element if any, else NULL.
+ */
+imc_data_t* rrb_lookup(const rrb_t* rrb, int index);
+
+/**
+ * Splits an RRB-Tree according to the given index.
+ * @param  rrb   The RRB-Tree to split.
+ * @param  left  The left RRB-Tree obtained, ending with the element at index.
+ * @param  right The right RRB-Tree obtained.
+ * @param  index The index where cut.
+ * @return       0 if didn't work, 1 otherwise.
+ */
+int rrb_split(const rrb_t* rrb, rrb_t** left, rrb_t** right, int index);
+
+/**
+ * Keeps the first elements of an RRB-Tree. Every subtree not cut is shared
+ * with rrb.
+ * @param  rrb The RRB-Tree to take from.
+ * @param  n   The number of elements to keep.
+ * @return     The new RRB-Tree, NULL if n is out of rrb.
+ */
+rrb_t* rrb_take(const rrb_t* rrb, int n);
+
+/**
+ * Removes the first elements of an RRB-Tree. Every subtree not cut is shared
+ * with rrb.
+ * @param  rrb The RRB-Tree to drop from.
+ * @param  n   The number of elements to remove.
+ * @return     The new RRB-Tree, NULL if n is out of rrb.
+ */
+rrb_t* rrb_drop(const rrb_t* rrb, int n);
+
+/**
+ * Keeps the elements of an RRB-Tree between two indexes. Every subtree not
+ * cut is shared with rrb.
+ * @param  rrb  The RRB-Tree to slice.
+ * @param  from The index of the first element kept.
+ * @param  to   The index after the last element kept.
+ * @return      The new RRB-Tree, NULL if the indexes are out of rrb.
+ */
+rrb_t* rrb_slice(const rrb_t* rrb, int from, int to);
+
+/**
+ * Merges two RRB-Tree into one.
+ * @param  left  First RRB-Tree to merge.
+ * @param  right Second RRB-Tree to merge.
+ * @return       Resulting RRB-Tree.
+ */
+rrb_t* rrb_merge(rrb_t* left, rrb_t* right);
+
+/**
+ * Returns the size of an RRB-Tree.
+ * @param  rrb The RRB-Tree to know the size.
+ * @return     The size of the RRB-Tree if any, else -1.
+ */
+size_t rrb_size(const rrb_t* rrb);
+
+/**
+ * Decreases the references to an RRB-Tree.
+ * If an RRB-Tree has no more references, frees it. Accessing to an element
+ * after unref could not warranty what happened: probably a segmentation fault.
+ * @param rrb The RRB-Tree to unref.
+ */
+void rrb_unref(rrb_t* rrb);
+
+/**
+ * Promotes a version created in an arena scope, to keep it once the arena is
+ * freed: its nodes in arenas are copied, the others shared. It is called
+ * once the scope is left (in the enclosing scope, the copies go to its
+ * arena). Inside a scope, the parallel functions allocate in the current
+ * thread only.
+ * @param  rrb The RRB-Tree to promote.
+ * @return     A new RRB-Tree, with the same elements.
+ */
+rrb_t* rrb_promote(const rrb_t* rrb);
+
+/**
+ * Starts a transient from an RRB-Tree. rrb is left untouched, and can still
+ * be used and unref while the transient lives.
+ * @param  rrb The RRB-Tree to start from.
+ * @return     A transient containing the same elements.
+ */
+rrb_transient_t* rrb_transient(const rrb_t* rrb);
+
+/**
+ * Adds an element at the end of a transient, in place.
+ * @param  transient The transient.
+ * @param  data      The data to insert.
+ * @return           The transient.
+ */
+rrb_transient_t* rrb_transient_push(rrb_transient_t* transient, imc_data_t* data);
+
+/**
+ * Changes the element at index of a transient, in place.
+ * @param  transient The transient to update.
+ * @param  index     The index of the element to change.
+ * @param  data      The new data which have to be put at index.
+ * @return           The transient, NULL if index is out of it.
+ */
+rrb_transient_t* rrb_transient_update(rrb_transient_t* transient, int index, imc_data_t* data);
+
+/**
+ * Removes the last element of a transient, in place.
+ * @param  transient The transient.
+ * @param  data      The removed data.
+ * @return           The transient, NULL if it is empty.
+ */
+rrb_transient_t* rrb_transient_pop(rrb_transient_t* transient, imc_data_t** data);
+
+/**
+ * Ends a transient and turns it into an RRB-Tree. The transient is freed and
+ * must not be used anymore.
+ * @param  transient The transient to end.
+ * @return           The resulting RRB-Tree.
+ */
+rrb_t* rrb_persistent(rrb_transient_t* transient);
+
+/**
+ * Creates an iterator before the first element of an RRB-Tree.
+ * @param  rrb The RRB-Tree to iterate, which must outlive the iterator.
+ * @return     The iterator.
+ */
+rrb_iterator_t* rrb_iterator(const rrb_t* rrb);
+
+/**
+ * Moves an iterator before the element at index. Seeking to the size of the
+ * RRB-Tree allows to iterate in reverse.
+ * @param  iterator The iterator to move.
+ * @param  index    The index of the next element, from 0 to the size.
+ * @return          The iterator, NULL if index is out of the RRB-Tree.
+ */
+rrb_iterator_t* rrb_iterator_seek(rrb_iterator_t* iterator, int index);
+
+/**
+ * Gets the elements from the iterator to the end of their leaf, and moves
+ * the iterator after them.
+ * @param  iterator The iterator.
+ * @param  chunk    The elements, contiguous and at most 32.
+ * @return          The number of elements in chunk, 0 at the end.
+ */
+int rrb_iterator_next(rrb_iterator_t* iterator, imc_data_t*** chunk);
+
+/**
+ * Gets the elements from the beginning of their leaf to the iterator, and
+ * moves the iterator before them.
+ * @param  iterator The iterator.
+ * @param  chunk    The elements, contiguous and at most 32.
+ * @return          The number of elements in chunk, 0 at the beginning.
+ */
+int rrb_iterator_prev(rrb_iterator_t* iterator, imc_data_t*** chunk);
+
+/**
+ * Frees an iterator. The RRB-Tree is left untouched.
+ * @param iterator The iterator to free.
+ */
+void rrb_iterator_free(rrb_iterator_t* iterator);
+
+/**
+ * Applies a function to every element of an RRB-Tree. The result has the same
+ * shape as rrb, and is built leaf by leaf.
+ * @param  rrb The RRB-Tree to map.
+ * @param  fn  The function giving each new element.
+ * @param  ctx The context given to fn.
+ * @return     A new RRB-Tree holding the results, in order.
+ */
+rrb_t* rrb_map(const rrb_t* rrb, rrb_map_fn fn, void* ctx);
+
+/**
+ * Keeps the elements of an RRB-Tree satisfying a predicate. The leafs are
+ * read one at a time, and the elements kept go in 32 at a time.
+ * @param  rrb  The RRB-Tree to filter.
+ * @param  pred The predicate telling if an element is kept.
+ * @param  ctx  The context given to pred.
+ * @return      A new RRB-Tree holding the elements kept, in order.
+ */
+rrb_t* rrb_filter(const rrb_t* rrb, rrb_filter_fn pred, void* ctx);
+
+/**
+ * Combines every element of an RRB-Tree, from the first to the last, into an
+ * accumulator.
+ * @param  rrb The RRB-Tree to fold.
+ * @param  fn  The function giving the new accumulator from an element.
+ * @param  acc The initial accumulator.
+ * @param  ctx The context given to fn.
+ * @return     The final accumulator.
+ */
+void* rrb_fold(const rrb_t* rrb, rrb_fold_fn fn, void* acc, void* ctx);
+
+/**
+ * Applies a function to every element of an RRB-Tree, the subtrees being
+ * mapped in parallel by the pool. fn must be thread safe. In an arena scope,
+ * the subtrees are mapped sequentially.
+ * @param  pool The pool running the subtrees.
+ * @param  rrb  The RRB-Tree to map.
+ * @param  fn   The function giving each new element.
+ * @param  ctx  The context given to fn.
+ * @return      A new RRB-Tree holding the results, in order.
+ */
+rrb_t* rrb_par_map(thread_pool_t* pool, const rrb_t* rrb, rrb_map_fn fn, void* ctx);
+
+/**
+ * Folds an RRB-Tree, the subtrees being folded in parallel by the pool. Each
+ * subtree is folded from identity, then the results are combined in order.
+ * fn and combine must be thread safe, combine associative, and identity
+ * neutral for combine.
+ * @param  pool     The pool running the subtrees.
+ * @param  rrb      The RRB-Tree to fold.
+ * @param  fn       The function giving the new accumulator from an element.
+ * @param  combine  The function combining the results of two subtrees.
+ * @param  identity The initial accumulator of each subtree.
+ * @param  ctx      The context given to fn and combine.
+ * @return          The final accumulator.
+ */
+void* rrb_par_fold(thread_pool_t* pool, const rrb_t* rrb, rrb_fold_fn fn,
+    rrb_combine_fn combine, void* identity, void* ctx);
+
+/**
+ * Creates an RRB-Tree from an array, the subtrees being built in parallel by
+ * the pool. In an arena scope, it is built sequentially.
+ * @param  pool  The pool building the subtrees.
+ * @param  items The data to insert, in order.
+ * @param  n     The number of items.
+ * @return       A newly created RRB-Tree containing the items.
+ */
+rrb_t* rrb_par_from_array(thread_pool_t* pool, imc_data_t** items, size_t n);
@@ -2,42 +2,641 @@
 #include <stdlib.h>
 #include "../src/rrb_vector.h"
 
-START_TEST(rrb_create)
+START_TEST(rrb_create_test)
 {
-    imc_vector_t* rrb = imc_rrb_new();
+    rrb_t* rrb = rrb_create();
 
     // Check for the creation.
     ck_assert_ptr_ne(rrb, NULL);
+    ck_assert_int_eq(rrb_size(rrb), 0);
 
-    rrb->unref(rrb);
+    rrb_unref(rrb);
 }
 END_TEST
 
-START_TEST(rrb_push)
+START_TEST(rrb_push_test)
 {
-    imc_data_t* data   = malloc(sizeof *data);
-    imc_vector_t* rrb1 = imc_rrb_new();
+    imc_data_t* data = malloc(sizeof *data);
+    rrb_t* rrb1 = rrb_create();
 
-    // Check for the new AVL.
-    imc_vector_t* rrb2 = rrb1->push(rrb1, data);
+    // Check for the new RRB.
+    rrb_t* rrb2 = rrb_push(rrb1, data);
     ck_assert_ptr_ne(rrb2, NULL);
 
     // Check for the value.
-    imc_data_t* lookup = rrb2->lookup(rrb2, 1);
+    imc_data_t* lookup = rrb_lookup(rrb2, 0);
     ck_assert_ptr_eq(data, lookup);
 
     // Clean a little bit.
-    rrb1->unref(rrb1);
-    rrb2->unref(rrb2);
+    rrb_unref(rrb1);
+    rrb_unref(rrb2);
+    free(data);
+}
+END_TEST
+
+START_TEST(rrb_push_pop_test)
+{
+    int datas[2000];
+    rrb_t* rrb = rrb_create();
+
+    // Push through several tails, and check every version is untouched.
+    for (int i = 0; i < 2000; i++) {
+        datas[i] = i;
+        rrb_t* temp = rrb_push(rrb, &datas[i]);
+        ck_assert_int_eq(rrb_size(rrb), i);
+        rrb_unref(rrb);
+        rrb = temp;
+    }
+    for (int i = 0; i < 2000; i++) {
+        ck_assert_int_eq(*rrb_lookup(rrb, i), i);
+    }
+
+    // Pop back everything, the tail being refilled from the tree.
+    for (int i = 1999; i >= 0; i--) {
+        imc_data_t* data;
+        rrb_t* temp = rrb_pop(rrb, &data);
+        ck_assert_int_eq(*data, i);
+        ck_assert_int_eq(rrb_size(temp), i);
+        rrb_unref(rrb);
+        rrb = temp;
+    }
+    rrb_unref(rrb);
+}
+END_TEST
+
+START_TEST(rrb_transient_test)
+{
+    int datas[2000];
+    rrb_t* rrb = rrb_create();
+    for (int i = 0; i < 1000; i++) {
+        datas[i] = i;
+        rrb_t* temp = rrb_push(rrb, &datas[i]);
+        rrb_unref(rrb);
+        rrb = temp;
+    }
+
+    // Fill, change and shrink a transient built on rrb.
+    rrb_transient_t* transient = rrb_transient(rrb);
+    for (int i = 1000; i < 2000; i++) {
+        datas[i] = i;
+        ck_assert_ptr_eq(rrb_transient_push(transient, &datas[i]), transient);
+    }
+    for (int i = 0; i < 2000; i += 7) {
+        ck_assert_ptr_eq(rrb_transient_update(transient, i, &datas[1999 - i]), transient);
+    }
+    ck_assert_ptr_eq(rrb_transient_update(transient, 2000, &datas[0]), NULL);
+    for (int i = 1999; i >= 1500; i--) {
+        imc_data_t* data;
+        ck_assert_ptr_eq(rrb_transient_pop(transient, &data), transient);
+        ck_assert_int_eq(*data, i % 7 == 0 ? 1999 - i : i);
+    }
+    rrb_t* result = rrb_persistent(transient);
+
+    // Check the result, and that rrb is untouched.
+    ck_assert_int_eq(rrb_size(result), 1500);
+    for (int i = 0; i < 1500; i++) {
+        ck_assert_int_eq(*rrb_lookup(result, i), i % 7 == 0 ? 1999 - i : i);
+    }
+    ck_assert_int_eq(rrb_size(rrb), 1000);
+    for (int i = 0; i < 1000; i++) {
+        ck_assert_int_eq(*rrb_lookup(rrb, i), i);
+    }
+    rrb_unref(result);
+    rrb_unref(rrb);
+}
+END_TEST
+
+START_TEST(rrb_merge_test)
+{
+    static int datas[100000];
+    for (int i = 0; i < 100000; i++) {
+        datas[i] = i;
+    }
+
+    // Concatenate 3000 vectors of uneven sizes, in both directions.
+    rrb_t* rrb = rrb_create();
+    int total = 0;
+    for (int i = 0, size = 0; i < 3000; i++, total += size) {
+        size = (i * 37) % 61;
+        rrb_t* part = rrb_create();
+        for (int j = total; j < total + size; j++) {
+            rrb_t* temp = rrb_push(part, &datas[j]);
+            rrb_unref(part);
+            part = temp;
+        }
+        rrb_t* temp = i % 2 == 0 ? rrb_merge(rrb, part) : rrb_merge(part, rrb);
+        ck_assert_int_eq(rrb_size(temp), rrb_size(rrb) + size);
+        rrb_unref(rrb);
+        rrb_unref(part);
+        rrb = temp;
+    }
+    ck_assert_int_eq(rrb_size(rrb), total);
+    ck_assert_int_le(rrb->root->level, 4);
+
+    // The elements of the odd parts are before the ones of the even parts.
+    int index = 0;
+    for (int i = 2999, start = total; i >= 0; i--) {
+        int size = (i * 37) % 61;
+        start -= size;
+        if (i % 2 == 1) {
+            for (int j = start; j < start + size; j++) {
+                ck_assert_int_eq(*rrb_lookup(rrb, index++), j);
+            }
+        }
+    }
+    for (int i = 0, start = 0; i < 3000; i++) {
+        int size = (i * 37) % 61;
+        if (i % 2 == 0) {
+            for (int j = start; j < start + size; j++) {
+                ck_assert_int_eq(*rrb_lookup(rrb, index++), j);
+            }
+        }
+        start += size;
+    }
+
+    // The merged tree can still be pushed, updated and popped.
+    rrb_t* pushed  = rrb_push(rrb, &datas[total]);
+    rrb_t* updated = rrb_update(pushed, total / 2, &datas[total + 1]);
+    ck_assert_int_eq(*rrb_lookup(updated, total / 2), total + 1);
+    ck_assert_int_eq(*rrb_lookup(updated, total), total);
+    ck_assert_int_eq(*rrb_lookup(pushed, total / 2), *rrb_lookup(rrb, total / 2));
+    for (int i = total; i >= total - 1000; i--) {
+        imc_data_t* data;
+        rrb_t* temp = rrb_pop(updated, &data);
+        ck_assert_ptr_eq(data, rrb_lookup(pushed, i));
+        rrb_unref(updated);
+        updated = temp;
+    }
+    rrb_unref(updated);
+    rrb_unref(pushed);
+    rrb_unref(rrb);
+}
+END_TEST
+
+START_TEST(rrb_slice_test)
+{
+    int datas[3000];
+    rrb_t* dense = rrb_create();
+    for (int i = 0; i < 3000; i++) {
+        datas[i] = i;
+        rrb_t* temp = rrb_push(dense, &datas[i]);
+        rrb_unref(dense);
+        dense = temp;
+    }
+    // A relaxed tree with the same elements.
+    rrb_t* left  = rrb_take(dense, 1000);
+    rrb_t* right = rrb_drop(dense, 1000);
+    rrb_t* relaxed = rrb_merge(left, right);
+    rrb_unref(left);
+    rrb_unref(right);
+
+    ck_assert_ptr_eq(rrb_take(dense, 3001), NULL);
+    ck_assert_ptr_eq(rrb_drop(dense, -1), NULL);
+    ck_assert_ptr_eq(rrb_slice(dense, 20, 10), NULL);
+
+    rrb_t* rrbs[2] = { dense, relaxed };
+    for (int k = 0; k < 2; k++) {
+        for (int from = 0; from <= 3000; from += 331) {
+            for (int to = from; to <= 3000; to += 127) {
+                rrb_t* slice = rrb_slice(rrbs[k], from, to);
+                ck_assert_int_eq(rrb_size(slice), to - from);
+                for (int i = 0; i < to - from; i++) {
+                    ck_assert_int_eq(*rrb_lookup(slice, i), from + i);
+                }
+                // Slices can still grow and shrink.
+                rrb_t* pushed = rrb_push(slice, &datas[0]);
+                ck_assert_int_eq(*rrb_lookup(pushed, to - from), 0);
+                rrb_unref(slice);
+                for (int i = to - from - 1; i >= 0; i -= 1) {
+                    imc_data_t* data;
+                    rrb_t* temp = rrb_pop(pushed, &data);
+                    rrb_unref(pushed);
+                    pushed = temp;
+                    ck_assert_int_eq(*rrb_lookup(pushed, i), from + i);
+                }
+                rrb_unref(pushed);
+            }
+        }
+    }
+
+    // The split puts the element at index at the end of left.
+    ck_assert_int_eq(rrb_split(relaxed, &left, &right, 2999), 1);
+    ck_assert_int_eq(rrb_size(left), 3000);
+    ck_assert_int_eq(rrb_size(right), 0);
+    rrb_unref(left);
+    rrb_unref(right);
+    ck_assert_int_eq(rrb_split(relaxed, &left, &right, 1500), 1);
+    ck_assert_int_eq(*rrb_lookup(left, 1500), 1500);
+    ck_assert_int_eq(*rrb_lookup(right, 0), 1501);
+    rrb_unref(left);
+    rrb_unref(right);
+    ck_assert_int_eq(rrb_split(relaxed, &left, &right, 3000), 0);
+
+    rrb_unref(relaxed);
+    rrb_unref(dense);
+}
+END_TEST
+
+START_TEST(rrb_push_many_test)
+{
+    static int datas[40000];
+    static imc_data_t* items[40000];
+    for (int i = 0; i < 40000; i++) {
+        datas[i] = i;
+        items[i] = &datas[i];
+    }
+
+    // Vectors built at once are dense, with the last items in the tail.
+    int sizes[] = { 0, 1, 32, 33, 1024, 1025, 40000 };
+    for (int k = 0; k < 7; k++) {
+        rrb_t* rrb = rrb_from_array(items, sizes[k]);
+        ck_assert_int_eq(rrb_size(rrb), sizes[k]);
+        ck_assert(rrb->root == NULL || rrb->root->meta == NULL);
+        for (int i = 0; i < sizes[k]; i++) {
+            ck_assert_int_eq(*rrb_lookup(rrb, i), i);
+        }
+        rrb_unref(rrb);
+    }
+
+    // Blocks pushed after a tree and a tail, rrb being left untouched.
+    rrb_t* rrb = rrb_from_array(items, 1000);
+    for (int n = 0; n < 2000; n += 77) {
+        rrb_t* pushed = rrb_push_many(rrb, &items[1000], n);
+        ck_assert_int_eq(rrb_size(pushed), 1000 + n);
+        for (int i = 0; i < 1000 + n; i++) {
+            ck_assert_int_eq(*rrb_lookup(pushed, i), i);
+        }
+        rrb_t* temp = rrb_push(pushed, items[0]);
+        ck_assert_int_eq(*rrb_lookup(temp, 1000 + n), 0);
+        rrb_unref(temp);
+        rrb_unref(pushed);
+    }
+    ck_assert_int_eq(rrb_size(rrb), 1000);
+    rrb_unref(rrb);
+}
+END_TEST
+
+START_TEST(rrb_iterator_test)
+{
+    static int datas[5000];
+    static imc_data_t* items[5000];
+    for (int i = 0; i < 5000; i++) {
+        datas[i] = i;
+        items[i] = &datas[i];
+    }
+    // Dense vectors, and a relaxed one made of uneven parts.
+    rrb_t* rrbs[4] = {
+        rrb_create(), rrb_from_array(items, 20), rrb_from_array(items, 5000)
+    };
+    rrb_t* left  = rrb_slice(rrbs[2], 0, 1234);
+    rrb_t* right = rrb_slice(rrbs[2], 1234, 5000);
+    rrbs[3] = rrb_merge(left, right);
+    rrb_unref(left);
+    rrb_unref(right);
+
+    for (int k = 0; k < 4; k++) {
+        int size = rrb_size(rrbs[k]);
+        rrb_iterator_t* iterator = rrb_iterator(rrbs[k]);
+        imc_data_t** chunk;
+        int index = 0;
+        for (int n; (n = rrb_iterator_next(iterator, &chunk)) > 0;) {
+            ck_assert_int_le(n, 32);
+            for (int i = 0; i < n; i++) {
+                ck_assert_int_eq(*chunk[i], index++);
+            }
+        }
+        ck_assert_int_eq(index, size);
+
+        // Backward from the end, then from and to the middle of a leaf.
+        for (int n; (n = rrb_iterator_prev(iterator, &chunk)) > 0;) {
+            index -= n;
+            for (int i = 0; i < n; i++) {
+                ck_assert_int_eq(*chunk[i], index + i);
+            }
+        }
+        ck_assert_int_eq(index, 0);
+        ck_assert_ptr_eq(rrb_iterator_seek(iterator, size + 1), NULL);
+        ck_assert_ptr_eq(rrb_iterator_seek(iterator, size / 2), iterator);
+        if (size > 0) {
+            ck_assert_int_gt(rrb_iterator_next(iterator, &chunk), 0);
+            ck_assert_int_eq(*chunk[0], size / 2);
+            rrb_iterator_seek(iterator, size / 2 + 1);
+            ck_assert_int_gt(rrb_iterator_prev(iterator, &chunk), 0);
+            ck_assert_int_eq(*chunk[size / 2 - iterator->position], size / 2);
+        }
+        rrb_iterator_free(iterator);
+        rrb_unref(rrbs[k]);
+    }
+}
+END_TEST
+
+/** Gives the data following data in the array ctx. */
+imc_data_t* next_data(imc_data_t* data, void* ctx) {
+    return &((int*) ctx)[*data + 1];
+}
+
+/** Keeps the multiples of 3. */
+bool is_multiple(imc_data_t* data, void* ctx) {
+    (void) ctx;
+    return *data % 3 == 0;
+}
+
+/** Sums the datas, and counts them in ctx. */
+void* sum_datas(void* acc, imc_data_t* data, void* ctx) {
+    *(int*) ctx += 1;
+    return (void*) ((long) acc + *data);
+}
+
+START_TEST(rrb_bulk_test)
+{
+    static int datas[5001];
+    static imc_data_t* items[5000];
+    for (int i = 0; i < 5001; i++) {
+        datas[i] = i;
+    }
+    for (int i = 0; i < 5000; i++) {
+        items[i] = &datas[i];
+    }
+    rrb_t* rrbs[3] = { rrb_create(), rrb_from_array(items, 5000) };
+    rrb_t* left  = rrb_slice(rrbs[1], 0, 777);
+    rrb_t* right = rrb_slice(rrbs[1], 777, 5000);
+    rrbs[2] = rrb_merge(left, right);
+    rrb_unref(left);
+    rrb_unref(right);
+
+    for (int k = 0; k < 3; k++) {
+        int size = rrb_size(rrbs[k]);
+        rrb_t* mapped = rrb_map(rrbs[k], next_data, datas);
+        ck_assert_int_eq(rrb_size(mapped), size);
+        for (int i = 0; i < size; i++) {
+            ck_assert_int_eq(*rrb_lookup(mapped, i), i + 1);
+        }
+
+        rrb_t* filtered = rrb_filter(rrbs[k], is_multiple, NULL);
+        ck_assert_int_eq(rrb_size(filtered), (size + 2) / 3);
+        for (int i = 0; i < (size + 2) / 3; i++) {
+            ck_assert_int_eq(*rrb_lookup(filtered, i), i * 3);
+        }
+
+        int count = 0;
+        long sum = (long) rrb_fold(mapped, sum_datas, (void*) 0, &count);
+        ck_assert_int_eq(count, size);
+        ck_assert_int_eq(sum, (long) size * (size + 1) / 2);
+
+        rrb_unref(filtered);
+        rrb_unref(mapped);
+        rrb_unref(rrbs[k]);
+    }
+}
+END_TEST
+
+/** Adds two sums. */
+void* add_sums(void* left, void* right, void* ctx) {
+    (void) ctx;
+    return (void*) ((long) left + (long) right);
+}
+
+/** Sums the datas. */
+void* add_data(void* acc, imc_data_t* data, void* ctx) {
+    (void) ctx;
+    return (void*) ((long) acc + *data);
+}
+
+START_TEST(rrb_parallel_test)
+{
+    static int datas[300001];
+    static imc_data_t* items[300000];
+    for (int i = 0; i < 300001; i++) {
+        datas[i] = i;
+    }
+    for (int i = 0; i < 300000; i++) {
+        items[i] = &datas[i];
+    }
+    thread_pool_t* pool = thread_pool_create(4);
+
+    // A dense vector built in parallel, and a relaxed one.
+    rrb_t* rrbs[2] = { rrb_par_from_array(pool, items, 300000) };
+    rrb_t* left  = rrb_slice(rrbs[0], 0, 123457);
+    rrb_t* right = rrb_slice(rrbs[0], 123457, 300000);
+    rrbs[1] = rrb_merge(left, right);
+    rrb_unref(left);
+    rrb_unref(right);
+    ck_assert(rrbs[0]->root->meta == NULL);
+
+    for (int k = 0; k < 2; k++) {
+        ck_assert_int_eq(rrb_size(rrbs[k]), 300000);
+        rrb_t* mapped = rrb_par_map(pool, rrbs[k], next_data, datas);
+        ck_assert_int_eq(rrb_size(mapped), 300000);
+        for (int i = 0; i < 300000; i++) {
+            ck_assert_int_eq(*rrb_lookup(rrbs[k], i), i);
+            ck_assert_int_eq(*rrb_lookup(mapped, i), i + 1);
+        }
+        long sum = (long) rrb_par_fold(pool, mapped, add_data, add_sums, (void*) 0, NULL);
+        ck_assert_int_eq(sum, 300000L * 300001 / 2);
+        rrb_unref(mapped);
+        rrb_unref(rrbs[k]);
+    }
+    thread_pool_free(pool);
+}
+END_TEST
+
+START_TEST(rrb_reclaim_test)
+{
+    static int datas[100000];
+    static imc_data_t* items[100000];
+    for (int i = 0; i < 100000; i++) {
+        datas[i] = i;
+        items[i] = &datas[i];
+    }
+
+    // At most 4 nodes freed per call, the shared ones stay alive.
+    imc_reclaim_set_budget(4);
+    rrb_t* rrb   = rrb_from_array(items, 100000);
+    rrb_t* slice = rrb_slice(rrb, 0, 50000);
+    rrb_unref(rrb);
+    ck_assert(imc_reclaim_pending() > 0);
+    for (int i = 0; i < 50000; i++) {
+        ck_assert_int_eq(*rrb_lookup(slice, i), i);
+    }
+    rrb_unref(slice);
+    imc_reclaim_drain();
+    ck_assert_int_eq(imc_reclaim_pending(), 0);
+    imc_reclaim_set_budget(0);
+
+    // Freed by the background thread, refused without atomic counts.
+#ifdef RRB_THREAD_SAFE
+    ck_assert(imc_reclaim_start());
+    for (int k = 0; k < 8; k++) {
+        rrb_unref(rrb_from_array(items, 100000));
+    }
+    imc_reclaim_stop();
+#else
+    ck_assert(imc_reclaim_start() == false);
+#endif
+    ck_assert_int_eq(imc_reclaim_pending(), 0);
+}
+END_TEST
+
+START_TEST(rrb_arena_test)
+{
+    static int datas[5000];
+    static imc_data_t* items[5000];
+    for (int i = 0; i < 5000; i++) {
+        datas[i] = i;
+        items[i] = &datas[i];
+    }
+    rrb_t* base = rrb_from_array(items, 4000);
+
+    // Temporaries of the scope are never unref, the last one is kept.
+    imc_arena_t* arena = imc_arena_create();
+    imc_arena_enter(arena);
+    rrb_t* rrb = base;
+    for (int i = 0; i < 1000; i++) {
+        rrb = rrb_update(rrb, i * 4, &datas[i * 4 + 1000]);
+        rrb = rrb_push(rrb, &datas[4000 + i]);
+    }
+    rrb_t* left = rrb_slice(rrb, 0, 2500);
+    rrb = rrb_merge(left, rrb_slice(rrb, 2500, 5000));
+    imc_arena_leave();
+    ck_assert(imc_arena_used(arena) > 0);
+    rrb_t* kept = rrb_promote(rrb);
+    imc_arena_free(arena);
+
+    ck_assert_int_eq(rrb_size(kept), 5000);
+    for (int i = 0; i < 5000; i++) {
+        ck_assert_int_eq(*rrb_lookup(kept, i), i < 4000 && i % 4 == 0 ? i + 1000 : i);
+    }
+    for (int i = 0; i < 4000; i++) {
+        ck_assert_int_eq(*rrb_lookup(base, i), i);
+    }
+    rrb_unref(kept);
+    ck_assert_int_eq(base->root->ref, 1);
+    rrb_unref(base);
+}
+END_TEST
+
+/** Counts the nodes of a tree holding a reference, i.e. out of the arenas. */
+int counted_nodes(const rrb_node_t* rrb) {
+    int count = rrb->ref != 0;
+    for (int i = 0; rrb->level > 1 && i < rrb->slots && rrb->nodes[i].child != NULL; i++) {
+        count += counted_nodes(rrb->nodes[i].child);
+    }
+    return count;
+}
+
+START_TEST(rrb_arena_parallel_test)
+{
+    static int datas[300001];
+    static imc_data_t* items[300000];
+    for (int i = 0; i < 300001; i++) {
+        datas[i] = i;
+    }
+    for (int i = 0; i < 300000; i++) {
+        items[i] = &datas[i];
+    }
+    thread_pool_t* pool = thread_pool_create(4);
+
+    // The workers are out of the scope, every node must still be in the arena.
+    imc_arena_t* arena = imc_arena_create();
+    imc_arena_enter(arena);
+    rrb_t* rrb = rrb_par_from_array(pool, items, 300000);
+    rrb = rrb_par_map(pool, rrb, next_data, datas);
+    long sum = (long) rrb_par_fold(pool, rrb, add_data, add_sums, (void*) 0, NULL);
+    imc_arena_leave();
+    ck_assert_int_eq(sum, 300000L * 300001 / 2);
+    ck_assert_int_eq(counted_nodes(rrb->root), 0);
+    rrb_t* kept = rrb_promote(rrb);
+    imc_arena_free(arena);
+
+    ck_assert_int_eq(rrb_size(kept), 300000);
+    for (int i = 0; i < 300000; i++) {
+        ck_assert_int_eq(*rrb_lookup(kept, i), i + 1);
+    }
+    rrb_unref(kept);
+    thread_pool_free(pool);
+}
+END_TEST
+
+START_TEST(rrb_trace_test)
+{
+    static int datas[2048];
+    static rrb_trace_event_t events[RRB_TRACE_SIZE];
+    static imc_data_t* items[2048];
+    for (int i = 0; i < 2048; i++) {
+        items[i] = &datas[i];
+    }
+    rrb_t* rrb = rrb_from_array(items, 2048);
+    rrb_trace_clear();
+    rrb_t* updated = rrb_update(rrb, 0, &datas[2047]);
+    size_t size = rrb_trace_events(events, RRB_TRACE_SIZE);
+
+#ifdef RRB_TRACE
+    // The path is copied from the root, a node per level.
+    int copies = 0;
+    for (size_t i = 0; i < size; i++) {
+        copies += events[i].copies;
+        ck_assert_int_gt(events[i].level, 0);
+    }
+    ck_assert_int_eq(copies, rrb->root->level);
+    ck_assert_str_eq(events[0].op, "alloc_node");
+    ck_assert_int_eq(events[0].level, rrb->root->level);
+    ck_assert_ptr_eq(events[0].node, updated->root);
+#else
+    ck_assert_int_eq(size, 0);
+#endif
+    rrb_unref(updated);
+    rrb_unref(rrb);
+}
+END_TEST
+
+START_TEST(rrb_stats_test)
+{
+    static int datas[64];
+    static imc_data_t* items[64];
+    for (int i = 0; i < 64; i++) {
+        items[i] = &datas[i];
+    }
+    rrb_t* rrb = rrb_from_array(items, 64);
+    imc_stats_t before, stats;
+    imc_stats_get(&before);
+    rrb_t* updated = rrb_update(rrb, 0, &datas[63]);
+    ck_assert_ptr_eq(rrb_lookup(updated, 0), &datas[63]);
+    imc_stats_get(&stats);
+
+#ifdef IMC_STATS
+    ck_assert_int_gt(stats.copies, before.copies);
+    ck_assert_int_gt(stats.allocs, before.allocs);
+    ck_assert_int_gt(stats.bytes, before.bytes);
+    ck_assert_int_eq(stats.lookups, before.lookups + 1);
+    ck_assert_int_eq(stats.visited, before.visited + updated->root->level);
+#else
+    ck_assert_int_eq(stats.copies, 0);
+    ck_assert_int_eq(stats.lookups, 0);
+#endif
+    rrb_unref(updated);
+    rrb_unref(rrb);
 }
 END_TEST
 
 Suite* rrb_suite(void) {
-    Suite* suite   = suite_create("AVL");
+    Suite* suite   = suite_create("RRB");
     TCase* tc_core = tcase_create("Core");
 
-    tcase_add_test(tc_core, rrb_create);
-    tcase_add_test(tc_core, rrb_push);
+    tcase_add_test(tc_core, rrb_create_test);
+    tcase_add_test(tc_core, rrb_push_test);
+    tcase_add_test(tc_core, rrb_push_pop_test);
+    tcase_add_test(tc_core, rrb_transient_test);
+    tcase_add_test(tc_core, rrb_merge_test);
+    tcase_add_test(tc_core, rrb_slice_test);
+    tcase_add_test(tc_core, rrb_push_many_test);
+    tcase_add_test(tc_core, rrb_iterator_test);
+    tcase_add_test(tc_core, rrb_bulk_test);
+    tcase_add_test(tc_core, rrb_parallel_test);
+    tcase_add_test(tc_core, rrb_reclaim_test);
+    tcase_add_test(tc_core, rrb_arena_test);
+    tcase_add_test(tc_core, rrb_arena_parallel_test);
+    tcase_add_test(tc_core, rrb_trace_test);
+    tcase_add_test(tc_core, rrb_stats_test);
     suite_add_tcase(suite, tc_core);
 
     return suite;
@@ -1,5 +1,2 @@
-time = 0
-10_000.times do
-  time += `./exec/rrb #{ARGV[0]}`.to_f
-end
-p time / 10_000
+# The bench repeats the runs in process, see src/bench/README.md.
+exec("../bench/bench", "-b", "-i", "rrb", "-n", "10000", "-o", "csv", "-f", ARGV[0])